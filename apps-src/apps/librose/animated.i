@@ -24,6 +24,7 @@
 
 #include "SDL.h"
 #include "animated.hpp"
+#include "benchmark.hpp"
 
 namespace {
 	int current_ticks = 0;
@@ -31,7 +32,7 @@ namespace {
 
 void new_animation_frame()
 {
-	current_ticks = SDL_GetTicks();
+	current_ticks = benchmark::get_ticks();
 }
 
 int get_current_animation_tick()
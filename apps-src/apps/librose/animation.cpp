@@ -17,6 +17,7 @@
 
 #include "animation.hpp"
 
+#include "benchmark.hpp"
 #include "display.hpp"
 #include "base_unit.hpp"
 #include "controller_base.hpp"
@@ -589,7 +590,7 @@ void base_animator::wait_until(controller_base& controller, int animation_time)
 	double speed = disp.turbo_speed();
 	controller.play_slice(false);
 	int end_tick = animated_units_[0].my_unit->get_animation()->time_to_tick(animation_time);
-	while (SDL_GetTicks() < static_cast<unsigned int>(end_tick)
+	while (benchmark::get_ticks() < static_cast<unsigned int>(end_tick)
 				- std::min<int>(static_cast<unsigned int>(20/speed),20)) {
 
 		disp.delay(std::max<int>(0,
@@ -598,7 +599,7 @@ void base_animator::wait_until(controller_base& controller, int animation_time)
 		controller.play_slice(false);
         end_tick = animated_units_[0].my_unit->get_animation()->time_to_tick(animation_time);
 	}
-	disp.delay(std::max<int>(0,end_tick - SDL_GetTicks() +5));
+	disp.delay(std::max<int>(0,end_tick - benchmark::get_ticks() +5));
 	new_animation_frame();
 }
 
@@ -29,6 +29,7 @@
 #include "gui/dialogs/chat.hpp"
 #include "gui/widgets/window.hpp"
 #include "ble.hpp"
+#include "log.hpp"
 #include "webrtc/voice_engine/include/voe_base.h"
 
 #include <iostream>
@@ -39,7 +40,6 @@ base_instance* instance = NULL;
 void base_instance::regenerate_heros(hero_map& heros, bool allow_empty)
 {
 	const std::string hero_data_path = game_config::path + "/xwml/" + "hero.dat";
-	heros.map_from_file(hero_data_path);
 	if (!heros.map_from_file(hero_data_path)) {
 		if (allow_empty) {
 			// allow no hero.dat
@@ -122,6 +122,22 @@ base_instance::base_instance(int argc, char** argv, int sample_rate, size_t soun
 	webrtc::VoiceEngine::SetAndroidObjects(v1, v2);
 	rtc::ThreadManager::Instance()->SetCurrentThread(&sdl_thread_);
 
+	// --log-async moves log output to a writer thread, --log-file <file> also writes it to file.
+	bool log_async = false;
+	lg::tasync_options log_options;
+	for (int arg_ = 1; arg_ < argc; ++ arg_) {
+		const std::string option(argv[arg_]);
+		if (option == "--log-async") {
+			log_async = true;
+		} else if (option == "--log-file" && arg_ + 1 < argc) {
+			log_async = true;
+			log_options.file = argv[++ arg_];
+		}
+	}
+	if (log_async) {
+		lg::start_async(log_options);
+	}
+
 	VALIDATE(game_config::path.empty(), null_str);
 #ifdef _WIN32
 	std::string exe_dir = get_exe_dir();
@@ -258,6 +274,9 @@ base_instance::~base_instance()
 
 	clear_anims();
 	game_config::path.clear();
+
+	// write what the logging threads left.
+	lg::stop_async();
 }
 
 /**
@@ -361,7 +380,7 @@ void base_instance::background_disconnect(const uint32_t id)
 
 void base_instance::handle_background()
 {
-	uint32_t ticks = SDL_GetTicks();
+	uint32_t ticks = benchmark::get_ticks();
 	for (std::map<uint32_t, boost::function<bool (uint32_t ticks)> >::iterator it = background_callbacks_.begin(); it != background_callbacks_.end(); ) {
 		// must not app call background_disconnect! once enable, this for will result confuse!
 		bool erase = it->second(ticks);
@@ -380,6 +399,8 @@ void base_instance::handle_app_event(Uint32 type)
 	if (type == SDL_APP_TERMINATING || type == SDL_QUIT) {
 		posix_print("handle_app_event, SDL_APP_TERMINATING(0x%x)\n", type);
 		app_terminating();
+		// os may kill process without destructors.
+		preferences::flush_preferences();
 
 		terminating_ = true;
 #ifdef ANDROID
@@ -394,6 +415,7 @@ void base_instance::handle_app_event(Uint32 type)
 	} else if (type == SDL_APP_WILLENTERBACKGROUND) {
 		posix_print("handle_app_event, SDL_APP_WILLENTERBACKGROUND\n");
 		app_willenterbackground();
+		preferences::flush_preferences();
 		// FIX SDL BUG! normally DIDENTERBACKGROUND should be called after WILLENTERBACKGROUND.
 		// but on iOS, because SDL event queue, SDL-DIDENTERBACKGROUND is called, but app-DIDENTERBACKGROUND not!
 		// app-DIDENTERBACKGROUND is call when WILLENTERFOREGROUND.
@@ -26,6 +26,7 @@
 #include "config_cache.hpp"
 #include "cursor.hpp"
 #include "loadscreen.hpp"
+#include "benchmark.hpp"
 
 #include "webrtc/base/thread.h"
 #include "webrtc/base/physicalsocketserver.h"
@@ -194,6 +195,7 @@ public:
 	{
 		// if exception generated when construct, system don't call destructor.
 		try {
+			benchmark::parse_command_line(argc, argv);
 			base_instance::prefix_create(app, title, channel, hdpi, landscape);
 			instance = new T(argc, argv);
 			instance->initialize(create_lobby);
@@ -20,8 +20,30 @@
 #include "wml_exception.hpp"
 #include "controller_base.hpp"
 
+#include <boost/foreach.hpp>
+
 #define index(x, y)  (w_ * (y) + (x))
 
+static const int grid_cell_size = 128;
+
+// units placed at negative pixel are put in first cell, query clamp the same way.
+static int grid_cell(int pixel)
+{
+	return pixel > 0? pixel / grid_cell_size: 0;
+}
+
+static SDL_Rect grid_cells(const SDL_Rect& rect)
+{
+	const int x = grid_cell(rect.x);
+	const int y = grid_cell(rect.y);
+	return create_rect(x, y, grid_cell(rect.x + rect.w - 1) - x + 1, grid_cell(rect.y + rect.h - 1) - y + 1);
+}
+
+static bool map_index_less(const base_unit* a, const base_unit* b)
+{
+	return a->get_map_index() < b->get_map_index();
+}
+
 base_map::base_map(controller_base& controller, const gamemap& gmap, bool consistent) 
 	: controller_(controller)
 	, gmap_(gmap)
@@ -32,6 +54,8 @@ base_map::base_map(controller_base& controller, const gamemap& gmap, bool consis
 	, coor_map_(NULL)
 	, consistent_(consistent)
 	, place_unsort_(false)
+	, grid_()
+	, query_epoch_(0)
 {}
 
 base_map &base_map::operator=(const base_map &that)
@@ -181,6 +205,8 @@ void base_map::insert(const map_location loc, base_unit* u)
 		}
 	}
 
+	grid_insert(u);
+
 	// insert p into time-axis.*
 	u->map_index_ = map_vsize_;
 	map_[map_vsize_ ++] = u;
@@ -245,53 +271,102 @@ void base_map::insert2(const display& disp, base_unit* u)
 	insert(loc, u);
 }
 
+// only units with rect can be clicked, they are all in grid_.
+// if more than one unit contain the point, return the innermost, it's top-left is nearest to point.
 base_unit* base_map::unit_clicked_on(const int xclick, const int yclick, const map_location& mloc) const
 {
-	const int w = gmap_.w();
 	const display& disp = get_controller().get_display();
 	int xmap = xclick, ymap = yclick;
 	disp.pixel_screen_to_map(xmap, ymap);
 
-	base_unit* u;
-	for (int y = mloc.y; y >= 0; y --) {
-		int pitch = y * w_;
-		int max_x = 0;
-		int min_y = INT_MAX;
-		for (int x = mloc.x; x >= 0; x --) {
-			u = coor_map_[pitch + x].overlay;
-			if (u && !u->hidden_) {
-				const SDL_Rect& rect = u->get_rect();
-				if (point_in_rect(xmap, ymap, rect)) {
-					return u;
-				}
-				if (max_x < rect.x + rect.w) {
-					max_x = rect.x + rect.w;
-				}
-				if (min_y > rect.y) {
-					min_y = rect.y;
-				}
+	std::map<std::pair<int, int>, std::vector<base_unit*> >::const_iterator it = grid_.find(std::make_pair(grid_cell(ymap), grid_cell(xmap)));
+	if (it == grid_.end()) {
+		return NULL;
+	}
+
+	base_unit* result = NULL;
+	BOOST_FOREACH (base_unit* u, it->second) {
+		if (u->base() || u->hidden_) {
+			continue;
+		}
+		const SDL_Rect& rect = u->get_rect();
+		if (!point_in_rect(xmap, ymap, rect)) {
+			continue;
+		}
+		if (result) {
+			const SDL_Rect& that = result->get_rect();
+			if (rect.y < that.y || (rect.y == that.y && rect.x < that.x)) {
+				continue;
 			}
-			if (min_y <= ymap) {
-				break;
+			if (rect.y == that.y && rect.x == that.x && u->loc_.x > result->loc_.x) {
+				// same rect, prefer the on-board one.
+				continue;
 			}
 		}
-		for (int x1 = w; x1 < w_; x1 ++) {
-			u = coor_map_[pitch + x1].overlay;
-			if (u && !u->hidden_) {
-				const SDL_Rect& rect = u->get_rect();
-				if (point_in_rect(xmap, ymap, rect)) {
-					return u;
-				}
-				if (max_x < rect.x + rect.w) {
-					max_x = rect.x + rect.w;
-				}
+		result = u;
+	}
+	return result;
+}
+
+void base_map::grid_insert(base_unit* u)
+{
+	if (u->grid_cells_.w) {
+		grid_erase(u);
+	}
+	if (u->consistent()) {
+		return;
+	}
+	const SDL_Rect cells = grid_cells(u->get_rect());
+	for (int y = cells.y; y < cells.y + cells.h; y ++) {
+		for (int x = cells.x; x < cells.x + cells.w; x ++) {
+			grid_[std::make_pair(y, x)].push_back(u);
+		}
+	}
+	u->grid_cells_ = cells;
+}
+
+void base_map::grid_erase(base_unit* u)
+{
+	const SDL_Rect& cells = u->grid_cells_;
+	for (int y = cells.y; y < cells.y + cells.h; y ++) {
+		for (int x = cells.x; x < cells.x + cells.w; x ++) {
+			std::map<std::pair<int, int>, std::vector<base_unit*> >::iterator it = grid_.find(std::make_pair(y, x));
+			if (it == grid_.end()) {
+				continue;
+			}
+			std::vector<base_unit*>& bucket = it->second;
+			std::vector<base_unit*>::iterator it2 = std::find(bucket.begin(), bucket.end(), u);
+			if (it2 != bucket.end()) {
+				bucket.erase(it2);
+			}
+			if (bucket.empty()) {
+				grid_.erase(it);
 			}
 		}
-		if (y != mloc.y && max_x >= xmap) {
-			break;
+	}
+	u->grid_cells_ = empty_rect;
+}
+
+void base_map::rebuild_grid()
+{
+	grid_.clear();
+	for (int i = 0; i < map_vsize_; i ++) {
+		base_unit* u = map_[i];
+		u->grid_cells_ = empty_rect;
+		grid_insert(u);
+	}
+}
+
+unsigned int base_map::next_query_epoch()
+{
+	if (!++ query_epoch_) {
+		// wrapped, stamps of units maybe equal to new epoch.
+		for (int i = 0; i < map_vsize_; i ++) {
+			map_[i]->query_epoch_ = 0;
 		}
+		query_epoch_ = 1;
 	}
-	return NULL;
+	return query_epoch_;
 }
 
 bool base_map::valid2(const map_location& loc, bool overlay) const
@@ -325,6 +400,7 @@ void base_map::clear()
 		free(coor_map_);
 		coor_map_ = NULL;
 	}
+	grid_.clear();
 	for (size_t i = 0; i != map_vsize_; ++i) {
 		delete map_[i];
 	}
@@ -351,6 +427,7 @@ base_unit* base_map::extract(const map_location &loc)
 	for (std::set<map_location>::const_iterator itor = touch_locs.begin(); itor != touch_locs.end(); ++ itor) {
 		coor_map_[index(itor->x, itor->y)].overlay = NULL;
 	}
+	grid_erase(u);
 
 	if (!place_unsort_) {
 		VALIDATE(u->get_map_index() != UNIT_NO_INDEX, null_str);
@@ -368,6 +445,7 @@ void base_map::place(const map_location loc, base_unit* u)
 	for (std::set<map_location>::const_iterator itor = touch_locs.begin(); itor != touch_locs.end(); ++ itor) {
 		coor_map_[index(itor->x, itor->y)].overlay = u;
 	}
+	grid_insert(u);
 
 	if (!place_unsort_) {
 		VALIDATE(u->get_map_index() != UNIT_NO_INDEX, null_str);
@@ -421,6 +499,7 @@ bool base_map::erase2(base_unit* u, bool delete_unit)
 		}
 		invalid_locs.insert(loc);
 	}
+	grid_erase(u);
 
 	display* disp = display::get_singleton();
 	if (disp) {
@@ -455,18 +534,19 @@ size_t base_map::units_from_rect(base_unit** draw_area_unit, const rect_of_hexes
 	draw_area_max_y[0] = std::min(gmap_.h() - 1, draw_area_rect.bottom[0]);
 	draw_area_max_y[1] = std::min(gmap_.h() - 1, draw_area_rect.bottom[1]);
 
+	// unit overlapped multi-grid/cell is visited more than once, use epoch to dedupe.
+	const unsigned int epoch = next_query_epoch();
 	if (consistent_) {
-		std::set<const base_unit*> calculated;
 		for (int x = draw_area_min_x; x <= draw_area_max_x; x ++) {
 			for (int y = draw_area_min_y[x & 1]; y <= draw_area_max_y[x & 1]; y ++) {
 				base_unit* u = coor_map_[index(x, y)].base;
-				if (u && !calculated.count(u)) {
-					calculated.insert(u);
+				if (u && u->query_epoch_ != epoch) {
+					u->query_epoch_ = epoch;
 					draw_area_unit[draw_area_unit_size ++] = u;
 				}
 				u = coor_map_[index(x, y)].overlay;
-				if (u && !calculated.count(u)) {
-					calculated.insert(u);
+				if (u && u->query_epoch_ != epoch) {
+					u->query_epoch_ = epoch;
 					draw_area_unit[draw_area_unit_size ++] = u;
 				}
 				
@@ -478,12 +558,28 @@ size_t base_map::units_from_rect(base_unit** draw_area_unit, const rect_of_hexes
 		SDL_Rect rect = create_rect(draw_area_min_x * zoom, draw_area_min_y[0] * zoom,
 			(draw_area_max_x - draw_area_min_x + 1) * zoom,
 			(draw_area_max_y[0] - draw_area_min_y[0] + 1) * zoom);
-		for (int i = 0; i < map_vsize_; i ++) {
-			base_unit* u = map_[i];
-			if (rects_overlap(u->get_rect(), rect)) {
-				draw_area_unit[draw_area_unit_size ++] = u;
+		if (rect.w <= 0 || rect.h <= 0) {
+			return 0;
+		}
+
+		// only units with rect can overlap, they are all in grid_.
+		const SDL_Rect cells = grid_cells(rect);
+		for (int y = cells.y; y < cells.y + cells.h; y ++) {
+			std::map<std::pair<int, int>, std::vector<base_unit*> >::const_iterator it = grid_.lower_bound(std::make_pair(y, cells.x));
+			for (; it != grid_.end() && it->first.first == y && it->first.second < cells.x + cells.w; ++ it) {
+				BOOST_FOREACH (base_unit* u, it->second) {
+					if (u->query_epoch_ == epoch) {
+						continue;
+					}
+					u->query_epoch_ = epoch;
+					if (rects_overlap(u->get_rect(), rect)) {
+						draw_area_unit[draw_area_unit_size ++] = u;
+					}
+				}
 			}
 		}
+		// keep time-axis sequence as walking map_.
+		std::sort(draw_area_unit, draw_area_unit + draw_area_unit_size, map_index_less);
 	}
 
 	return draw_area_unit_size;
@@ -260,7 +260,14 @@ public:
 private:
 	void expand_coor_map(int w);
 
+	void grid_insert(base_unit* u);
+	void grid_erase(base_unit* u);
+	unsigned int next_query_epoch();
+
 protected:
+	/** Reindex all units in map_. Call it after modify map_ without insert/place/erase2. */
+	void rebuild_grid();
+
 	const gamemap& gmap_;
 
 	bool consistent_;
@@ -279,6 +286,13 @@ protected:
 	};
 	loc_cookie* coor_map_;
 
+	/**
+	 * Units with rect, bucketed by grid_cell_size pixel cells, key is (y, x) of cell.
+	 * Used to find units in rect without walking all of map_.
+	 */
+	std::map<std::pair<int, int>, std::vector<base_unit*> > grid_;
+	unsigned int query_epoch_;
+
 private:
 	controller_base& controller_;
 };
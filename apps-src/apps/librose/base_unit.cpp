@@ -30,6 +30,8 @@ base_unit::base_unit(base_map& units)
 	, redraw_counter_(0)
 	, rect_(empty_rect)
 	, hidden_(false)
+	, grid_cells_(empty_rect)
+	, query_epoch_(0)
 	, anim_(NULL)
 	, next_idling_(0)
 	, frame_begin_time_(0)
@@ -51,6 +53,8 @@ base_unit::base_unit(const base_unit& that)
 	, redraw_counter_(that.redraw_counter_)
 	, rect_(that.rect_)
 	, hidden_(that.hidden_)
+	, grid_cells_(empty_rect) // copy isn't in grid
+	, query_epoch_(0)
 	, anim_(NULL) // important!!
 	, next_idling_(that.next_idling_)
 	, frame_begin_time_(that.frame_begin_time_)
@@ -113,6 +113,11 @@ protected:
 	SDL_Rect rect_;
 	bool hidden_;
 
+	// range of base_map's grid cells rect_ was indexed in, w = 0 if not indexed.
+	SDL_Rect grid_cells_;
+	// base_map::units_from_rect's epoch this unit was last visited in.
+	unsigned int query_epoch_;
+
 	// Animations:
 	animation* anim_;
 	int next_idling_;
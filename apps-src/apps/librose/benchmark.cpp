@@ -0,0 +1,524 @@
+/*
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY.
+
+   See the COPYING file for more details.
+*/
+
+#include "global.hpp"
+
+#include "benchmark.hpp"
+#include "builder.hpp"
+#include "events.hpp"
+#include "video.hpp"
+#include "display.hpp"
+#include "filesystem.hpp"
+#include "font.hpp"
+#include "integrate.hpp"
+#include "map.hpp"
+#include "marked-up_text.hpp"
+#include "rose_config.hpp"
+#include "terrain_translation.hpp"
+#include "wml_exception.hpp"
+#include "serialization/parser.hpp"
+#include "serialization/string_utils.hpp"
+#include "webrtc/base/json.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include <new>
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+
+namespace benchmark {
+
+struct tframe {
+	double ms;
+	double cpu_ms;
+	int allocations;
+	int counters[COUNTERS];
+};
+
+struct tscript_event {
+	int frame;
+	SDL_Event event;
+	bool warp;
+};
+
+static bool bm_enabled = false;
+static std::string script_file;
+static std::string output_file;
+static Uint32 virtual_ticks = 1000;
+static int frame = 0;
+static int frames = 0;
+static std::vector<tscript_event> script;
+static size_t next_event = 0;
+static std::vector<tframe> results;
+static Json::Value text_results(Json::objectValue);
+static Json::Value terrain_results(Json::arrayValue);
+static tframe current;
+static Uint64 frame_start = 0;
+static std::clock_t frame_cpu_start = 0;
+static SDL_atomic_t allocations;
+
+void parse_command_line(int argc, char** argv)
+{
+	for (int arg_ = 1; arg_ < argc; ++ arg_) {
+		const std::string option(argv[arg_]);
+		if (option == "--benchmark" && arg_ + 1 < argc) {
+			script_file = argv[++ arg_];
+		} else if (option == "--benchmark-output" && arg_ + 1 < argc) {
+			output_file = argv[++ arg_];
+		}
+	}
+	if (script_file.empty()) {
+		return;
+	}
+	bm_enabled = true;
+
+	// no window, no audio device, render to memory.
+	SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+	SDL_setenv("SDL_AUDIODRIVER", "dummy", 1);
+	SDL_SetHint(SDL_HINT_RENDER_DRIVER, "software");
+	game_config::no_delay = true;
+	memset(&current, 0, sizeof(current));
+	SDL_AtomicSet(&allocations, 0);
+}
+
+bool enabled()
+{
+	return bm_enabled;
+}
+
+Uint32 get_ticks()
+{
+	return bm_enabled? virtual_ticks: SDL_GetTicks();
+}
+
+void count(tcounter counter, int n)
+{
+	if (bm_enabled) {
+		current.counters[counter] += n;
+	}
+}
+
+#ifdef BENCHMARK_ALLOCATIONS
+static void count_allocation()
+{
+	if (bm_enabled) {
+		SDL_AtomicAdd(&allocations, 1);
+	}
+}
+#endif
+
+static void add_event(int at, const SDL_Event& event, bool warp = false)
+{
+	tscript_event e;
+	e.frame = at;
+	e.event = event;
+	e.warp = warp;
+	script.push_back(e);
+}
+
+static int text_style(const std::string& str)
+{
+	int style = TTF_STYLE_NORMAL;
+	if (str.find("bold") != std::string::npos) {
+		style |= TTF_STYLE_BOLD;
+	}
+	if (str.find("italic") != std::string::npos) {
+		style |= TTF_STYLE_ITALIC;
+	}
+	return style;
+}
+
+// text workloads don't depend on frames, run them once before first frame.
+static void run_text_workloads(const config& bm_cfg)
+{
+	int mismatches = 0;
+	BOOST_FOREACH (const config& m, bm_cfg.child_range("measure")) {
+		const int font_size = m["font_size"].to_int(font::SIZE_NORMAL);
+		const int n = font::check_line_measurer(m["text"].str(), font_size, text_style(m["style"].str()));
+		Json::Value item;
+		item["text"] = m["text"].str();
+		item["font_size"] = font_size;
+		item["style"] = m["style"].str();
+		item["mismatches"] = n;
+		text_results["measure"].append(item);
+		mismatches += n;
+	}
+	if (bm_cfg.has_child("measure")) {
+		text_results["measure_mismatches"] = mismatches;
+	}
+
+	BOOST_FOREACH (const config& w, bm_cfg.child_range("word_wrap")) {
+		std::string text;
+		for (int n = w["repeat"].to_int(1); n > 0; n --) {
+			text += w["text"].str();
+		}
+		const int font_size = w["font_size"].to_int(font::SIZE_NORMAL);
+		const Uint64 start = SDL_GetPerformanceCounter();
+		const std::string wrapped = font::word_wrap_text(text, font_size, w["width"].to_int(400));
+		Json::Value item;
+		item["bytes"] = (int)text.size();
+		item["font_size"] = font_size;
+		item["lines"] = (int)std::count(wrapped.begin(), wrapped.end(), '\n') + 1;
+		item["ms"] = 1000.0 * (SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+		text_results["word_wrap"].append(item);
+	}
+
+	BOOST_FOREACH (const config& t, bm_cfg.child_range("typing")) {
+		std::string text;
+		for (int n = t["repeat"].to_int(1); n > 0; n --) {
+			text += t["text"].str();
+		}
+		text = tintegrate::stuff_escape(text);
+		const int font_size = t["font_size"].to_int(font::SIZE_NORMAL);
+		const int width = t["width"].to_int(400);
+
+		Uint64 start = SDL_GetPerformanceCounter();
+		tintegrate* integrate = new tintegrate(text, width, -1, font_size, font::BLACK_COLOR, true);
+		const double layout_ms = 1000.0 * (SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+
+		// keystroke does as ttext_box::insert_str: edit src, lay out it from previous layout, place cursor.
+		int src_pos = std::min(t["at"].to_int(text.size()), (int)text.size());
+		const std::string& typed = t["type"].str();
+		double total_ms = 0, max_ms = 0;
+		int keystrokes = 0;
+		for (utils::utf8_iterator it(typed); it != utils::utf8_iterator::end(typed); ++ it, keystrokes ++) {
+			start = SDL_GetPerformanceCounter();
+			const SDL_Rect cursor = integrate->calculate_cursor(src_pos);
+			text = integrate->insert_str(true, cursor.x, cursor.y, tintegrate::stuff_escape(std::string(it.substr().first, it.substr().second)), src_pos);
+			tintegrate* previous = integrate;
+			integrate = new tintegrate(text, width, -1, font_size, font::BLACK_COLOR, true, previous);
+			delete previous;
+			integrate->calculate_cursor(src_pos);
+			const double ms = 1000.0 * (SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+			total_ms += ms;
+			max_ms = std::max(max_ms, ms);
+		}
+		delete integrate;
+
+		Json::Value item;
+		item["bytes"] = (int)text.size();
+		item["font_size"] = font_size;
+		item["layout_ms"] = layout_ms;
+		item["keystrokes"] = keystrokes;
+		item["avg_ms"] = keystrokes? total_ms / keystrokes: 0;
+		item["max_ms"] = max_ms;
+		text_results["typing"].append(item);
+	}
+}
+
+static double elapsed_ms(Uint64 start)
+{
+	return 1000.0 * (SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+}
+
+static void run_terrain_workloads(const config& bm_cfg)
+{
+	BOOST_FOREACH (const config& b, bm_cfg.child_range("terrain_builder")) {
+		const std::string& tile = b["tile"].str();
+		const int width = b["width"].to_int(40);
+		const int height = b["height"].to_int(40);
+		VALIDATE(!tile.empty() && width > 0 && height > 0, "[terrain_builder] must have tile, width and height!");
+
+		// terrain codes are laid in diagonal stripes, so borders between them match transition rules.
+		std::vector<t_translation::t_terrain> codes;
+		const std::vector<std::string> terrains = utils::split(b["terrain"].str().empty()? "Gg": b["terrain"].str());
+		for (std::vector<std::string>::const_iterator it = terrains.begin(); it != terrains.end(); ++ it) {
+			codes.push_back(t_translation::read_terrain_code(*it));
+		}
+		t_translation::t_map tiles(width + 2, t_translation::t_list(height + 2));
+		for (int x = 0; x < width + 2; x ++) {
+			for (int y = 0; y < height + 2; y ++) {
+				tiles[x][y] = codes[((x + y) / 4) % codes.size()];
+			}
+		}
+		const gamemap map(null_cfg, gamemap::default_map_header + t_translation::write_game_map(tiles));
+
+		const bool cold = b["cold"].to_bool();
+		if (cold) {
+			// drop rules in sdram, so constructor reads them from tb-<tile>.dat again.
+			terrain_builder::release_heap();
+		}
+
+		// constructor loads rules when tile differs from previous builder's, then builds all tiles.
+		Uint64 start = SDL_GetPerformanceCounter();
+		terrain_builder builder(tile, &map);
+		const double construct_ms = elapsed_ms(start);
+
+		// as zoom or map resize does.
+		start = SDL_GetPerformanceCounter();
+		builder.reload_map();
+		const double reload_ms = elapsed_ms(start);
+
+		// as after editing terrain.
+		start = SDL_GetPerformanceCounter();
+		builder.rebuild_all();
+		const double rebuild_ms = elapsed_ms(start);
+
+		Json::Value item;
+		item["tile"] = tile;
+		item["cold"] = cold;
+		item["hexes"] = width * height;
+		item["construct_ms"] = construct_ms;
+		item["reload_ms"] = reload_ms;
+		item["rebuild_ms"] = rebuild_ms;
+		terrain_results.append(item);
+	}
+}
+
+static void load_script()
+{
+	config cfg;
+	{
+		scoped_istream stream = istream_file(script_file);
+		read(cfg, *stream);
+	}
+	const config& bm_cfg = cfg.child("benchmark");
+	VALIDATE(bm_cfg, "benchmark script must have [benchmark]!");
+
+	BOOST_FOREACH (const config& ev, bm_cfg.child_range("event")) {
+		const int at = ev["frame"].to_int();
+		const std::string& type = ev["type"].str();
+		SDL_Event event;
+		memset(&event, 0, sizeof(event));
+
+		if (type == "motion") {
+			event.type = SDL_MOUSEMOTION;
+			event.motion.x = ev["x"].to_int();
+			event.motion.y = ev["y"].to_int();
+			add_event(at, event, true);
+
+		} else if (type == "down" || type == "up" || type == "click") {
+			event.button.button = ev["button"].to_int(SDL_BUTTON_LEFT);
+			event.button.x = ev["x"].to_int();
+			event.button.y = ev["y"].to_int();
+			event.button.clicks = 1;
+			if (type != "up") {
+				event.type = SDL_MOUSEBUTTONDOWN;
+				event.button.state = SDL_PRESSED;
+				add_event(at, event);
+			}
+			if (type != "down") {
+				event.type = SDL_MOUSEBUTTONUP;
+				event.button.state = SDL_RELEASED;
+				add_event(type == "click"? at + 1: at, event);
+			}
+
+		} else if (type == "wheel") {
+			event.type = SDL_MOUSEWHEEL;
+			event.wheel.x = ev["dx"].to_int();
+			event.wheel.y = ev["dy"].to_int();
+			add_event(at, event);
+
+		} else if (type == "key") {
+			const std::string& mod = ev["mod"].str();
+			event.key.keysym.sym = SDL_GetKeyFromName(ev["key"].str().c_str());
+			VALIDATE(event.key.keysym.sym != SDLK_UNKNOWN, "unknown key in benchmark script: " + ev["key"].str());
+			event.key.keysym.scancode = SDL_GetScancodeFromKey(event.key.keysym.sym);
+			event.key.keysym.mod = mod == "ctrl"? KMOD_LCTRL: mod == "shift"? KMOD_LSHIFT: mod == "alt"? KMOD_LALT: KMOD_NONE;
+			event.type = SDL_KEYDOWN;
+			event.key.state = SDL_PRESSED;
+			add_event(at, event);
+			event.type = SDL_KEYUP;
+			event.key.state = SDL_RELEASED;
+			add_event(at + 1, event);
+
+		} else if (type == "text") {
+			// one utf-8 character per frame, like typing.
+			const std::string& text = ev["text"].str();
+			int n = 0;
+			for (size_t pos = 0; pos < text.size(); n ++) {
+				size_t len = 1;
+				while (pos + len < text.size() && (text[pos + len] & 0xc0) == 0x80) {
+					len ++;
+				}
+				memset(&event, 0, sizeof(event));
+				event.type = SDL_TEXTINPUT;
+				memcpy(event.text.text, text.c_str() + pos, std::min(len, sizeof(event.text.text) - 1));
+				add_event(at + n, event);
+				pos += len;
+			}
+
+		} else {
+			VALIDATE(false, "unknown event type in benchmark script: " + type);
+		}
+	}
+	std::stable_sort(script.begin(), script.end(), boost::bind(&tscript_event::frame, _1) < boost::bind(&tscript_event::frame, _2));
+
+	const int tail_frames = 60;
+	frames = bm_cfg["frames"].to_int(script.empty()? tail_frames: script.back().frame + tail_frames);
+
+	run_text_workloads(bm_cfg);
+	run_terrain_workloads(bm_cfg);
+}
+
+static void write_result()
+{
+	Json::Value root;
+	Json::Value jframes(Json::arrayValue);
+	double total_ms = 0, max_ms = 0;
+	int total_allocations = 0;
+	double total_pixels = 0;
+	int skipped = 0;
+	for (std::vector<tframe>::const_iterator it = results.begin(); it != results.end(); ++ it) {
+		const tframe& f = *it;
+		Json::Value item;
+		item["ms"] = f.ms;
+		item["cpu_ms"] = f.cpu_ms;
+#ifdef BENCHMARK_ALLOCATIONS
+		item["allocations"] = f.allocations;
+#endif
+		item["widgets"] = f.counters[WIDGETS];
+		item["hexes"] = f.counters[HEXES];
+		item["present_rects"] = f.counters[PRESENT_RECTS];
+		item["present_pixels"] = f.counters[PRESENT_PIXELS];
+		jframes.append(item);
+
+		total_ms += f.ms;
+		total_pixels += f.counters[PRESENT_PIXELS];
+		if (!f.counters[PRESENT_RECTS]) {
+			skipped ++;
+		}
+		max_ms = std::max(max_ms, f.ms);
+		total_allocations += f.allocations;
+	}
+	root["script"] = script_file;
+	if (!text_results.empty()) {
+		root["text"] = text_results;
+	}
+	if (!terrain_results.empty()) {
+		root["terrain_builder"] = terrain_results;
+	}
+	root["frame_interval"] = events::frame_interval;
+	root["frames"] = jframes;
+	Json::Value& summary = root["summary"];
+	summary["frames"] = (int)results.size();
+	summary["total_ms"] = total_ms;
+	summary["avg_ms"] = results.empty()? 0: total_ms / results.size();
+	summary["max_ms"] = max_ms;
+	// fill-rate: pixels copied to renderer by CVideo::flip, and frames it skipped.
+	summary["present_pixels"] = total_pixels;
+	summary["skipped_frames"] = skipped;
+#ifdef BENCHMARK_ALLOCATIONS
+	summary["allocations"] = total_allocations;
+#endif
+
+	Json::StyledWriter writer;
+	const std::string str = writer.write(root);
+	if (output_file.empty()) {
+		fputs(str.c_str(), stdout);
+		fflush(stdout);
+	} else {
+		write_file(output_file, str.c_str(), str.size());
+	}
+}
+
+void end_frame()
+{
+	const Uint64 now = SDL_GetPerformanceCounter();
+	const std::clock_t cpu_now = std::clock();
+	if (frame == 0) {
+		load_script();
+	} else {
+		current.ms = 1000.0 * (now - frame_start) / SDL_GetPerformanceFrequency();
+		current.cpu_ms = 1000.0 * (cpu_now - frame_cpu_start) / CLOCKS_PER_SEC;
+		current.allocations = SDL_AtomicSet(&allocations, 0);
+		results.push_back(current);
+	}
+	if (frame == frames) {
+		write_result();
+		throw CVideo::quit();
+	}
+
+	frame ++;
+	virtual_ticks += events::frame_interval;
+	for (; next_event < script.size() && script[next_event].frame <= frame; next_event ++) {
+		tscript_event& e = script[next_event];
+		e.event.common.timestamp = virtual_ticks;
+		display* disp = display::get_singleton();
+		SDL_Window* window = disp? disp->video().getWindow(): NULL;
+		if (e.warp && window) {
+			// keep SDL_GetMouseState in sync, SDL generates the motion event.
+			SDL_WarpMouseInWindow(window, e.event.motion.x, e.event.motion.y);
+		} else {
+			SDL_PushEvent(&e.event);
+		}
+	}
+
+	memset(&current, 0, sizeof(current));
+	SDL_AtomicSet(&allocations, 0);
+	frame_start = SDL_GetPerformanceCounter();
+	frame_cpu_start = std::clock();
+}
+
+} // namespace benchmark
+
+#ifdef BENCHMARK_ALLOCATIONS
+// allocations per frame of benchmark. counting costs one branch when benchmark is off.
+// every form is replaced, so memory is always from malloc and back to free.
+void* operator new(size_t size)
+{
+	benchmark::count_allocation();
+	void* ptr = malloc(size? size: 1);
+	if (!ptr) {
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) throw()
+{
+	benchmark::count_allocation();
+	return malloc(size? size: 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& nothrow) throw()
+{
+	return operator new(size, nothrow);
+}
+
+void operator delete(void* ptr) throw()
+{
+	free(ptr);
+}
+
+void operator delete[](void* ptr) throw()
+{
+	free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) throw()
+{
+	free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) throw()
+{
+	free(ptr);
+}
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void* ptr, size_t) throw()
+{
+	free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) throw()
+{
+	free(ptr);
+}
+#endif
+#endif
@@ -0,0 +1,81 @@
+/*
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY.
+
+   See the COPYING file for more details.
+*/
+
+#ifndef LIBROSE_BENCHMARK_HPP_INCLUDED
+#define LIBROSE_BENCHMARK_HPP_INCLUDED
+
+#include "SDL.h"
+
+/**
+ * Headless, repeatable benchmark mode.
+ *
+ * Enabled by "--benchmark <script>" on command line, "--benchmark-output <file>"
+ * writes result to file instead of stdout. It runs on SDL's dummy video driver
+ * with the software renderer, and a virtual clock advances frame_interval per
+ * frame, so animations and timers don't depend on how fast the machine is.
+ *
+ * Script is WML, every [event] is fed at the given frame:
+ *   [benchmark]
+ *     frames=600         # frames to run, default to last event + 60
+ *     [event]
+ *       frame=30
+ *       type=motion      # motion, down, up, click, wheel, key, text
+ *       x=100            # motion/down/up/click, wheel use dx, dy
+ *       y=200
+ *       key=Return       # key, SDL key name, mod=ctrl/shift/alt
+ *       text="hello"     # text, one character per frame
+ *     [/event]
+ *     [measure]          # check tline_measurer against TTF_SizeUTF8
+ *       text="AVAT"
+ *       font_size=16
+ *       style=italic     # normal, bold, italic, or "bold,italic"
+ *     [/measure]
+ *     [word_wrap]        # time font::word_wrap_text before first frame
+ *       text="..."
+ *       repeat=100       # text is repeated to make a long paragraph
+ *       font_size=16
+ *       width=400
+ *     [/word_wrap]
+ *     [typing]           # time keystrokes into editable text, as text box does
+ *       text="..."
+ *       repeat=100
+ *       type="abc"       # one keystroke per character
+ *       at=5000          # src position that typing starts at, default to end
+ *       font_size=16
+ *       width=400
+ *     [/typing]
+ *     [terrain_builder]  # time terrain_builder on a generated map
+ *       tile=hexagonal   # hexagonal or square, switching tile reloads rules
+ *       terrain="Gg,Ww"  # terrain codes, laid in diagonal stripes
+ *       width=64
+ *       height=64
+ *       cold=yes         # release rules first, so they are read from file again
+ *     [/terrain_builder]
+ *   [/benchmark]
+ *
+ * At end it writes per-frame wall/cpu time and draw counters as JSON, then
+ * quits with CVideo::quit. Allocations per frame are counted only when librose
+ * is compiled with BENCHMARK_ALLOCATIONS, which replaces global operator new.
+ */
+namespace benchmark {
+enum tcounter {WIDGETS, HEXES, PRESENT_RECTS, PRESENT_PIXELS, COUNTERS};
+
+// call before video-subsystem is initialized.
+void parse_command_line(int argc, char** argv);
+bool enabled();
+// SDL_GetTicks, or virtual clock when in benchmark mode.
+Uint32 get_ticks();
+void count(tcounter counter, int n = 1);
+// called by events::wait_frame, instead of waiting.
+void end_frame();
+}
+
+#endif
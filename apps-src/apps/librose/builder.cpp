@@ -37,6 +37,8 @@ static lg::log_domain log_engine("engine");
 terrain_builder::building_rule* terrain_builder::building_rules_ = NULL;
 uint32_t terrain_builder::building_rules_size_ = 0;
 uint32_t terrain_builder::unit_rules_size_;
+std::map<t_translation::t_terrain, std::vector<int8_t> > terrain_builder::terrain_matches_;
+int terrain_builder::match_indexes_ = 0;
 const std::string terrain_builder::tb_dat_prefix = "tb-";
 std::string terrain_builder::using_id;
 
@@ -257,6 +259,8 @@ void terrain_builder::release_heap()
 		building_rules_ = NULL;
 	}
 	building_rules_size_ = 0;
+	terrain_matches_.clear();
+	match_indexes_ = 0;
 }
 
 void terrain_builder::change_map(const gamemap* m)
@@ -350,18 +354,26 @@ void terrain_builder::rebuild_terrain()
 
 void terrain_builder::reload_map()
 {
+	uint32_t start = SDL_GetTicks();
+
 	// branch: change map size.
 	tile_map_.reload(map_->w(), map_->h());
 	terrain_by_type_.clear();
 	build_terrains();
+
+	posix_print("reload map, used time: %u ms\n", SDL_GetTicks() - start);
 }
 
 void terrain_builder::rebuild_all()
 {
+	uint32_t start = SDL_GetTicks();
+
 	// branch: don't change map size. change terrain.
 	tile_map_.reset();
 	terrain_by_type_.clear();
 	build_terrains();
+
+	posix_print("rebuild all, used time: %u ms\n", SDL_GetTicks() - start);
 }
 
 static bool image_exists(const std::string& name)
@@ -1006,7 +1018,7 @@ bool terrain_builder::rule_matches(const terrain_builder::building_rule &rule,
 		// check if terrain matches except if we already know that it does
 		if (&cons != type_checked) {
 			if (selector_ == SELECTOR_MAP) {
-				if (!terrain_matches(map().get_terrain(tloc), cons.terrain_types_match)) {
+				if (!constraint_matches(map().get_terrain(tloc), cons)) {
 					return false;
 				}
 			} else if (!units_->terrain_matches(tloc, cons.terrain_types_match)) {
@@ -1094,6 +1106,23 @@ unsigned int terrain_builder::building_rule::get_hash() const
 	return hash_;
 }
 
+bool terrain_builder::constraint_matches(const t_translation::t_terrain& t, const terrain_constraint& constraint) const
+{
+	if (constraint.match_index == -1) {
+		return terrain_matches(t, constraint.terrain_types_match);
+	}
+
+	std::vector<int8_t>& results = terrain_matches_[t];
+	if ((int)results.size() <= constraint.match_index) {
+		results.resize(match_indexes_, -1);
+	}
+	int8_t& result = results[constraint.match_index];
+	if (result == -1) {
+		result = terrain_matches(t, constraint.terrain_types_match)? 1: 0;
+	}
+	return result? true: false;
+}
+
 void terrain_builder::build_terrains()
 {
 	// Builds the terrain_by_type_ cache
@@ -1122,6 +1151,12 @@ void terrain_builder::build_terrains()
 	}
 	for (uint32_t rule_index = min_rule; rule_index < max_rule; rule_index ++) {
 		building_rule& rule = building_rules_[rule_index];
+		BOOST_FOREACH(terrain_constraint& constraint, rule.constraints) {
+			if (constraint.match_index == -1) {
+				constraint.match_index = match_indexes_ ++;
+			}
+		}
+
 		// Find the constraint that contains the less terrain of all terrain rules.
 		// We will keep a track of the matching terrains of this constraint
 		// and later try to apply the rule only on them
@@ -1131,7 +1166,6 @@ void terrain_builder::build_terrains()
 
 		BOOST_FOREACH(const terrain_constraint &constraint, rule.constraints)
 		{
-			const t_translation::t_match& match = constraint.terrain_types_match;
 			t_translation::t_list matching_types;
 			size_t constraint_size = 0;
 
@@ -1139,7 +1173,7 @@ void terrain_builder::build_terrains()
 					 type_it != terrain_by_type_.end(); ++type_it) {
 
 				const t_translation::t_terrain t = type_it->first;
-				if (terrain_matches(t, match)) {
+				if (constraint_matches(t, constraint)) {
 					const size_t match_size = type_it->second.size();
 					constraint_size += match_size;
 					if (constraint_size >= min_size) {
@@ -277,7 +277,8 @@ public:
 			set_flag(),
 			no_flag(),
 			has_flag(),
-			images()
+			images(),
+			match_index(-1)
 			{};
 
 		terrain_constraint(map_location loc) :
@@ -286,7 +287,8 @@ public:
 			set_flag(),
 			no_flag(),
 			has_flag(),
-			images()
+			images(),
+			match_index(-1)
 			{};
 
 		map_location loc;
@@ -295,6 +297,9 @@ public:
 		std::vector<std::string> no_flag;
 		std::vector<std::string> has_flag;
 		rule_imagelist images;
+
+		/** Slot of this constraint in terrain_matches_, -1 if not assigned yet. */
+		int match_index;
 	};
 
 	/**
@@ -792,6 +797,12 @@ public:
 	 */
 	void build_terrains();
 
+	/**
+	 * Checks whether a terrain matches the terrain_types_match of a constraint,
+	 * remembering the result for every terrain code.
+	 */
+	bool constraint_matches(const t_translation::t_terrain& t, const terrain_constraint& constraint) const;
+
 	/**
 	 * A pointer to the gamemap class used in the current level.
 	 */
@@ -823,6 +834,13 @@ public:
 	static uint32_t building_rules_size_;
 	static uint32_t unit_rules_size_;
 
+	/**
+	 * Per terrain code, match result of every constraint, indexed by match_index.
+	 * -1: not calculated yet, 0: not match, 1: match. Cached between instances as building_rules_.
+	 */
+	static std::map<t_translation::t_terrain, std::vector<int8_t> > terrain_matches_;
+	static int match_indexes_;
+
 	static std::string using_id;
 };
 
@@ -20,18 +20,28 @@
 #include "gettext.hpp"
 #include "rose_config.hpp"
 #include "log.hpp"
+#include "loadscreen.hpp"
 #include "marked-up_text.hpp"
 #include "sha1.hpp"
 #include "serialization/binary_or_text.hpp"
 #include "serialization/parser.hpp"
+#include "thread.hpp"
 
 #include <boost/foreach.hpp>
 #include <boost/algorithm/string/replace.hpp>
+#include <iomanip>
 
 static lg::log_domain log_cache("cache");
 #define ERR_CACHE LOG_STREAM(err, log_cache)
+#define LOG_CACHE LOG_STREAM(info, log_cache)
 #define DBG_CACHE LOG_STREAM(debug, log_cache)
 
+// bump it when layout of cache files changes.
+#define CACHE_FORMAT_VERSION	1
+
+// caches in different threads may read/write the same cache files.
+static threading::mutex cache_file_mutex;
+
 namespace game_config {
 
 	config_cache& config_cache::instance()
@@ -43,7 +53,8 @@ namespace game_config {
 	config_cache::config_cache() :
 		force_valid_cache_(false),
 		fake_invalid_cache_(false),
-		defines_map_()
+		defines_map_(),
+		depends_()
 	{
 		// To set-up initial defines map correctly
 		clear_defines();
@@ -99,11 +110,272 @@ namespace game_config {
 	}
 
 
+	static std::string hash_to_string(uint64_t hash)
+	{
+		std::stringstream ss;
+		ss << std::hex << std::setw(16) << std::setfill('0') << hash;
+		return ss.str();
+	}
+
+	struct tstat_hash {
+		int64_t size;
+		int64_t mtime;
+		std::string hash;
+	};
+	static std::map<std::string, tstat_hash> stat_hashes;
+	static bool stat_hashes_loaded = false;
+	static bool stat_hashes_dirty = false;
+	static threading::mutex stat_hashes_mutex;
+
+	static std::string stat_hashes_file()
+	{
+		return get_user_data_dir() + "/cache/files.cfg";
+	}
+
+	static void load_stat_hashes()
+	{
+		stat_hashes_loaded = true;
+		const std::string file = stat_hashes_file();
+		if (!file_exists(file)) {
+			return;
+		}
+		config cfg;
+		try {
+			read(cfg, read_file(file));
+		} catch (config::error& e) {
+			ERR_CACHE << "Corrupted file hashes: " << file << ", " << e.message << "\n";
+			return;
+		}
+		BOOST_FOREACH (const config& f, cfg.child_range("file")) {
+			tstat_hash& h = stat_hashes[f["name"].str()];
+			h.size = f["size"].to_long_long();
+			h.mtime = f["mtime"].to_long_long();
+			h.hash = f["hash"].str();
+		}
+	}
+
+	std::string depend_hash(const std::string& name)
+	{
+		if (is_directory(name)) {
+			std::vector<std::string> files;
+			get_files_in_dir(name, &files, NULL, ENTIRE_FILE_PATH, SKIP_MEDIA_DIR, DO_REORDER);
+
+			std::stringstream ss;
+			BOOST_FOREACH (const std::string& file, files) {
+				ss << file << '\n';
+			}
+			const std::string& str = ss.str();
+			return hash_to_string(hash64(str.c_str(), str.size()));
+		}
+
+		// empty hash never equals recorded one, a dependency that can't be stat is changed.
+		SDL_dirent st;
+		if (!SDL_GetStat(name.c_str(), &st)) {
+			return null_str;
+		}
+		{
+			threading::lock lock(stat_hashes_mutex);
+			if (!stat_hashes_loaded) {
+				load_stat_hashes();
+			}
+			std::map<std::string, tstat_hash>::const_iterator it = stat_hashes.find(name);
+			if (it != stat_hashes.end() && it->second.size == st.size && it->second.mtime == st.mtime) {
+				return it->second.hash;
+			}
+		}
+
+		// hash out of lock, other threads needn't wait for it.
+		tstat_hash h;
+		h.size = st.size;
+		h.mtime = st.mtime;
+		h.hash = hash_to_string(file_content_hash(name));
+
+		threading::lock lock(stat_hashes_mutex);
+		stat_hashes[name] = h;
+		stat_hashes_dirty = true;
+		return h.hash;
+	}
+
+	void save_depend_hashes()
+	{
+		threading::lock lock(stat_hashes_mutex);
+		if (!stat_hashes_dirty) {
+			return;
+		}
+		const std::string file = stat_hashes_file();
+		if (!create_directory_if_missing(directory_name(file))) {
+			ERR_CACHE << "Could not create cache directory: " << directory_name(file) << "\n";
+			return;
+		}
+
+		config cfg;
+		for (std::map<std::string, tstat_hash>::const_iterator it = stat_hashes.begin(); it != stat_hashes.end(); ++ it) {
+			// forget files that were removed.
+			if (!file_exists(it->first)) {
+				continue;
+			}
+			config& f = cfg.add_child("file");
+			f["name"] = it->first;
+			f["size"] = (long long)it->second.size;
+			f["mtime"] = (long long)it->second.mtime;
+			f["hash"] = it->second.hash;
+		}
+		std::stringstream ss;
+		write(ss, cfg);
+		const std::string& str = ss.str();
+		::write_file(file, str.c_str(), str.size());
+		stat_hashes_dirty = false;
+	}
+
+	static void write_define(config& cfg, const std::string& name, const preproc_define& define)
+	{
+		config& child = cfg.add_child("preproc_define");
+		child["name"] = name;
+		child["value"] = define.value;
+		child["textdomain"] = define.textdomain;
+		child["linenum"] = define.linenum;
+		child["location"] = define.location;
+		BOOST_FOREACH (const std::string& arg, define.arguments) {
+			child.add_child("argument")["name"] = arg;
+		}
+	}
+
+	std::string config_cache::cache_file_prefix(const std::string& path, const preproc_map& defines_map) const
+	{
+		std::stringstream ss;
+		ss << CACHE_FORMAT_VERSION << '\0' << path;
+		BOOST_FOREACH (const preproc_map::value_type& def, defines_map) {
+			ss << '\0' << def.first << '\0' << def.second.value << '\0' << def.second.textdomain;
+			BOOST_FOREACH (const std::string& arg, def.second.arguments) {
+				ss << '\1' << arg;
+			}
+		}
+		const std::string& str = ss.str();
+		return get_user_data_dir() + "/cache/" + hash_to_string(hash64(str.c_str(), str.size()));
+	}
+
+	bool config_cache::read_cache(const std::string& prefix, config& cfg, preproc_map& defines_map)
+	{
+		const std::string manifest_file = prefix + ".cfg";
+		const std::string bin_file = prefix + ".bin";
+		std::string manifest_str;
+		{
+			threading::lock lock(cache_file_mutex);
+			if (!file_exists(manifest_file) || !file_exists(bin_file)) {
+				return false;
+			}
+			manifest_str = read_file(manifest_file);
+		}
+
+		config manifest;
+		try {
+			read(manifest, manifest_str);
+		} catch (config::error& e) {
+			ERR_CACHE << "Corrupted cache manifest: " << manifest_file << ", " << e.message << "\n";
+			return false;
+		}
+
+		// hashing reads every dependency, do it out of lock so other threads' cache files needn't wait.
+		if (!force_valid_cache_) {
+			BOOST_FOREACH (const config& depend, manifest.child_range("depend")) {
+				const std::string hash = depend_hash(depend["name"].str());
+				if (hash.empty() || hash != depend["hash"].str()) {
+					DBG_CACHE << "cache is out of date: " << depend["name"].str() << " changed\n";
+					return false;
+				}
+			}
+		}
+
+		{
+			// another thread may have rewritten the cache meanwhile, bin must match the checked manifest.
+			threading::lock lock(cache_file_mutex);
+			if (!file_exists(bin_file) || read_file(manifest_file) != manifest_str) {
+				return false;
+			}
+			if (!wml_config_from_file(bin_file, cfg)) {
+				// truncated or corrupted bin, caller should load it cold.
+				ERR_CACHE << "Corrupted cache: " << bin_file << "\n";
+				return false;
+			}
+		}
+
+		// macros that preprocessing of path defines or undefines.
+		BOOST_FOREACH (const config& def, manifest.child_range("preproc_define")) {
+			defines_map.insert(preproc_define::read_pair(def));
+		}
+		BOOST_FOREACH (const config& undef, manifest.child_range("undef")) {
+			defines_map.erase(undef["name"].str());
+		}
+		BOOST_FOREACH (const config& depend, manifest.child_range("depend")) {
+			depends_.insert(depend["name"].str());
+		}
+		return true;
+	}
+
+	void config_cache::write_cache(const std::string& prefix, const config& cfg, const preproc_map& input_map, const preproc_map& defines_map, const std::vector<std::string>& depends)
+	{
+		if (!create_directory_if_missing(directory_name(prefix))) {
+			ERR_CACHE << "Could not create cache directory: " << directory_name(prefix) << "\n";
+			return;
+		}
+
+		config manifest;
+		std::set<std::string> hashed;
+		BOOST_FOREACH (const std::string& name, depends) {
+			if (!hashed.insert(name).second) {
+				continue;
+			}
+			config& depend = manifest.add_child("depend");
+			depend["name"] = name;
+			depend["hash"] = depend_hash(name);
+		}
+		BOOST_FOREACH (const preproc_map::value_type& def, defines_map) {
+			preproc_map::const_iterator it = input_map.find(def.first);
+			if (it == input_map.end() || it->second != def.second) {
+				write_define(manifest, def.first, def.second);
+			}
+		}
+		BOOST_FOREACH (const preproc_map::value_type& def, input_map) {
+			if (defines_map.find(def.first) == defines_map.end()) {
+				manifest.add_child("undef")["name"] = def.first;
+			}
+		}
+
+		{
+			// manifest is written last, it tells bin is complete.
+			threading::lock lock(cache_file_mutex);
+			file_remove(prefix + ".cfg");
+			wml_config_to_file(prefix + ".bin", cfg);
+
+			std::stringstream ss;
+			write(ss, manifest);
+			const std::string& str = ss.str();
+			::write_file(prefix + ".cfg", str.c_str(), str.size());
+		}
+	}
+
 	void config_cache::read_configs(const std::string& path, config& cfg, preproc_map& defines_map)
 	{
+		const Uint32 start = SDL_GetTicks();
+		const std::string prefix = cache_file_prefix(path, defines_map);
+
+		if (!fake_invalid_cache_ && read_cache(prefix, cfg, defines_map)) {
+			LOG_CACHE << "warm load of " << path << ": " << (SDL_GetTicks() - start) << " ms\n";
+			return;
+		}
+
 		//read the file and then write to the cache
-		scoped_istream stream = preprocess_file(path, &defines_map);
-		read(cfg, *stream);
+		const preproc_map input_map = defines_map;
+		std::vector<std::string> depends;
+		{
+			scoped_istream stream = preprocess_file(path, &defines_map, &depends);
+			read(cfg, *stream);
+		}
+		const Uint32 parsed = SDL_GetTicks();
+		depends_.insert(depends.begin(), depends.end());
+
+		write_cache(prefix, cfg, input_map, defines_map, depends);
+		LOG_CACHE << "cold load of " << path << ": " << (parsed - start) << " ms, write cache: " << (SDL_GetTicks() - parsed) << " ms\n";
 	}
 
 	void config_cache::load_configs(const std::string& path, config& cfg)
@@ -154,8 +426,8 @@ namespace game_config {
 		}
 	}
 
-	config_cache_transaction::state config_cache_transaction::state_ = FREE;
-	config_cache_transaction* config_cache_transaction::active_ = 0;
+	thread_local config_cache_transaction::state config_cache_transaction::state_ = FREE;
+	thread_local config_cache_transaction* config_cache_transaction::active_ = 0;
 
 	config_cache_transaction::config_cache_transaction()
 		: define_filenames_()
@@ -22,6 +22,7 @@
 #define CONFIG_CACHE_HPP_INCLUDED
 
 #include <list>
+#include <set>
 #include <boost/utility.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
@@ -72,17 +73,17 @@ namespace game_config {
 	/**
 	 * Singleton class to manage game config file caching.
 	 * It uses paths to config files as key to find correct cache
-	 * @todo Make smarter filetree checksum caching so only required parts
-	 *       of tree are checked at startup. Trees are overlapping so have
-	 *       to split trees to subtrees to only do check once per file.
-	 * @todo Make cache system easily allow validation of in memory cache objects
-	 *       using hash checksum of preproc_map.
+	 * Parsed results are cached on disk, keyed by path and preproc_map.
+	 * A cache is valid as long as contents of all files it was preprocessed
+	 * from are unchanged.
 	 **/
 	class config_cache : private boost::noncopyable {
 		private:
 
 		bool force_valid_cache_, fake_invalid_cache_;
 		preproc_map defines_map_;
+		// files and directories read since last clear_depends.
+		std::set<std::string> depends_;
 
 		void write_file(std::string file, const config& cfg);
 		void write_file(std::string file, const preproc_map&);
@@ -90,16 +91,29 @@ namespace game_config {
 		void read_configs(const std::string& path, config& cfg, preproc_map& defines);
 		void load_configs(const std::string& path, config& cfg);
 
+		/**
+		 * Cache of @a path is <prefix>.bin(xwml binary) and <prefix>.cfg(manifest).
+		 * Prefix is made from hash of path and defines, and manifest records
+		 * hash of every file and directory that preprocessor read.
+		 **/
+		std::string cache_file_prefix(const std::string& path, const preproc_map& defines) const;
+		bool read_cache(const std::string& prefix, config& cfg, preproc_map& defines);
+		void write_cache(const std::string& prefix, const config& cfg, const preproc_map& input_map, const preproc_map& defines, const std::vector<std::string>& depends);
+
 		void add_defines_map_diff(preproc_map&);
 
 		// Protected to let test code access
 		protected:
-		config_cache();
-
 		void set_force_invalid_cache(bool);
 
 
 		public:
+		/**
+		 * Besides the singleton, a private cache can be created by one that
+		 * preprocesses in other thread, i.e. studio builds bins concurrently.
+		 **/
+		config_cache();
+
 		/**
 		 * Get reference to the singleton object
 		 **/
@@ -130,7 +144,14 @@ namespace game_config {
 		void remove_define(const std::string& define);
 
 		/**
-		 * Enable/disable cache validation
+		 * Files and directories that get_config read since last clear_depends.
+		 **/
+		const std::set<std::string>& get_depends() const { return depends_; }
+		void clear_depends() { depends_.clear(); }
+
+		/**
+		 * Enable/disable cache validation.
+		 * If enabled, cache is used without checking files it depends.
 		 **/
 		void set_force_valid_cache(bool force);
 		/**
@@ -140,6 +161,19 @@ namespace game_config {
 
 	};
 
+	/**
+	 * Fingerprint of a file or directory that preprocessor read.
+	 * For file it is hash of content, remembered with size and mtime,
+	 * and file is rehashed only when they changed.
+	 * For directory it is hash of file list.
+	 **/
+	std::string depend_hash(const std::string& name);
+	/**
+	 * Write remembered file hashes to cache directory, next run reuses them.
+	 * It checks every remembered file, call it once after a whole build.
+	 **/
+	void save_depend_hashes();
+
 	class fake_transaction;
 	/**
 	 * Used to share macros between cache objects
@@ -171,8 +205,9 @@ namespace game_config {
 		void insert_to_active(const preproc_map::value_type& def);
 
 		private:
-		static state state_;
-		static config_cache_transaction* active_;
+		// transaction is per thread, so that every thread can use its own cache.
+		static thread_local state state_;
+		static thread_local config_cache_transaction* active_;
 		filenames define_filenames_;
 		preproc_map active_map_;
 
@@ -300,6 +300,7 @@ void draw()
 		SDL_RenderReadPixels(renderer, &area, get_screen_format().format, cursor_buf->pixels, 4 * area.w);
 	}
 	blit_from_surface(renderer, surf, NULL, &area);
+	add_screen_overlay(area, surf.get());
 }
 
 void undraw()
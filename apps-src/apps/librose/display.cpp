@@ -40,6 +40,7 @@
 #include "gui/auxiliary/event/handler.hpp"
 #include "gui/auxiliary/window_builder/helper.hpp"
 #include "controller_base.hpp"
+#include "benchmark.hpp"
 
 #include <boost/foreach.hpp>
 #include "SDL_image.h"
@@ -1291,6 +1292,7 @@ void display::draw_init()
 		// clip_rect_setter set_clip_rect(screen, &clip_rect);
 		texture_clip_rect_setter set_clip_rect(&clip_rect);
 		draw_background(clip_rect, border_.background_image);
+		add_screen_damage(clip_rect);
 
 		redraw_background_ = false;
 
@@ -1310,7 +1312,7 @@ void display::draw_init()
 void display::draw_wrap(bool update, bool force)
 {
 	static const int time_between_draws = 20;
-	const int current_time = SDL_GetTicks();
+	const int current_time = benchmark::get_ticks();
 	const int wait_time = nextDraw_ - current_time;
 
 	if (redrawMinimap_) {
@@ -1320,7 +1322,11 @@ void display::draw_wrap(bool update, bool force)
 
 	if (update) {
 		flip();
-		if (!force && wait_time > 0) {
+		if (benchmark::enabled()) {
+			// frames run back to back on virtual clock.
+			benchmark::end_frame();
+
+		} else if (!force && wait_time > 0) {
 			// If it's not time yet to draw, delay until it is
 			SDL_Delay(wait_time);
 		}
@@ -1333,7 +1339,7 @@ void display::draw_wrap(bool update, bool force)
 		// too late value doesn't keep growing.
 		// Note: if force is used too often,
 		// we can also get the opposite effect.
-		nextDraw_ = std::max<int>(nextDraw_, SDL_GetTicks());
+		nextDraw_ = std::max<int>(nextDraw_, benchmark::get_ticks());
 	}
 }
 
@@ -1555,6 +1561,7 @@ bool display::scroll(int xmove, int ymove)
 			SDL_RenderCopy(renderer, get_screen_texture().get(), &srcrect, NULL);
 		}
 		SDL_RenderCopy(renderer, target.get(), NULL, &dstrect);
+		add_screen_damage(map_area());
 	}
 	// Invalidate locations in the newly visible rects
 
@@ -1669,13 +1676,13 @@ void display::scroll_to_xy(int screenxpos, int screenypos, SCROLL_TYPE scroll_ty
 	const double dist_total = hypot(xmove, ymove);
 	double dist_moved = 0.0;
 
-	int t_prev = SDL_GetTicks();
+	int t_prev = benchmark::get_ticks();
 
 	double velocity = 0.0;
 	while (dist_moved < dist_total) {
 		events::pump();
 
-		int t = SDL_GetTicks();
+		int t = benchmark::get_ticks();
 		double dt = (t - t_prev) / 1000.0;
 		if (dt > 0.200) {
 			// Do not skip too many frames on slow PCs
@@ -2168,6 +2175,8 @@ void display::draw_invalidated()
 	SDL_Rect clip_rect = get_clip_rect();
 	texture screen = get_screen_texture();
 	texture_clip_rect_setter set_clip_rect(&clip_rect);
+	// sprites of a hex may overflow into its neighbours, damage one more hex around.
+	SDL_Rect damage = empty_rect;
 
 	for (int x = draw_area_rect_.left; x <= draw_area_rect_.right; x ++) {
 		for (int y = draw_area_rect_.top[x & 1]; y <= draw_area_rect_.bottom[x & 1]; y ++) {
@@ -2184,6 +2193,8 @@ void display::draw_invalidated()
 				continue;
 			}
 			draw_hex(loc);
+			benchmark::count(benchmark::HEXES);
+			damage = is_empty_rect(damage)? hex_rect: union_rects(damage, hex_rect);
 			drawn_hexes_+=1;
 			// If the tile is at the border, we start to blend it
 			if(!on_map) {
@@ -2192,6 +2203,9 @@ void display::draw_invalidated()
 			invalidated_hexes_ ++;
 		}
 	}
+	if (damage.w > 0) {
+		add_screen_damage(intersect_rects(create_rect(damage.x - zoom_, damage.y - zoom_, damage.w + 2 * zoom_, damage.h + 2 * zoom_), clip_rect));
+	}
 }
 
 void display::draw_hex(const map_location& loc) 
@@ -2640,6 +2654,7 @@ void display::draw_float_anim()
 			rect = screen_area();
 		}
 		anim.redraw(video().getTexture(), rect);
+		add_screen_damage(rect);
 	}
 
 	drawing_buffer_commit(video().getTexture(), clip_rect_commit());
@@ -24,8 +24,11 @@
 #include "display.hpp"
 #include "preferences.hpp"
 #include "gui/widgets/settings.hpp"
+#include "gui/auxiliary/timer.hpp"
 #include "posix2.h"
 #include "base_instance.hpp"
+#include "benchmark.hpp"
+#include "wml_exception.hpp"
 
 #include "SDL.h"
 
@@ -48,7 +51,7 @@ void base_finger::process_event(const SDL_Event& event)
 	int x, y, dx, dy;
 	bool hit = false;
 	Uint8 mouse_flags;
-	Uint32 now = SDL_GetTicks();
+	Uint32 now = benchmark::get_ticks();
 
 	unsigned screen_width2 = gui2::settings::screen_width;
 	unsigned screen_height2 = gui2::settings::screen_height;
@@ -175,7 +178,7 @@ void base_finger::process_event(const SDL_Event& event)
 		if (mouse_flags & SDL_BUTTON(SDL_BUTTON_LEFT) && abs(event.wheel.y) >= MOUSE_MOTION_THRESHOLD) {
 			// left mouse + wheel vetical ==> pinch
 			mouse_motions_ ++;
-			Uint32 now = SDL_GetTicks();
+			Uint32 now = benchmark::get_ticks();
 			if (now - last_pinch_ticks_ > pinch_noisc_time_) {
 				last_pinch_ticks_ = now;
 				handle_pinch(x, y, event.wheel.y > 0);
@@ -316,6 +319,81 @@ void dump_events(const std::vector<SDL_Event>& events)
 	posix_print("%s\n", ss.str().c_str());
 }
 
+/**
+ * Merges @event into the buffered motion or wheel event of the same pointer,
+ * keeping the latest position and accumulating the deltas. Only the
+ * trailing run of events of the same type is searched, so any other event,
+ * e.g. a button change, always separates motions.
+ */
+static bool coalesce_event(std::vector<SDL_Event>& events, const SDL_Event& event)
+{
+	if (events.empty() || events.back().type != event.type) {
+		return false;
+	}
+	SDL_Event& last = events.back();
+
+	if (event.type == SDL_MOUSEMOTION) {
+		if (last.motion.windowID != event.motion.windowID || last.motion.which != event.motion.which || last.motion.state != event.motion.state) {
+			return false;
+		}
+		last.motion.timestamp = event.motion.timestamp;
+		last.motion.x = event.motion.x;
+		last.motion.y = event.motion.y;
+		last.motion.xrel += event.motion.xrel;
+		last.motion.yrel += event.motion.yrel;
+		return true;
+
+	} else if (event.type == SDL_MOUSEWHEEL) {
+		if (last.wheel.windowID != event.wheel.windowID || last.wheel.which != event.wheel.which || last.wheel.direction != event.wheel.direction) {
+			return false;
+		}
+		last.wheel.timestamp = event.wheel.timestamp;
+		last.wheel.x += event.wheel.x;
+		last.wheel.y += event.wheel.y;
+		return true;
+
+	} else if (event.type == SDL_FINGERMOTION) {
+		// fingers of one gesture move interleaved.
+		for (std::vector<SDL_Event>::reverse_iterator it = events.rbegin(); it != events.rend() && it->type == SDL_FINGERMOTION; ++ it) {
+			SDL_TouchFingerEvent& finger = it->tfinger;
+			if (finger.touchId == event.tfinger.touchId && finger.fingerId == event.tfinger.fingerId) {
+				finger.timestamp = event.tfinger.timestamp;
+				finger.x = event.tfinger.x;
+				finger.y = event.tfinger.y;
+				finger.dx += event.tfinger.dx;
+				finger.dy += event.tfinger.dy;
+				finger.pressure = event.tfinger.pressure;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+// pump() can be reentered from a handler (a nested dialog), every level
+// reuses its own buffer. deque keeps the outer levels' buffers in place.
+static std::deque<std::vector<SDL_Event> > event_buffers;
+static size_t pump_depth = 0;
+static int last_pump_events = 0;
+
+struct tpump_depth_lock
+{
+	tpump_depth_lock()
+	{
+		if (event_buffers.size() <= pump_depth) {
+			event_buffers.push_back(std::vector<SDL_Event>());
+		}
+		events = &event_buffers[pump_depth ++];
+		events->clear();
+	}
+	~tpump_depth_lock()
+	{
+		pump_depth --;
+	}
+
+	std::vector<SDL_Event>* events;
+};
+
 void pump()
 {
 	if (instance->terminating()) {
@@ -328,18 +406,23 @@ void pump()
 	int begin_ignoring = 0;
 	ignore_finger_event = false;
 
-	std::vector<SDL_Event> events;
+	tpump_depth_lock depth_lock;
+	std::vector<SDL_Event>& events = *depth_lock.events;
 	// ignore user input events when receive SDL_WINDOWEVENT. include before and after.
 	while (SDL_PollEvent(&temp_event)) {
 		++ poll_count;
 		if (!begin_ignoring && temp_event.type == SDL_WINDOWEVENT) {
-			begin_ignoring = poll_count;
+			begin_ignoring = events.size() + 1;
 		} else if (begin_ignoring > 0 && temp_event.type >= INPUT_MASK_MIN && temp_event.type <= INPUT_MASK_MAX) {
 			//ignore user input events that occurred after the window was activated
 			continue;
 		}
+		if (coalesce_event(events, temp_event)) {
+			continue;
+		}
 		events.push_back(temp_event);
 	}
+	last_pump_events = events.size();
 
 	if (events.size() > 10) {
 		posix_print("------waring!! events.size(): %u, last_event: %i\n", events.size(), events.back().type);
@@ -386,6 +469,7 @@ void pump()
 
 				} else if (event.window.event == SDL_WINDOWEVENT_EXPOSED) {
 					// if the window must be redrawn, update the entire screen
+					add_screen_damage_full();
 
 				} else if (event.window.event == SDL_WINDOWEVENT_RESIZED) {
 					
@@ -437,6 +521,8 @@ void pump()
 
 	}
 
+	gui2::expire_timers();
+
 	instance->webrtc_pump();
 
 	// inform the pump monitors that an events::pump() has occurred
@@ -467,6 +553,39 @@ void raise_draw_event()
 	}
 }
 
+int frame_interval = 10;
+int idle_interval = 10;
+
+void wait_frame()
+{
+	if (benchmark::enabled()) {
+		// frames run back to back on virtual clock.
+		benchmark::end_frame();
+		return;
+	}
+
+	static Uint32 next_frame = 0;
+
+	Uint32 now = SDL_GetTicks();
+	const int interval = last_pump_events? frame_interval: idle_interval;
+	if ((int)(now - next_frame) > interval) {
+		// fell behind, or first frame. restart the schedule.
+		next_frame = now;
+	}
+	next_frame += interval;
+
+	// return early when input arrives or a timer is due, it is handled in
+	// this frame and the schedule restarts from it.
+	while ((int)(next_frame - now) > 0) {
+		const int wait = gui2::timer_wait_ms(next_frame - now);
+		if (!wait || SDL_WaitEventTimeout(NULL, wait)) {
+			next_frame = now;
+			break;
+		}
+		now = SDL_GetTicks();
+	}
+}
+
 int discard(Uint32 event_mask_min, Uint32 event_mask_max)
 {
 	int discard_count = 0;
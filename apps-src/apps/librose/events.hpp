@@ -132,6 +132,20 @@ private:
 
 int discard(Uint32 event_mask_min, Uint32 event_mask_max);
 
+/** Milliseconds between frames of wait_frame(). */
+extern int frame_interval;
+/**
+ * Milliseconds between frames when the last pump() dispatched no event.
+ * Same as frame_interval by default, app can raise it to save idle CPU.
+ */
+extern int idle_interval;
+
+/**
+ * Waits for the next frame deadline of a main loop. Returns as soon as an
+ * event is queued, so input doesn't wait for the rest of the interval.
+ */
+void wait_frame();
+
 void raise_process_event();
 void raise_draw_event();
 
@@ -32,11 +32,20 @@
 #ifdef _WIN32
 #include <shlobj.h>	// CSIDL_PROGRAM_FILES
 #include <direct.h>
+#include <io.h> // _commit
 #include <cctype>
 #else /* !_WIN32 */
 #include <unistd.h>
 #include <dirent.h>
 #include <libgen.h>
+#include <fcntl.h>
+#if defined(__linux__) && !defined(ANDROID)
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#ifndef FICLONE
+#define FICLONE _IOW(0x94, 9, int) // reflink, <linux/fs.h>
+#endif
+#endif
 #ifndef ANDROID
 #include <sys/param.h> // statfs 
 #include <sys/mount.h> // statfs
@@ -50,6 +59,7 @@
 #include <fstream>
 #include <iomanip>
 #include <set>
+#include <memory>
 #include <boost/algorithm/string.hpp>
 
 // for strerror
@@ -67,6 +77,7 @@
 #include "saes.hpp"
 #include "version.hpp"
 #include "wml_exception.hpp"
+#include "thread.hpp"
 
 #include <boost/foreach.hpp>
 #include <boost/bind.hpp>
@@ -701,6 +712,46 @@ void write_file(const std::string& fname, const char* data, int len)
 	posix_fclose(fp);
 }
 
+bool write_file_atomic(const std::string& fname, const char* data, int len)
+{
+	const std::string tmp = fname + ".tmp";
+	std::string tmp2 = tmp;
+	std::string fname2 = fname;
+#ifdef _WIN32
+	conv_ansi_utf8(tmp2, false);
+	conv_ansi_utf8(fname2, false);
+#endif
+
+	FILE* fp = fopen(tmp2.c_str(), "wb");
+	if (!fp) {
+		return false;
+	}
+	bool ok = fwrite(data, 1, len, fp) == (size_t)len && fflush(fp) == 0;
+	if (ok) {
+		// the data must be on disk before the rename makes it the file.
+#ifdef _WIN32
+		ok = _commit(_fileno(fp)) == 0;
+#else
+		ok = fsync(fileno(fp)) == 0;
+#endif
+	}
+	ok = fclose(fp) == 0 && ok;
+	if (!ok) {
+		remove(tmp2.c_str());
+		return false;
+	}
+
+#ifdef _WIN32
+	ok = MoveFileExA(tmp2.c_str(), fname2.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	ok = rename(tmp2.c_str(), fname2.c_str()) == 0;
+#endif
+	if (!ok) {
+		remove(tmp2.c_str());
+	}
+	return ok;
+}
+
 std::string read_map(const std::string& name)
 {
 	std::string res;
@@ -781,6 +832,37 @@ int64_t file_size(const std::string& fname, bool to_utf16)
 	return fsize;
 }
 
+uint64_t hash64(const void* data, size_t len, uint64_t seed)
+{
+	// FNV-1a, but mix one 64-bit word at a time.
+	const uint64_t prime = 0x100000001b3ULL;
+	const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+	uint64_t h = seed ^ (len * prime);
+	uint64_t k;
+
+	for (; len >= 8; p += 8, len -= 8) {
+		memcpy(&k, p, 8);
+		h ^= k;
+		h *= prime;
+		h ^= h >> 32;
+	}
+	for (; len; p ++, len --) {
+		h ^= *p;
+		h *= prime;
+	}
+	return h;
+}
+
+uint64_t file_content_hash(const std::string& fname)
+{
+	tfile lock(fname, GENERIC_READ, OPEN_EXISTING);
+	int32_t fsize = lock.read_2_data();
+	if (!fsize) {
+		return 0;
+	}
+	return hash64(lock.data, fsize);
+}
+
 int64_t disk_free_space(const std::string& root_name)
 {
 	int64_t ret = -1;
@@ -1262,6 +1344,187 @@ bool walk_dir(const std::string& rootdir, bool subfolders, const twalk_dir_funct
 	return ret;
 }
 
+// parallel copy engine.
+// directories are created on the calling thread while walking src, so workers
+// only write regular files and never race on SDL_MakeDirectory. every file is
+// verified by the byte count the copy reported against the source size, this
+// replaces the existence-only second walk compare_directory did.
+class tcopy_engine
+{
+public:
+	struct tjob {
+		tjob(const std::string& src, const std::string& dst)
+			: src(src)
+			, dst(dst)
+		{}
+
+		std::string src;
+		std::string dst;
+	};
+
+	tcopy_engine()
+		: jobs_()
+	{
+		SDL_AtomicSet(&next_, 0);
+		SDL_AtomicSet(&failed_, 0);
+	}
+
+	void add_file(const std::string& src, const std::string& dst) { jobs_.push_back(tjob(src, dst)); }
+	bool add_directory(const std::string& src, const std::string& dst);
+	bool run();
+
+private:
+	static int thread_main(void* data);
+	void work();
+	static bool copy_one(const tjob& job);
+
+private:
+	std::vector<tjob> jobs_;
+	SDL_atomic_t next_;
+	SDL_atomic_t failed_;
+};
+
+bool tcopy_engine::add_directory(const std::string& src, const std::string& dst)
+{
+	if (!SDL_MakeDirectory(dst.c_str())) {
+		return false;
+	}
+
+	SDL_DIR* dir = SDL_OpenDir(src.c_str());
+	if (!dir) {
+		return false;
+	}
+	bool ret = true;
+	SDL_dirent2* dirent;
+	while (ret && (dirent = SDL_ReadDir(dir))) {
+		if (SDL_DIRENT_DIR(dirent->mode)) {
+			if (SDL_strcmp(dirent->name, ".") && SDL_strcmp(dirent->name, "..")) {
+				ret = add_directory(src + '/' + dirent->name, dst + '/' + dirent->name);
+			}
+		} else {
+			add_file(src + '/' + dirent->name, dst + '/' + dirent->name);
+		}
+	}
+	SDL_CloseDir(dir);
+	return ret;
+}
+
+bool tcopy_engine::copy_one(const tjob& job)
+{
+#ifdef _WIN32
+	return SDL_CopyFiles(job.src.c_str(), job.dst.c_str())? true: false;
+#else
+	int in = open(job.src.c_str(), O_RDONLY);
+	if (in < 0) {
+		return false;
+	}
+	struct stat st;
+	if (fstat(in, &st) != 0) {
+		close(in);
+		return false;
+	}
+	int out = open(job.dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC, st.st_mode & 0777);
+	if (out < 0) {
+		close(in);
+		return false;
+	}
+
+	const off_t size = st.st_size;
+	off_t copied = 0;
+#if defined(__linux__) && !defined(ANDROID)
+	// same filesystem with reflink support(btrfs, xfs): share extents, copy nothing.
+	if (size > 0 && ioctl(out, FICLONE, in) == 0) {
+		copied = size;
+	}
+#ifdef __NR_copy_file_range
+	// in-kernel copy, no round trip through user space.
+	while (copied < size) {
+		ssize_t n = syscall(__NR_copy_file_range, in, NULL, out, NULL, (size_t)(size - copied), 0);
+		if (n <= 0) {
+			// EXDEV/ENOSYS/EINVAL on old kernels or cross-device, fall back to buffered copy.
+			break;
+		}
+		copied += n;
+	}
+	if (copied != 0 && copied < size) {
+		lseek(in, copied, SEEK_SET);
+		lseek(out, copied, SEEK_SET);
+	}
+#endif
+#endif
+
+	if (copied < size) {
+		const size_t buf_size = 256 * 1024;
+		std::unique_ptr<char[]> buf(new char[buf_size]);
+		ssize_t n;
+		while ((n = read(in, buf.get(), buf_size)) > 0) {
+			const char* ptr = buf.get();
+			ssize_t left = n;
+			while (left > 0) {
+				ssize_t w = write(out, ptr, left);
+				if (w <= 0) {
+					break;
+				}
+				ptr += w;
+				left -= w;
+			}
+			if (left) {
+				break;
+			}
+			copied += n;
+		}
+	}
+	close(in);
+
+	struct stat st2;
+	bool ret = fstat(out, &st2) == 0 && copied == size && st2.st_size == size;
+	ret = close(out) == 0 && ret;
+	return ret;
+#endif
+}
+
+int tcopy_engine::thread_main(void* data)
+{
+	reinterpret_cast<tcopy_engine*>(data)->work();
+	return 0;
+}
+
+void tcopy_engine::work()
+{
+	const int size = jobs_.size();
+	int at;
+	while (!SDL_AtomicGet(&failed_) && (at = SDL_AtomicAdd(&next_, 1)) < size) {
+		const tjob& job = jobs_[at];
+		if (!copy_one(job)) {
+			ERR_FS << "copy " << job.src << " to " << job.dst << " fail!\n";
+			SDL_AtomicSet(&failed_, 1);
+		}
+	}
+}
+
+bool tcopy_engine::run()
+{
+	// small files are latency bound, a few workers keep the disk queue full.
+	const int max_workers = 8;
+	int workers = std::min(std::max(SDL_GetCPUCount(), 2), max_workers);
+	workers = std::min(workers, (int)jobs_.size());
+
+	if (workers <= 1) {
+		work();
+	} else {
+		std::vector<threading::thread*> threads;
+		for (int n = 1; n < workers; n ++) {
+			threads.push_back(new threading::thread(thread_main, this));
+		}
+		work();
+		// thread's destructor joins.
+		for (std::vector<threading::thread*>::const_iterator it = threads.begin(); it != threads.end(); ++ it) {
+			delete *it;
+		}
+	}
+	return !SDL_AtomicGet(&failed_);
+}
+
 bool copy_root_files(const std::string& src, const std::string& dst, std::set<std::string>* files)
 {
 	if (files) {
@@ -1272,8 +1535,7 @@ bool copy_root_files(const std::string& src, const std::string& dst, std::set<st
 		return false;
 	}
 
-	SDL_bool ret = SDL_TRUE;
-	std::stringstream src_ss, dst_ss;
+	tcopy_engine engine;
 	SDL_DIR* dir = SDL_OpenDir(src.c_str());
 	if (!dir) {
 		return false;
@@ -1282,15 +1544,7 @@ bool copy_root_files(const std::string& src, const std::string& dst, std::set<st
 	
 	while ((dirent = SDL_ReadDir(dir))) {
 		if (!SDL_DIRENT_DIR(dirent->mode)) {
-			src_ss.str("");
-			dst_ss.str("");
-			src_ss << src << '/' << dirent->name;
-			dst_ss << dst << '/' << dirent->name;
-			ret = SDL_CopyFiles(src_ss.str().c_str(), dst_ss.str().c_str());
-
-			if (!ret) {
-				break;
-			}
+			engine.add_file(src + '/' + dirent->name, dst + '/' + dirent->name);
 			if (files) {
 				files->insert(dirent->name);
 			}
@@ -1298,7 +1552,7 @@ bool copy_root_files(const std::string& src, const std::string& dst, std::set<st
 	}
 	SDL_CloseDir(dir);
 
-	return ret? true: false;
+	return engine.run();
 }
 
 class tcompare_dir_param
@@ -1381,6 +1635,23 @@ bool compare_directory(const std::string& dir1, const std::string& dir2)
 	return true;
 }
 
+bool copy_files_parallel(const std::string& src, const std::string& dst)
+{
+	if (src.empty() || dst.empty()) {
+		return false;
+	}
+
+	tcopy_engine engine;
+	if (is_directory(src)) {
+		if (!engine.add_directory(src, dst)) {
+			return false;
+		}
+	} else {
+		engine.add_file(src, dst);
+	}
+	return engine.run();
+}
+
 scoped_istream& scoped_istream::operator=(std::istream *s)
 {
 	delete stream;
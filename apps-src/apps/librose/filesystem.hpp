@@ -99,6 +99,11 @@ std::string read_file(const std::string &fname);
 std::istream *istream_file(const std::string &fname, bool to_utf16 = false);
 /** Throws io_exception if an error occurs. */
 void write_file(const std::string& fname, const char* data, int len);
+/**
+ * Writes to fname.tmp, flushes it to disk and renames it over fname, so a
+ * crash leaves either the old or the new file. Returns false on failure.
+ */
+bool write_file_atomic(const std::string& fname, const char* data, int len);
 
 std::string read_map(const std::string& name);
 
@@ -157,6 +162,11 @@ void data_tree_checksum(const std::vector<std::string>& paths, file_tree_checksu
 int64_t file_size(const std::string& fname, bool to_utf16);
 int64_t disk_free_space(const std::string& root_name);
 
+/** 64-bit non-cryptographic hash, fast enough to fingerprint file contents. */
+uint64_t hash64(const void* data, size_t len, uint64_t seed = 0xcbf29ce484222325ULL);
+/** Returns hash64 of the file's contents, or 0 if it cannot be read. */
+uint64_t file_content_hash(const std::string& fname);
+
 bool ends_with(const std::string& str, const std::string& suffix);
 
 char path_sep(bool standard);
@@ -189,6 +199,10 @@ typedef boost::function<bool (const std::string& dir, const SDL_dirent2* dirent)
 bool walk_dir(const std::string& rootdir, bool subfolders, const twalk_dir_function& fn);
 bool copy_root_files(const std::string& src, const std::string& dst, std::set<std::string>* files);
 bool compare_directory(const std::string& dir1, const std::string& dir2);
+// copy a file or a whole directory tree, files are copied by a pool of workers.
+// on Linux it tries reflink, then copy_file_range, before buffered read/write.
+// every file's copied size is checked, no need to call compare_directory after it.
+bool copy_files_parallel(const std::string& src, const std::string& dst);
 
 /**
  *  The paths manager is responsible for recording the various paths
@@ -37,6 +37,7 @@
 #include "integrate.hpp"
 
 #include <boost/foreach.hpp>
+#include <boost/unordered_map.hpp>
 #include <list>
 #include <set>
 #include <stack>
@@ -192,6 +193,42 @@ typedef std::map<std::string,SDL_Rect> line_size_cache_map;
 //map of styles -> sizes -> cache
 static std::map<int,std::map<int,line_size_cache_map> > line_size_cache;
 
+namespace font {
+
+// metrics of glyphs in one font, size and style. tline_measurer use them.
+struct tglyph_cache
+{
+	struct tglyph {
+		int advance;
+		// maxx without bold overhang, italic slant is in it.
+		int maxx;
+		// false if font has no glyph of it, SDL_ttf doesn't kern such glyph.
+		bool provided;
+	};
+
+	tglyph_cache()
+		: font(NULL)
+		, overhang(0)
+		, kerning(false)
+		, glyphs()
+		, kernings()
+	{}
+
+	const tglyph& glyph(Uint16 ch, int style);
+	int kerning_size(Uint16 previous, Uint16 ch, int style);
+
+	TTF_Font* font;
+	int overhang;
+	bool kerning;
+	boost::unordered_map<Uint16, tglyph> glyphs;
+	boost::unordered_map<Uint32, int> kernings;
+};
+
+}
+
+//map of styles -> font id -> glyph metrics
+static std::map<int, std::map<font_id, font::tglyph_cache> > glyph_caches;
+
 //Splits the UTF-8 text into text_chunks using the same font.
 static std::vector<text_chunk> split_text(std::string const & utf8_text) 
 {
@@ -296,6 +333,7 @@ static void clear_fonts()
 	font_names.clear();
 	char_blocks.cbmap.clear();
 	line_size_cache.clear();
+	glyph_caches.clear();
 }
 
 namespace {
@@ -821,6 +859,146 @@ SDL_Rect line_size(const std::string& line, int font_size, int style)
 	return res;
 }
 
+const tglyph_cache::tglyph& tglyph_cache::glyph(Uint16 ch, int style)
+{
+	boost::unordered_map<Uint16, tglyph>::const_iterator it = glyphs.find(ch);
+	if (it != glyphs.end()) {
+		return it->second;
+	}
+
+	tglyph glyph;
+	font_style_setter const style_setter(font, style);
+	int minx, maxx, miny, maxy;
+	if (TTF_GlyphMetrics(font, ch, &minx, &maxx, &miny, &maxy, &glyph.advance) == 0) {
+		// TTF_GlyphMetrics adds overhang to maxx when bold
+		glyph.maxx = maxx - overhang;
+	} else {
+		glyph.advance = glyph.maxx = 0;
+	}
+	glyph.provided = TTF_GlyphIsProvided(font, ch) != 0;
+	return glyphs.insert(std::make_pair(ch, glyph)).first->second;
+}
+
+int tglyph_cache::kerning_size(Uint16 previous, Uint16 ch, int style)
+{
+	const Uint32 key = (previous << 16) | ch;
+	boost::unordered_map<Uint32, int>::const_iterator it = kernings.find(key);
+	if (it != kernings.end()) {
+		return it->second;
+	}
+
+	font_style_setter const style_setter(font, style);
+	const int size = TTF_GetFontKerningSizeGlyphs(font, previous, ch);
+	kernings.insert(std::make_pair(key, size));
+	return size;
+}
+
+tline_measurer::tline_measurer(int font_size, int style)
+	: font_size_(font_size)
+	, style_(style)
+	, subset_(0)
+	, cache_(NULL)
+	, width_(0)
+	, x_(0)
+	, chunk_maxx_(0)
+	, previous_(0)
+	, empty_(true)
+{}
+
+void tline_measurer::clear()
+{
+	cache_ = NULL;
+	width_ = 0;
+	x_ = 0;
+	chunk_maxx_ = 0;
+	previous_ = 0;
+	empty_ = true;
+}
+
+void tline_measurer::start_chunk(int subset)
+{
+	width_ += chunk_maxx_;
+	subset_ = subset;
+	x_ = 0;
+	chunk_maxx_ = 0;
+	previous_ = 0;
+
+	const font_id id(subset, font_size_);
+	TTF_Font* ttfont = get_font(id);
+	if (ttfont == NULL) {
+		cache_ = NULL;
+		return;
+	}
+	cache_ = &glyph_caches[style_][id];
+	if (!cache_->font) {
+		cache_->font = ttfont;
+		font_style_setter const style_setter(ttfont, style_);
+		cache_->kerning = TTF_GetFontKerning(ttfont) != 0;
+		if (style_ & TTF_STYLE_BOLD) {
+			// TTF_SizeUTF8 adds overhang before every glyph, but SDL_ttf doesn't export it.
+			int advance, w1, w2, h;
+			TTF_GlyphMetrics(ttfont, ' ', NULL, NULL, NULL, NULL, &advance);
+			TTF_SizeUTF8(ttfont, " ", &w1, &h);
+			TTF_SizeUTF8(ttfont, "  ", &w2, &h);
+			cache_->overhang = w2 - w1 - advance;
+		}
+	}
+}
+
+void tline_measurer::push(wchar_t wch)
+{
+	// same as TTF_SizeUTF8, that measures every chunk that split_text splits.
+	const subset_id subset = char_blocks.get_id(wch);
+	if (empty_) {
+		empty_ = false;
+		start_chunk(subset >= 0? subset: 0);
+	} else if (subset >= 0 && subset != subset_) {
+		start_chunk(subset);
+	}
+	const Uint16 ch = static_cast<Uint16>(wch);
+	if (cache_ == NULL || ch == UNICODE_BOM_NATIVE || ch == UNICODE_BOM_SWAPPED) {
+		return;
+	}
+
+	const tglyph_cache::tglyph& glyph = cache_->glyph(ch, style_);
+	if (cache_->kerning && previous_ && glyph.provided) {
+		x_ += cache_->kerning_size(previous_, ch, style_);
+	}
+	// TTF_SizeUTF8 returns maxx, not maxx - minx, left bearing doesn't count.
+	// overhang goes after minx, before maxx, same as it.
+	x_ += cache_->overhang;
+	const int z = x_ + std::max(glyph.advance, glyph.maxx);
+	if (z > chunk_maxx_) {
+		chunk_maxx_ = z;
+	}
+	x_ += glyph.advance;
+	previous_ = glyph.provided? ch: 0;
+}
+
+void tline_measurer::push(const std::string& text)
+{
+	for (utils::utf8_iterator it(text); it != utils::utf8_iterator::end(text); ++ it) {
+		push(*it);
+	}
+}
+
+int check_line_measurer(const std::string& text, int font_size, int style)
+{
+	tline_measurer measurer(font_size, style);
+	std::string prefix;
+	int mismatches = 0;
+	for (utils::utf8_iterator it(text); it != utils::utf8_iterator::end(text); ++ it) {
+		prefix.append(it.substr().first, it.substr().second);
+		measurer.push(*it);
+		const int width = line_width(prefix, font_size, style);
+		if (measurer.width() != width) {
+			ERR_FT << "tline_measurer: '" << prefix << "' (size " << font_size << ", style " << style << ") is " << measurer.width() << ", TTF_SizeUTF8 is " << width << "\n";
+			mismatches ++;
+		}
+	}
+	return mismatches;
+}
+
 std::string make_text_ellipsis(const std::string &text, int font_size, int max_width, int style)
 {
 	static const std::string ellipsis = "...";
@@ -1010,6 +1188,7 @@ void floating_label::draw(texture& screen)
 	texture_from_texture(screen, buf_, &rect, 0, 0);
 
 	blit_from_surface(renderer, surf_, NULL, &rect);
+	add_screen_overlay(intersect_rects(rect, clip_rect_), surf_.get());
 }
 
 void floating_label::undraw(texture& screen)
@@ -94,6 +94,45 @@ int line_minus1_width(const std::string& text, int font_size, int style);
 ///
 SDL_Rect line_size(const std::string& line, int font_size, int style=TTF_STYLE_NORMAL);
 
+struct tglyph_cache;
+
+///
+/// Measure width of a line char by char. Width is what line_width returns,
+/// but it is calculated from cached glyph advance and kerning, so appending
+/// one char costs O(1), not a measurement of the whole line.
+///
+class tline_measurer
+{
+public:
+	tline_measurer(int font_size, int style);
+
+	void clear();
+	void push(wchar_t ch);
+	void push(const std::string& text);
+	int width() const { return width_ + chunk_maxx_; }
+
+private:
+	void start_chunk(int subset);
+
+private:
+	int font_size_;
+	int style_;
+	int subset_;
+	tglyph_cache* cache_;
+	// sum width of previous chunks, a chunk is text that uses same font.
+	int width_;
+	int x_;
+	int chunk_maxx_;
+	Uint16 previous_;
+	bool empty_;
+};
+
+///
+/// Compare width of every prefix of text that tline_measurer calculates with
+/// line_width, which is TTF_SizeUTF8. Return how many prefixes differ.
+///
+int check_line_measurer(const std::string& text, int font_size, int style);
+
 /**
  * If the text excedes the specified max width, end it with an ellipsis (...)
  */
@@ -121,6 +121,18 @@ public:
 	 */
 	void set_cfg(const config& cfg) { parse_cfg(cfg, shapes_, &blur_depth_); }
 
+	/**
+	 * Sets shapes parsed in advance by parse_cfg.
+	 *
+	 * Shapes are shared, not copied, so builders can parse once and set them
+	 * on every canvas they build.
+	 */
+	void set_shapes(const std::vector<tshape_ptr>& shapes, unsigned blur_depth)
+	{
+		shapes_ = shapes;
+		blur_depth_ = blur_depth;
+	}
+
 	/***** ***** ***** setters / getters for members ***** ****** *****/
 
 	void set_width(const unsigned width) { w_ = width; set_dirty(); }
@@ -22,6 +22,8 @@
 
 #include <boost/mpl/for_each.hpp>
 
+#include <algorithm>
+
 namespace gui2 {
 
 namespace event {
@@ -273,6 +275,50 @@ inline bool find(E event, F functor)
 
 namespace implementation {
 
+/**
+ * The widgets with the events to call for them.
+ *
+ * Every fired event builds one, and the chain seldom is deeper than a few
+ * containers, so it keeps the first entries inline and only goes to the
+ * heap for unusually deep chains.
+ */
+class tevent_chain
+{
+public:
+	typedef std::pair<twidget*, tevent> value_type;
+
+	tevent_chain()
+		: size_(0)
+		, overflow_()
+	{}
+
+	void push_back(const value_type& value)
+	{
+		if (size_ < inline_size) {
+			inline_[size_ ++] = value;
+			return;
+		}
+		if (overflow_.empty()) {
+			overflow_.assign(inline_, inline_ + inline_size);
+		}
+		overflow_.push_back(value);
+		size_ ++;
+	}
+
+	bool empty() const { return !size_; }
+	int size() const { return size_; }
+
+	value_type* begin() { return size_ <= inline_size? inline_: &overflow_[0]; }
+	value_type* end() { return begin() + size_; }
+
+private:
+	enum {inline_size = 16};
+
+	int size_;
+	value_type inline_[inline_size];
+	std::vector<value_type> overflow_;
+};
+
 /*
  * Small sample to illustrate the effects of the various build_event_chain
  * functions. Assume the widgets are in an window with the following widgets:
@@ -313,8 +359,7 @@ namespace implementation {
  * @param dispatcher              The final widget to test, this is also the
  *                                dispatcher the sends the event.
  * @param widget                  The widget should parent(s) to check.
- *
- * @returns                       The list of widgets with a handler.
+ * @param result                  Receives the list of widgets with a handler.
  *                                The order will be (assuming all have a
  *                                handler):
  *                                * container 2
@@ -322,16 +367,15 @@ namespace implementation {
  *                                * dispatcher
  */
 template<class T>
-inline std::vector<std::pair<twidget*, tevent> > build_event_chain(
+inline void build_event_chain(
 		  const tevent event
 		, twidget* dispatcher
-		, twidget* widget)
+		, twidget* widget
+		, tevent_chain& result)
 {
 	assert(dispatcher);
 	assert(widget);
 
-	std::vector<std::pair<twidget*, tevent> > result;
-
 	while(widget != dispatcher) {
 		widget = widget->parent();
 		assert(widget);
@@ -342,8 +386,6 @@ inline std::vector<std::pair<twidget*, tevent> > build_event_chain(
 			result.push_back(std::make_pair(widget, event));
 		}
 	}
-
-	return result;
 }
 
 /**
@@ -353,14 +395,15 @@ inline std::vector<std::pair<twidget*, tevent> > build_event_chain(
  * Since the pre and post queues are unused, it validates whether they are
  * empty (using asserts).
  *
- * @returns                       An empty vector.
+ * @param result                  Left empty.
  */
 template<>
-inline std::vector<std::pair<twidget*, tevent> >
+inline void
 build_event_chain<tsignal_notification_function>(
 		  const tevent event
 		, twidget* dispatcher
-		, twidget* widget)
+		, twidget* widget
+		, tevent_chain& /*result*/)
 {
 	assert(dispatcher);
 	assert(widget);
@@ -370,8 +413,6 @@ build_event_chain<tsignal_notification_function>(
 			, tdispatcher::tevent_type(
 					  tdispatcher::pre
 					| tdispatcher::post)));
-
-	return std::vector<std::pair<twidget*, tevent> >();
 }
 
 #ifdef _MSC_VER
@@ -388,7 +429,7 @@ build_event_chain<tsignal_notification_function>(
  *
  * @pre                           dispatcher == widget
  *
- * @returns                       The list of widgets with a handler.
+ * @param result                  Receives the list of widgets with a handler.
  *                                The order will be (assuming all have a
  *                                handler):
  *                                * window
@@ -396,18 +437,17 @@ build_event_chain<tsignal_notification_function>(
  *                                * container 2
  */
 template<>
-inline std::vector<std::pair<twidget*, tevent> >
+inline void
 build_event_chain<tsignal_message_function>(
 		  const tevent event
 		, twidget* dispatcher
-		, twidget* widget)
+		, twidget* widget
+		, tevent_chain& result)
 {
 	assert(dispatcher);
 	assert(widget);
 	assert(widget == dispatcher);
 
-	std::vector<std::pair<twidget*, tevent> > result;
-
 	/* We only should add the parents of the widget to the chain. */
 	while((widget = widget->parent())) {
 		assert(widget);
@@ -415,11 +455,12 @@ build_event_chain<tsignal_message_function>(
 		if(widget->has_event(event, tdispatcher::tevent_type(
 				tdispatcher::pre | tdispatcher::post))) {
 
-			result.insert(result.begin(), std::make_pair(widget, event));
+			result.push_back(std::make_pair(widget, event));
 		}
 	}
 
-	return result;
+	// collected from widget upwards, the chain goes from window downwards.
+	std::reverse(result.begin(), result.end());
 }
 #ifdef _MSC_VER
 #pragma warning (pop)
@@ -433,7 +474,7 @@ build_event_chain<tsignal_message_function>(
  */
 template<class T, class F>
 inline bool fire_event(const tevent event
-		, std::vector<std::pair<twidget*, tevent> >& event_chain
+		, tevent_chain& event_chain
 		, twidget* dispatcher
 		, twidget* widget
 		, F functor)
@@ -442,10 +483,10 @@ inline bool fire_event(const tevent event
 	bool halt = false;
 
 	/***** ***** ***** Pre ***** ***** *****/
-	for(std::vector<std::pair<twidget*, tevent> >
-				::reverse_iterator ritor_widget = event_chain.rbegin();
-			ritor_widget != event_chain.rend();
-			++ritor_widget) {
+	for(tevent_chain::value_type* ritor_widget = event_chain.end();
+			ritor_widget != event_chain.begin();
+			) {
+		--ritor_widget;
 
 		tdispatcher::tsignal<T>& signal = tdispatcher_implementation
 				::event_signal<T>(*ritor_widget->first, ritor_widget->second);
@@ -490,8 +531,7 @@ inline bool fire_event(const tevent event
 	}
 
 	/***** ***** ***** Post ***** ***** *****/
-	for(std::vector<std::pair<twidget*, tevent> >
-				::iterator itor_widget = event_chain.begin();
+	for(tevent_chain::value_type* itor_widget = event_chain.begin();
 			itor_widget != event_chain.end();
 			++itor_widget) {
 
@@ -553,8 +593,8 @@ inline bool fire_event(const tevent event
 	assert(dispatcher);
 	assert(widget);
 
-	std::vector<std::pair<twidget*, tevent> > event_chain =
-			implementation::build_event_chain<T>(event, dispatcher, widget);
+	implementation::tevent_chain event_chain;
+	implementation::build_event_chain<T>(event, dispatcher, widget, event_chain);
 
 	return implementation::fire_event<T>(event
 			, event_chain
@@ -578,7 +618,7 @@ inline bool fire_event_double_click(
 	assert(dispatcher);
 	assert(widget);
 
-	std::vector<std::pair<twidget*, tevent> > event_chain;
+	implementation::tevent_chain event_chain;
 	twidget* w = widget;
 	while(w!= dispatcher) {
 		w = w->parent();
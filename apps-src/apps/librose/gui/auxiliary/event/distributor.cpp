@@ -17,6 +17,7 @@
 
 #include "gui/auxiliary/event/distributor.hpp"
 
+#include "benchmark.hpp"
 #include "events.hpp"
 #include "gui/auxiliary/timer.hpp"
 #include "gui/widgets/settings.hpp"
@@ -571,7 +572,7 @@ template<
 		, button_double_click
 >::mouse_button_click(twidget* drag, twidget* click)
 {
-	Uint32 stamp = SDL_GetTicks();
+	Uint32 stamp = benchmark::get_ticks();
 	if (last_click_stamp_ + settings::double_click_time >= stamp && last_clicked_widget_ == click) {
 		if (click) {
 			owner_.fire(button_double_click, *click);
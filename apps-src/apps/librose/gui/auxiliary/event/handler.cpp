@@ -372,10 +372,6 @@ void thandler::handle_event(const SDL_Event& event)
 //			remove_popup();
 		break;
 
-	case TIMER_EVENT:
-		execute_timer(reinterpret_cast<long>(event.user.data1));
-		break;
-
 	case CLOSE_WINDOW_EVENT:
 		{
 			/** @todo Convert this to a proper new style event. */
@@ -421,6 +417,7 @@ void thandler::handle_event(const SDL_Event& event)
 
 		} else if (event.window.event == SDL_WINDOWEVENT_EXPOSED) {
 			// draw(true);
+			add_screen_damage_full();
 
 		} else if (event.window.event == SDL_WINDOWEVENT_RESIZED) {
 			posix_print("SDL_WINDOWEVENT_RESIZED, %ix%i\n", event.window.data1, event.window.data2);
@@ -16,31 +16,191 @@
 #include "gui/auxiliary/timer.hpp"
 
 #include "events.hpp"
+#include "benchmark.hpp"
 
 #include <SDL_timer.h>
-#include <map>
+#include <boost/unordered_map.hpp>
+#include <vector>
 
 namespace gui2 {
 
 struct ttimer
 {
 	ttimer()
-		: sdl_id(0)
+		: id(0)
 		, interval(0)
+		, expires(0)
 		, callback()
+		, slot(NULL)
+		, prev(NULL)
+		, next(NULL)
 	{
 	}
 
-	SDL_TimerID sdl_id;
+	unsigned long id;
 	Uint32 interval;
+	Uint32 expires;
 	boost::function<void(unsigned long id)> callback;
+
+	/** The wheel list this timer is linked in, NULL if none. */
+	ttimer** slot;
+	ttimer* prev;
+	ttimer* next;
+};
+
+/**
+ * Hierarchical timing wheel, one tick is one millisecond.
+ *
+ * Level 0 has a slot for every tick of the next 64 ms, level 1 a slot for
+ * every 64 ms of the next 4096 ms, etc. A timer is linked in the slot of
+ * the lowest level that can hold it and moves down a level when its higher
+ * slot is reached, so add and remove are O(1).
+ */
+class twheel
+{
+public:
+	enum {LEVEL_BITS = 6, LEVEL_SIZE = 1 << LEVEL_BITS, LEVEL_MASK = LEVEL_SIZE - 1, LEVELS = 4};
+
+	twheel()
+		: current_(0)
+		, count_(0)
+	{
+		memset(slots_, 0, sizeof(slots_));
+	}
+
+	void start(Uint32 now)
+	{
+		if (!count_) {
+			current_ = now;
+		}
+	}
+
+	void insert(ttimer& timer)
+	{
+		int delta = timer.expires - current_;
+		if (delta < 0) {
+			delta = 0;
+		}
+		int level = 0;
+		while (level < LEVELS - 1 && delta >= (1 << (LEVEL_BITS * (level + 1)))) {
+			level ++;
+		}
+		Uint32 at = timer.expires;
+		if (delta >= (1 << (LEVEL_BITS * LEVELS))) {
+			// out of range, the timer cascades again when this slot is reached.
+			at = current_ + (1 << (LEVEL_BITS * LEVELS)) - 1;
+		} else if (delta == 0) {
+			at = current_;
+		}
+		link(timer, slots_[level][(at >> (LEVEL_BITS * level)) & LEVEL_MASK]);
+	}
+
+	void remove(ttimer& timer)
+	{
+		if (!timer.slot) {
+			return;
+		}
+		if (timer.prev) {
+			timer.prev->next = timer.next;
+		} else {
+			*timer.slot = timer.next;
+		}
+		if (timer.next) {
+			timer.next->prev = timer.prev;
+		}
+		timer.slot = NULL;
+		timer.prev = timer.next = NULL;
+		count_ --;
+	}
+
+	/** Unlinks all timers expired at @now, in order of expiry. */
+	void advance(Uint32 now, std::vector<ttimer*>& expired)
+	{
+		while ((int)(now - current_) >= 0) {
+			if (!count_) {
+				current_ = now + 1;
+				break;
+			}
+			const int index = current_ & LEVEL_MASK;
+			if (!index) {
+				cascade(1);
+			}
+			while (ttimer* timer = slots_[0][index]) {
+				remove(*timer);
+				expired.push_back(timer);
+			}
+			current_ ++;
+		}
+	}
+
+	/** Milliseconds from @now to the next expiry, at most @max. */
+	int wait_ms(Uint32 now, int max) const
+	{
+		if (!count_) {
+			return max;
+		}
+		Uint32 deadline = current_ + (1 << (LEVEL_BITS * LEVELS));
+		for (int level = 0; level < LEVELS; level ++) {
+			const int shift = LEVEL_BITS * level;
+			// a slot cascades when current_ reaches its start, the first is at or after current_.
+			const Uint32 base = ((current_ + (1 << shift) - 1) >> shift) << shift;
+			for (int n = 0; n < LEVEL_SIZE; n ++) {
+				// a higher level timer cascades at the start of its slot, a good enough bound.
+				const Uint32 at = base + (n << shift);
+				if (slots_[level][(at >> shift) & LEVEL_MASK]) {
+					if ((int)(at - deadline) < 0) {
+						deadline = at;
+					}
+					break;
+				}
+			}
+		}
+		const int result = deadline - now;
+		return result < 0? 0: (result < max? result: max);
+	}
+
+private:
+	void link(ttimer& timer, ttimer*& head)
+	{
+		timer.slot = &head;
+		timer.prev = NULL;
+		timer.next = head;
+		if (head) {
+			head->prev = &timer;
+		}
+		head = &timer;
+		count_ ++;
+	}
+
+	void cascade(int level)
+	{
+		if (level >= LEVELS) {
+			return;
+		}
+		const int index = (current_ >> (LEVEL_BITS * level)) & LEVEL_MASK;
+		if (!index) {
+			cascade(level + 1);
+		}
+		while (ttimer* timer = slots_[level][index]) {
+			remove(*timer);
+			insert(*timer);
+		}
+	}
+
+private:
+	/** All ticks before current_ are processed. */
+	Uint32 current_;
+	size_t count_;
+	ttimer* slots_[LEVELS][LEVEL_SIZE];
 };
 
 	/** Ids for the timers. */
 	static unsigned long id = 0;
 
 	/** The active timers. */
-	static std::map<unsigned long, ttimer> timers;
+	static boost::unordered_map<unsigned long, ttimer> timers;
+
+	static twheel wheel;
 
 	/** The id of the event being executed, 0 if none. */
 	static unsigned long executing_id = 0;
@@ -81,62 +241,31 @@ public:
 	}
 };
 
-extern "C" {
-
-static Uint32 timer_callback(Uint32, void* id)
-{
-	std::map<unsigned long, ttimer>::iterator itor = timers.find(reinterpret_cast<unsigned long>(id));
-	if (itor == timers.end()) {
-		return 0;
-	}
-
-	SDL_Event event;
-	SDL_UserEvent data;
-
-	data.type = TIMER_EVENT;
-	data.code = 0;
-	data.data1 = id;
-	data.data2 = NULL;
-
-	event.type = TIMER_EVENT;
-	event.user = data;
-
-	SDL_PushEvent(&event);
-
-	return itor->second.interval;
-}
-
-} // extern "C"
-
 unsigned long add_timer(const Uint32 interval, const boost::function<void(unsigned long id)>& callback, const bool repeat)
 {
-	BOOST_STATIC_ASSERT(sizeof(unsigned long) == sizeof(void*));
-
 	do {
 		++ id;
 	} while(id == 0 || timers.find(id) != timers.end());
 
-	ttimer timer;
-	timer.sdl_id = SDL_AddTimer(interval, timer_callback, reinterpret_cast<void*>(id));
-	if (timer.sdl_id == 0) {
-		// Failed to create an sdl timer.
-		return INVALID_TIMER_ID;
-	}
+	const Uint32 now = benchmark::get_ticks();
+	wheel.start(now);
 
+	// unordered_map never moves its nodes, the wheel links them directly.
+	ttimer& timer = timers[id];
+	timer.id = id;
 	if (repeat) {
 		timer.interval = interval;
 	}
-
+	timer.expires = now + interval;
 	timer.callback = callback;
-
-	timers.insert(std::make_pair(id, timer));
+	wheel.insert(timer);
 
 	return id;
 }
 
 bool remove_timer(const unsigned long id)
 {
-	std::map<unsigned long, ttimer>::iterator itor = timers.find(id);
+	boost::unordered_map<unsigned long, ttimer>::iterator itor = timers.find(id);
 	if(itor == timers.end()) {
 		// Can't remove timer since it no longer exists.
 		return false;
@@ -147,40 +276,63 @@ bool remove_timer(const unsigned long id)
 		return true;
 	}
 
-	if (!SDL_RemoveTimer(itor->second.sdl_id)) {
-		/*
-		 * This can happen if the caller of the timer didn't get the event yet
-		 * but the timer has already been fired. This due to the fact that a
-		 * timer pushes an event in the queue, which allows the following
-		 * condition:
-		 * - Timer fires
-		 * - Push event in queue
-		 * - Another event is processed and tries to remove the event.
-		 */
-		// The timer is already out of the SDL timer list.
-	}
+	wheel.remove(itor->second);
 	timers.erase(itor);
 	return true;
 }
 
 bool execute_timer(const unsigned long id)
 {
-	std::map<unsigned long, ttimer>::iterator itor = timers.find(id);
+	boost::unordered_map<unsigned long, ttimer>::iterator itor = timers.find(id);
 	if (itor == timers.end()) {
 		// Can't execute timer since it no longer exists.
 		return false;
 	}
+	// the callback may add timers, a rehash invalidates itor but not timer.
+	ttimer& timer = itor->second;
+	wheel.remove(timer);
 
 	{
 		texecutor executor(id);
-		itor->second.callback(id);
+		timer.callback(id);
 	}
 
-	if(!executing_id_removed && itor->second.interval == 0) {
-		timers.erase(itor);
+	if (executing_id_removed) {
+		return true;
+	}
+	if (timer.interval == 0) {
+		timers.erase(id);
+	} else {
+		timer.expires = benchmark::get_ticks() + timer.interval;
+		wheel.insert(timer);
 	}
 	return true;
 }
 
+void expire_timers()
+{
+	if (timers.empty()) {
+		return;
+	}
+
+	std::vector<ttimer*> expired;
+	wheel.advance(benchmark::get_ticks(), expired);
+
+	std::vector<unsigned long> ids;
+	ids.reserve(expired.size());
+	for (std::vector<ttimer*>::const_iterator it = expired.begin(); it != expired.end(); ++ it) {
+		ids.push_back((*it)->id);
+	}
+	// a callback may remove later timers of this batch, so go by id.
+	for (std::vector<unsigned long>::const_iterator it = ids.begin(); it != ids.end(); ++ it) {
+		execute_timer(*it);
+	}
+}
+
+int timer_wait_ms(const int max)
+{
+	return wheel.wait_ms(benchmark::get_ticks(), max);
+}
+
 } //namespace gui2
 
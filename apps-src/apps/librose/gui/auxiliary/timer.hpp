@@ -17,15 +17,11 @@
  * @file
  * Contains the gui2 timer routines.
  *
- * This code avoids the following problems with the sdl timers:
- * - the callback must be a C function with a fixed signature.
- * - the callback needs to push an event in the event queue, between the
- *   pushing and execution of that event the timer can't be stopped. (Makes
- *   sense since the timer has expired, but not what the user wants.)
- *
- * With these functions it's possible to remove the event between pushing in
- * the queue and the actual execution. Since the callback is a boost::function
- * object it's possible to make the callback as fancy as wanted.
+ * The timers don't use sdl timers. They live in a timing wheel on the main
+ * thread and expire in events::pump(), so there is no timer thread, no
+ * TIMER_EVENT in the event queue and a timer can be removed until its
+ * callback is called. Since the callback is a boost::function object it's
+ * possible to make the callback as fancy as wanted.
  */
 
 #ifndef GUI_WIDGETS_AUXILIARY_TIMER_HPP_INCLUDED
@@ -49,7 +45,6 @@ namespace gui2 {
  *                                expires.
  *
  * @returns                       The id of the timer.
- * @retval [0]                    Failed to create a timer.
  */
 unsigned long
 add_timer(const Uint32 interval
@@ -87,6 +82,22 @@ remove_timer(const unsigned long id);
 bool
 execute_timer(const unsigned long id);
 
+/**
+ * Executes all expired timers.
+ *
+ * @note this function is only meant to be executed by events::pump().
+ */
+void
+expire_timers();
+
+/**
+ * Returns the milliseconds until the next timer expires.
+ *
+ * @param max                     Returned when there is no earlier timer.
+ */
+int
+timer_wait_ms(const int max);
+
 } //namespace gui2
 
 #endif
@@ -30,8 +30,11 @@ tbuilder_drawing::tbuilder_drawing(const config& cfg)
 	, width(cfg["width"])
 	, height(cfg["height"])
 	, draw(cfg.child("draw"))
+	, shapes()
+	, blur_depth(0)
 {
 	assert(!draw.empty());
+	tcanvas::parse_cfg(draw, shapes, &blur_depth);
 }
 
 twidget* tbuilder_drawing::build() const
@@ -50,7 +53,7 @@ twidget* tbuilder_drawing::build() const
 		widget->set_best_size(tpoint(w, h));
 	}
 
-	widget->canvas().front().set_cfg(draw);
+	widget->canvas().front().set_shapes(shapes, blur_depth);
 
 	DBG_GUI_G << "Window builder: placed drawing '"
 			<< id << "' with definition '"
@@ -18,6 +18,7 @@
 
 #include "config.hpp"
 #include "gui/auxiliary/window_builder/control.hpp"
+#include "gui/auxiliary/canvas.hpp"
 
 namespace gui2 {
 
@@ -38,6 +39,10 @@ struct tbuilder_drawing
 
 	/** Config containing what to draw on the widgets canvas. */
 	config draw;
+
+	/** draw parsed once, shared by the canvases of the built widgets. */
+	std::vector<tcanvas::tshape_ptr> shapes;
+	unsigned blur_depth;
 };
 
 } // namespace implementation
@@ -25,6 +25,7 @@
 #include "gui/widgets/image.hpp"
 #include "gui/widgets/label.hpp"
 #include "gui/widgets/scroll_label.hpp"
+#include "gui/widgets/text_box.hpp"
 #include "gui/widgets/toggle_button.hpp"
 #include "gui/widgets/toggle_panel.hpp"
 #include "gui/widgets/tree_view.hpp"
@@ -166,6 +167,9 @@ void tbook::pre_show(CVideo& /*video*/, twindow& window)
 				  , boost::ref(window))
 			, event::tdispatcher::front_pre_child);
 
+	ttext_box* search = find_widget<ttext_box>(&window, "search", false, true);
+	search->set_text_changed_callback(boost::bind(&tbook::search_changed, this, _1));
+
 	tree_->get_root_node().fold_children();
 }
 
@@ -206,6 +210,28 @@ void tbook::ref_at(twindow& window)
 	}
 }
 
+void tbook::search_changed(ttext_box* widget)
+{
+	// show the best matched topic while typing.
+	const std::vector<help::tsearch_index::thit> hits = help::book_index.search(widget->label(), 1);
+	if (hits.empty()) {
+		return;
+	}
+	const help::topic* t = hits.front().t;
+	if (t == current_topic_) {
+		return;
+	}
+	ttree_view_node* node = cookie_rfind_node(t);
+	if (node) {
+		for (ttree_view_node* parent = &node->parent_node(); !parent->is_root_node(); parent = &parent->parent_node()) {
+			parent->unfold();
+		}
+		tree_->set_select_item(node);
+		tree_->invalidate_layout(false);
+	}
+	switch_to_topic(*window_, *t);
+}
+
 void tbook::post_show(twindow& window)
 {
 }
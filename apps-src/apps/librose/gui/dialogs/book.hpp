@@ -32,6 +32,7 @@ class ttree_view_node;
 class twindow;
 class ttoggle_button;
 class ttree_view;
+class ttext_box;
 
 class tbook : public tdialog
 {
@@ -67,6 +68,7 @@ private:
 	void section_2_tv_internal(ttree_view_node& htvroot, const help::section& parent);
 
 	void ref_at(twindow& window);
+	void search_changed(ttext_box* widget);
 	ttree_view_node* cookie_rfind_node(const help::topic* t) const;
 	void switch_to_topic(twindow& window, const help::topic& t);
 
@@ -771,7 +771,7 @@ void tchat_::enter_inputing(bool enter)
 	inputing_ = enter;
 
 	input_scale_->set_best_size2(0, height);
-	window_->invalidate_layout();
+	window_->invalidate_layout(input_scale_);
 }
 
 void tchat_::signal_handler_sdl_key_down(bool& handled
@@ -1637,6 +1637,7 @@ bool tchat_::did_drag_coordinate(tcontrol* control, const tpoint& first, const t
 {
 	current_local_offset_ = last - first;
 	did_timer_vrenderer(*vrenderer_track_, vrenderer_track_->get_frame_offset(), true, true);
+	add_screen_damage(vrenderer_track_->get_rect());
 
 	return false;
 }
@@ -1972,38 +1973,23 @@ void tchat_::process_message(const std::string& chan, const std::string& from, c
 	}
 }
 
-void tchat_::process_userlist(const std::string& chan, const std::string& names)
+void tchat_::process_userlist(const std::string& chan, const std::string& /*names*/)
 {
-	std::vector<std::string> vstr = utils::split(names, ' ');
 	tlobby_channel& channel = lobby->chat->get_channel(tlobby_channel::get_cid(chan));
 
 	if (!channel.users_receiving) {
 		clear_branch(false, channel.cid);
 	}
-
-	std::vector<tcookie>& branch = channel_cookies_.find(channel.cid)->second;
-	char* nick_prefixes = lobby->chat->serv()->nick_prefixes;
-	std::string nopre_nick;
-	for (std::vector<std::string>::const_iterator it = vstr.begin(); it != vstr.end(); ++ it) {
-		const std::string& nick = *it;
-		nopre_nick = *it;
-		// Ignore prefixes so '!' won't cause issues
-		if (strchr(nick_prefixes, nopre_nick[0])) {
-			nopre_nick = nopre_nick.substr(1);
-		}
-
-		int uid = tlobby_user::get_uid(nopre_nick);
-		const tlobby_user& user = channel.get_user(uid);
-		insert_user(false, branch, user);
-	}
+	// a large channel sends thousands of chunks, the channel node is
+	// updated once at ENDOFNAMES.
 }
 
 void tchat_::process_userlist_end(const std::string& chan)
 {
 	tlobby_channel& channel = lobby->chat->get_channel(tlobby_channel::get_cid(chan));
 
-	// std::vector<tcookie>& branch = channel_cookies_.find(channel.cid)->second;
-	// branch.front().node->fold();
+	std::vector<tcookie>& branch = channel_cookies_.find(channel.cid)->second;
+	update_node_internal(branch, branch.front());
 
 	if (current_ft_ == ft_channel && current_session_->receiver->id == channel.cid) {
 		refresh_toolbar(current_ft_, current_session_->receiver->id);
@@ -2163,6 +2149,17 @@ void tchat_::process_quit(const std::string& nick)
 	}
 }
 
+void tchat_::process_nick(const std::string& nick, const std::string& newnick)
+{
+	const int uid = tlobby_user::get_uid(newnick);
+
+	std::pair<std::vector<tchat_::tcookie>*, tchat_::tcookie* > ret = tchat_::contact_find(true, tlobby_channel::t_friend, uid, false);
+	if (ret.first) {
+		ret.second->nick = newnick;
+		update_node_internal(*ret.first, *ret.second);
+	}
+}
+
 void tchat_::notify_toggled(twindow& window, tlistbox& list, const int type)
 {
 	bool active = !!notify_list_->get_item_count();
@@ -2432,6 +2429,9 @@ bool tchat_::handle_raw(int at, tsock::ttype type, const char* param[])
 	} else if (!strcasecmp(param[0], "QUIT")) {
 		process_quit(param[1]);
 
+	} else if (!strcasecmp(param[0], "NICK")) {
+		process_nick(param[1], param[2]);
+
 	} else if (!strcasecmp(param[0], "PRIVMSG")) {
 		process_message(param[1], param[2], param[3]);
 
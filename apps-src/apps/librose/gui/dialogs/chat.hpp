@@ -142,6 +142,7 @@ protected:
 	void process_join(const std::string& chan, const std::string& nick);
 	void process_whois(const std::string& chan, const std::string& nick, bool online, bool away);
 	void process_quit(const std::string& nick);
+	void process_nick(const std::string& nick, const std::string& newnick);
 	void process_chanlist_start();
 	void process_chanlist(const std::string& chan, int users, const std::string& topic);
 	void process_chanlist_end();
@@ -17,6 +17,7 @@
 
 #include "gui/dialogs/dialog.hpp"
 
+#include "gui/auxiliary/log.hpp"
 #include "gui/widgets/integer_selector.hpp"
 #include "gui/widgets/report.hpp"
 #include "gui/widgets/toggle_button.hpp"
@@ -47,6 +48,7 @@ bool tdialog::show(CVideo& video, const unsigned auto_close_time, const unsigned
 	}
 
 	{
+		const Uint32 start = SDL_GetTicks();
 		std::auto_ptr<twindow> window(build_window(video, explicit_x, explicit_y));
 		VALIDATE(window.get(), null_str);
 
@@ -59,6 +61,14 @@ bool tdialog::show(CVideo& video, const unsigned auto_close_time, const unsigned
 
 			pre_show(video, *window);
 
+			// first window after language changed translates most of its strings,
+			// unless background translating has finished. time it, it is what user waits for.
+			static unsigned timed_timestamp = 0;
+			if (timed_timestamp != t_string::translation_timestamp()) {
+				timed_timestamp = t_string::translation_timestamp();
+				LOG_GUI_G << "first window '" << window_id() << "' after language changed: " << (SDL_GetTicks() - start) << " ms\n";
+			}
+
 			// window->set_transition(video.getTexture(), SDL_GetTicks());
 
 			retval_ = window->show(restore_, auto_close_time);
@@ -189,6 +189,7 @@ bool tguide_::callback_set_drag_coordinate(tcontrol* control, const tpoint& firs
 	int drag_offset_x = last.x - first.x;
 	ttrack& widget = find_widget<ttrack>(control->get_window(), "image", false);
 	callback_timer(widget, widget.get_frame_offset(), true, drag_offset_x);
+	add_screen_damage(widget.get_rect());
 
 	return false;
 }
@@ -102,9 +102,9 @@ bool ttransfer::handle_raw2(int at, tsock::ttype type, const char* data, int len
 			   << "/"
 			   << utils::si_string(total, true, _("unit_byte^B"));
 
-			find_widget<tlabel>(&(window_.get()), "_numeric_progress", false)
-					.set_label(ss.str());
-			window_.get().invalidate_layout();
+			tlabel& numeric_progress = find_widget<tlabel>(&(window_.get()), "_numeric_progress", false);
+			numeric_progress.set_label(ss.str());
+			window_.get().invalidate_layout(&numeric_progress);
 
 		}
 	}
@@ -250,17 +250,21 @@ void tcontrol::calculate_integrate()
 	if (!text_editable_) {
 		return;
 	}
-	if (integrate_) {
-		delete integrate_;
-	}
+	// previous layout hands its rows and rendered lines to the new one. When typing, only the edited rows are wrapped and rendered again.
+	tintegrate* previous = integrate_;
+	integrate_ = NULL;
+
 	int max = get_text_maximum_width();
 	if (max > 0) {
 		// before place, w_ = 0. it indicate not ready.
-		integrate_ = new tintegrate(label_, get_text_maximum_width(), -1, config()->text_font_size, integrate_default_color_, text_editable_);
+		integrate_ = new tintegrate(label_, get_text_maximum_width(), -1, config()->text_font_size, integrate_default_color_, text_editable_, previous);
 		if (!locator_.empty()) {
 			integrate_->fill_locator_rect(locator_, true);
 		}
 	}
+	if (previous) {
+		delete previous;
+	}
 }
 
 void tcontrol::set_integrate_default_color(const SDL_Color& color)
@@ -338,6 +342,7 @@ void tcontrol::set_definition(const std::string& definition)
 void tcontrol::clear_label_size_cache()
 {
 	label_size_.second.x = 0;
+	invalidate_best_size();
 }
 
 void tcontrol::set_best_size(const std::string& width, const std::string& height, const std::string& hdpi_off)
@@ -353,6 +358,7 @@ void tcontrol::set_best_size(const std::string& width, const std::string& height
 			hdpi_off_height_ = utils::to_bool(fields[1]);
 		}
 	}
+	invalidate_best_size();
 }
 
 void tcontrol::set_label(const std::string& label)
@@ -363,6 +369,7 @@ void tcontrol::set_label(const std::string& label)
 
 	label_ = label;
 	label_size_.second.x = 0;
+	invalidate_best_size();
 	update_canvas();
 	set_dirty();
 
@@ -376,6 +383,8 @@ void tcontrol::set_text_editable(bool editable)
 	}
 
 	text_editable_ = editable;
+	label_size_.second.x = 0;
+	invalidate_best_size();
 	update_canvas();
 	set_dirty();
 }
@@ -421,6 +430,7 @@ int tcontrol::get_text_maximum_height() const
 void tcontrol::set_text_maximum_width(int maximum)
 {
 	text_maximum_width_ = maximum - config_->text_extra_width;
+	invalidate_best_size();
 }
 
 void tcontrol::clear_texture()
@@ -41,10 +41,13 @@ public:
 			, original_(widget.text_maximum_width_)
 		{
 			widget_.text_maximum_width_ = text_maximum_width2 - widget.config_->text_extra_width;
+			// best size cached for the other width is wrong now.
+			widget_.invalidate_best_size();
 		}
 		~ttext_maximum_width_lock()
 		{
 			widget_.text_maximum_width_ = original_;
+			widget_.invalidate_best_size();
 		}
 
 	private:
@@ -18,6 +18,7 @@
 #include "gui/widgets/effect.hpp"
 #include "gui/widgets/track.hpp"
 
+#include "benchmark.hpp"
 #include "display.hpp"
 #include "font.hpp"
 #include "gettext.hpp"
@@ -104,7 +105,7 @@ int trefresh::draw(const int _set_yoffset)
 			} else {
 				if (refresh_ == refreshed) {
 					// linger some time if refreshed.
-					uint32_t now = SDL_GetTicks();
+					uint32_t now = benchmark::get_ticks();
 					if (refreshed_linger_ticks_ == 0 && springback_yoffset_ <= max_egg_diameter_ + egg_gap_) {
 						refreshed_linger_ticks_ = now + 500; // 500 msecond
 						springback_granularity_ = max_egg_diameter_ / 4;
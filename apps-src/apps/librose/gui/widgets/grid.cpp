@@ -42,6 +42,8 @@ tgrid::tgrid(const unsigned rows, const unsigned cols)
 	, cols_(cols)
 	, row_height_()
 	, col_width_()
+	, cell_xs_()
+	, cell_ys_()
 	, row_grow_factor_(rows)
 	, col_grow_factor_(cols)
 	, children_(NULL)
@@ -85,6 +87,7 @@ unsigned tgrid::add_row(const unsigned count)
 void tgrid::set_child(twidget* widget, const unsigned row,
 		const unsigned col, const unsigned flags, const unsigned border_size)
 {
+	children_changed();
 	assert(row < rows_ && col < cols_);
 	assert(flags & VERTICAL_MASK);
 	assert(flags & HORIZONTAL_MASK);
@@ -115,6 +118,7 @@ twidget* tgrid::swap_child(
 		const std::string& id, twidget* widget, const bool recurse,
 		twidget* new_parent)
 {
+	children_changed();
 	assert(widget);
 
 	for (int n = 0; n < children_vsize_; n ++) {
@@ -151,6 +155,7 @@ twidget* tgrid::swap_child(
 
 void tgrid::remove_child(const unsigned row, const unsigned col)
 {
+	children_changed();
 	assert(row < rows_ && col < cols_);
 
 	tchild& cell = child(row, col);
@@ -163,6 +168,7 @@ void tgrid::remove_child(const unsigned row, const unsigned col)
 
 void tgrid::remove_child(const std::string& id, const bool find_all)
 {
+	children_changed();
 	for (int n = 0; n < children_vsize_; n ++) {
 		tchild& child = children_[n];
 
@@ -296,6 +302,7 @@ void tgrid::calculate_grid_params(int unit_w, int unit_h, int gap, bool extendab
 
 void tgrid::insert_child(int unit_w, int unit_h, twidget& widget, int at)
 {
+	children_changed();
 	// make sure the new child is valid before deferring
 	widget.set_parent(this);
 	if (at == npos || at > children_vsize_ - stuff_size_) {
@@ -315,6 +322,7 @@ void tgrid::insert_child(int unit_w, int unit_h, twidget& widget, int at)
 
 void tgrid::erase_child(int at)
 {
+	children_changed();
 	if (stuff_widget_.empty()) {
 		return;
 	}
@@ -333,6 +341,7 @@ void tgrid::erase_child(int at)
 
 void tgrid::replacement_children(int unit_w, int unit_h, int gap, bool extendable, int fixed_cols, const tspacer& content)
 {
+	children_changed();
 	calculate_grid_params(unit_w, unit_h, gap, extendable, fixed_cols);
 	
 	tpoint origin(x_, y_);
@@ -520,6 +529,7 @@ void tgrid::listbox_init()
 
 int tgrid::listbox_insert_child(twidget& widget, int at)
 {
+	children_changed();
 	// make sure the new child is valid before deferring
 	widget.set_parent(this);
 	if (at == npos || at > children_vsize_ - stuff_size_) {
@@ -550,6 +560,7 @@ int tgrid::listbox_insert_child(twidget& widget, int at)
 
 void tgrid::listbox_erase_child(int at)
 {
+	children_changed();
 	if (at == npos || at >= children_vsize_ - stuff_size_) {
 		return;
 	}
@@ -579,6 +590,7 @@ void tgrid::stacked_init()
 
 void tgrid::stacked_insert_child(twidget& widget, int at)
 {
+	children_changed();
 	// make sure the new child is valid before deferring
 	widget.set_parent(this);
 	if (at == npos || at > children_vsize_ - stuff_size_) {
@@ -943,6 +955,7 @@ void tgrid::place(const tpoint& origin, const tpoint& size)
 
 void tgrid::place_fix(const tpoint& origin, const tpoint& size)
 {
+	children_changed();
 	/***** INIT *****/
 	twidget::place(origin, size);
 
@@ -1100,6 +1113,7 @@ void tgrid::set_cols(const unsigned cols)
 
 void tgrid::set_rows_cols(const unsigned rows, const unsigned cols)
 {
+	children_changed();
 	if (rows == rows_ && cols == cols_) {
 		return;
 	}
@@ -1284,6 +1298,60 @@ void tgrid::layout(const tpoint& origin)
 		orig.y += row_height_[row];
 		orig.x = origin.x;
 	}
+
+	build_cell_index(origin);
+}
+
+void tgrid::build_cell_index(const tpoint& origin)
+{
+	clear_cell_index();
+	if (!rows_ || !cols_ || stuff_size_ || children_vsize_ != (int)(rows_ * cols_)) {
+		return;
+	}
+
+	cell_xs_.resize(cols_ + 1);
+	cell_ys_.resize(rows_ + 1);
+	cell_xs_[0] = origin.x - get_x();
+	cell_ys_[0] = origin.y - get_y();
+	for (unsigned col = 0; col < cols_; ++col) {
+		cell_xs_[col + 1] = cell_xs_[col] + col_width_[col];
+	}
+	for (unsigned row = 0; row < rows_; ++row) {
+		cell_ys_[row + 1] = cell_ys_[row] + row_height_[row];
+	}
+
+	// every child must be inside its cell, else a lookup could miss an
+	// overlapping earlier child.
+	for (unsigned row = 0; row < rows_; ++row) {
+		for (unsigned col = 0; col < cols_; ++col) {
+			const twidget* widget = child(row, col).widget_;
+			if (!widget) {
+				continue;
+			}
+			const int x = widget->get_x() - get_x();
+			const int y = widget->get_y() - get_y();
+			if (x < cell_xs_[col] || x + (int)widget->get_width() > cell_xs_[col + 1]
+				|| y < cell_ys_[row] || y + (int)widget->get_height() > cell_ys_[row + 1]) {
+				clear_cell_index();
+				return;
+			}
+		}
+	}
+}
+
+int tgrid::cell_at(const tpoint& coordinate) const
+{
+	if (cell_xs_.size() != cols_ + 1 || cell_ys_.size() != rows_ + 1 || children_vsize_ != (int)(rows_ * cols_)) {
+		return npos;
+	}
+	const int x = coordinate.x - get_x();
+	const int y = coordinate.y - get_y();
+	if (x < cell_xs_.front() || x >= cell_xs_.back() || y < cell_ys_.front() || y >= cell_ys_.back()) {
+		return npos;
+	}
+	const int col = std::upper_bound(cell_xs_.begin(), cell_xs_.end(), x) - cell_xs_.begin() - 1;
+	const int row = std::upper_bound(cell_ys_.begin(), cell_ys_.end(), y) - cell_ys_.begin() - 1;
+	return row * cols_ + col;
 }
 
 void tgrid::impl_draw_children(
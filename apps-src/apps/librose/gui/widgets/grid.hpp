@@ -358,6 +358,19 @@ private:
 	/** Layouts the children in the grid. */
 	void layout(const tpoint& origin);
 
+	void build_cell_index(const tpoint& origin);
+	void clear_cell_index() { cell_xs_.clear(); cell_ys_.clear(); }
+
+	/** Called when children are set, removed or moved in the grid. */
+	void children_changed()
+	{
+		clear_cell_index();
+		invalidate_best_size();
+	}
+
+	/** The index of the cell at coordinate by the cell index, npos if unknown. */
+	int cell_at(const tpoint& coordinate) const;
+
 protected:
 	/** The number of grid rows. */
 	unsigned rows_;
@@ -373,6 +386,15 @@ protected:
 	/** The column widths in the grid. */
 	mutable std::vector<unsigned> col_width_;
 
+	/**
+	 * The cell bounds of the last layout, relative to the grid origin, so
+	 * set_origin doesn't invalidate them. find_at uses them to only test
+	 * the cell under the coordinate. Empty when the children don't stay
+	 * inside their cells or changed since the layout.
+	 */
+	std::vector<int> cell_xs_;
+	std::vector<int> cell_ys_;
+
 	/** The grow factor for all rows. */
 	std::vector<unsigned> row_grow_factor_;
 
@@ -34,6 +34,7 @@
 #include "gui/widgets/grid.hpp"
 
 #include "utils/const_clone.tpp"
+#include "sdl_utils.hpp"
 
 #include <boost/foreach.hpp>
 
@@ -58,7 +59,18 @@ struct tgrid_implementation
 			const tpoint& coordinate, const bool must_be_active)
 	{
 		typedef typename utils::tconst_clone<tgrid::tchild, W>::type hack;
-		
+
+		// children don't overlap, only the cell under the coordinate can
+		// have it. Scan all when its widget doesn't contain the coordinate.
+		const int at = grid.cell_at(coordinate);
+		if (at != twidget::npos) {
+			W* widget = grid.children_[at].widget_;
+			if (widget && widget->get_visible() != twidget::INVISIBLE
+				&& point_in_rect(coordinate.x, coordinate.y, widget->get_rect())) {
+				return widget->find_at(coordinate, must_be_active);
+			}
+		}
+
 		// BOOST_FOREACH(hack& child, grid.children_) {
 		for (int n = 0; n < grid.children_vsize_; n ++) {
 			hack& child = grid.children_[n];
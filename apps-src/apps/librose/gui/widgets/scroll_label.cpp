@@ -25,6 +25,7 @@
 #include "gui/widgets/scrollbar.hpp"
 #include "gui/widgets/spacer.hpp"
 #include "gui/widgets/window.hpp"
+#include "benchmark.hpp"
 
 #include <boost/bind.hpp>
 
@@ -153,7 +154,7 @@ void tscroll_label::set_text_editable(bool editable)
 bool tscroll_label::exist_anim()
 {
 	bool dirty = false;
-	Uint32 now = SDL_GetTicks();
+	Uint32 now = benchmark::get_ticks();
 
 	if (auto_scroll_ && vertical_scrollbar_->get_visible() == twidget::VISIBLE) {
 		const Uint32 interval = 50;
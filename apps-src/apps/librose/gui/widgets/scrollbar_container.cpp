@@ -468,6 +468,7 @@ void tscrollbar_container::
 {
 	if(vertical_scrollbar_mode_ != scrollbar_mode) {
 		vertical_scrollbar_mode_ = scrollbar_mode;
+		invalidate_best_size();
 	}
 }
 
@@ -476,6 +477,7 @@ void tscrollbar_container::
 {
 	if(horizontal_scrollbar_mode_ != scrollbar_mode) {
 		horizontal_scrollbar_mode_ = scrollbar_mode;
+		invalidate_best_size();
 	}
 }
 
@@ -32,6 +32,7 @@
 #include "rose_config.hpp"
 #include "loadscreen.hpp"
 #include "font.hpp"
+#include "sound.hpp"
 
 #include <boost/foreach.hpp>
 
@@ -45,6 +46,7 @@ void ttip_definition::read(const config& _cfg)
 	text_extra_height = _cfg["text_extra_height"].to_int();
 	text_font_size = _cfg["text_font_size"].to_int(font::SIZE_NORMAL);
 	vertical_gap = _cfg["vertical_gap"].to_int();
+	tcanvas::parse_cfg(_cfg, shapes);
 
 	if (twidget::hdpi) {
 		text_extra_width *= twidget::hdpi_scale;
@@ -369,6 +371,10 @@ void tgui_definition::activate() const
 	settings::sound_toggle_button_click = sound_toggle_button_click_;
 	settings::sound_toggle_panel_click = sound_toggle_panel_click_;
 	settings::sound_slider_adjust = sound_slider_adjust_;
+	sound::preload(sound_button_click_);
+	sound::preload(sound_toggle_button_click_);
+	sound::preload(sound_toggle_panel_click_);
+	sound::preload(sound_slider_adjust_);
 	settings::has_helptip_message = has_helptip_message_;
 	settings::portraits = portraits_;
 	settings::tip_cfgs = tip_cfgs_;
@@ -411,6 +417,15 @@ std::map<std::string, tgui_definition> guis;
 /** Points to the current gui. */
 std::map<std::string, tgui_definition>::const_iterator current_gui = guis.end();
 
+/**
+ * The resolutions get_control() returned, by control type and definition.
+ *
+ * Every control of every window asks for its resolution, the choice only
+ * changes with the gui or the screen size.
+ */
+static std::map<std::pair<std::string, std::string>, tresolution_definition_ptr> resolved_controls;
+static tpoint resolved_landscape_size(0, 0);
+
 void register_window(const std::string& app, const std::string& id)
 {
 	std::string id2 = utils::generate_app_prefix_id(app, id);
@@ -461,6 +476,7 @@ void load_settings()
 
 	current_gui = guis.find("default");
 	current_gui->second.activate();
+	resolved_controls.clear();
 }
 
 tstate_definition::tstate_definition(const config &cfg) :
@@ -514,6 +530,18 @@ void load_widget_definitions(
 tresolution_definition_ptr get_control(
 		const std::string& control_type, const std::string& definition)
 {
+	const tpoint landscape_size = twidget::orientation_swap_size(settings::screen_width, settings::screen_height);
+	if (landscape_size != resolved_landscape_size) {
+		resolved_controls.clear();
+		resolved_landscape_size = landscape_size;
+	}
+
+	const std::pair<std::string, std::string> key(control_type, definition);
+	std::map<std::pair<std::string, std::string>, tresolution_definition_ptr>::const_iterator resolved = resolved_controls.find(key);
+	if (resolved != resolved_controls.end()) {
+		return resolved->second;
+	}
+
 	const tgui_definition::tcontrol_definition_map::const_iterator
 	control_definition = current_gui->second.control_definition.find(control_type);
 
@@ -527,18 +555,15 @@ tresolution_definition_ptr get_control(
 		VALIDATE(control != control_definition->second.end(), "Cannot find defnition, failling back to default!");
 	}
 
-	tpoint landscape_size = twidget::orientation_swap_size(settings::screen_width, settings::screen_height);
-
 	for (std::vector<tresolution_definition_ptr>::const_iterator
 			itor = (*control->second).resolutions.begin(),
 			end = (*control->second).resolutions.end();
 			itor != end;
 			++itor) {
 
-		if (landscape_size.x <= (int)(**itor).window_width || landscape_size.y <= (int)(**itor).window_height) {
-			return *itor;
-
-		} else if (itor == end - 1) {
+		if (landscape_size.x <= (int)(**itor).window_width || landscape_size.y <= (int)(**itor).window_height
+			|| itor == end - 1) {
+			resolved_controls.insert(std::make_pair(key, *itor));
 			return *itor;
 		}
 	}
@@ -186,6 +186,9 @@ struct ttip_definition
 	int vertical_gap;
 
 	config cfg;
+
+	/** The shapes of cfg, parsed once when the definition is read. */
+	std::vector<tcanvas::tshape_ptr> shapes;
 };
 
 /** This namespace contains the 'global' settings. */
@@ -61,7 +61,7 @@ public:
 	/***** ***** ***** setters / getters for members ***** ****** *****/
 
 	void set_best_slider_length(const unsigned length)
-		{ best_slider_length_ = length; set_dirty(); }
+		{ best_slider_length_ = length; invalidate_best_size(); set_dirty(); }
 
 	void set_minimum_value_label(const t_string& minimum_value_label)
 		{ minimum_value_label_ = minimum_value_label; }
@@ -354,7 +354,10 @@ void tstacked_widget::set_float(bool val)
 
 void tstacked_widget::set_flat(bool val)
 {
-	flat_ = val;
+	if (flat_ != val) {
+		flat_ = val;
+		invalidate_best_size();
+	}
 }
 
 void tstacked_widget::set_radio_layer(int layer)
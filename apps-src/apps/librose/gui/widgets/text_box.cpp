@@ -17,6 +17,7 @@
 
 #include "gui/widgets/text_box.hpp"
 
+#include "benchmark.hpp"
 #include "font.hpp"
 #include "gui/auxiliary/log.hpp"
 #include "gui/auxiliary/widget_definition/text_box.hpp"
@@ -222,14 +223,12 @@ void ttext_box::insert_str(const std::string& str)
 		integrate_->clear();
 	}
 
-	SDL_Rect new_start;
-	const std::string& text = integrate_->insert_str(true, selection_start_.x, selection_start_.y, str2, new_start);
-	// after delete, start maybe in end outer.
-	selection_start_ = new_start;
-
+	int new_src_pos;
+	const std::string& text = integrate_->insert_str(true, selection_start_.x, selection_start_.y, str2, new_src_pos);
 	set_label(text);
 
-	set_cursor(selection_start_, false);
+	// place cursor on the layout of new text, don't lay out it twice.
+	set_src_pos(new_src_pos);
 }
 
 void ttext_box::insert_img(const std::string& str)
@@ -248,14 +247,11 @@ void ttext_box::insert_img(const std::string& str)
 	}
 	
 	std::string str2 = tintegrate::generate_img(str);
-	SDL_Rect new_start;
-	const std::string& text = integrate_->insert_str(false, selection_start_.x, selection_start_.y, str2, new_start);
-	// after delete, start maybe in end outer.
-	selection_start_ = new_start;
-
+	int new_src_pos;
+	const std::string& text = integrate_->insert_str(false, selection_start_.x, selection_start_.y, str2, new_src_pos);
 	set_label(text);
 
-	set_cursor(selection_start_, false);
+	set_src_pos(new_src_pos);
 }
 
 int ttext_box::get_src_pos() const
@@ -697,7 +693,7 @@ void ttext_box::signal_handler_sdl_key_down(const event::tevent event
 	}
 
 	hide_cursor_ = false;
-	forbid_hide_ticks_ = SDL_GetTicks() + 200;
+	forbid_hide_ticks_ = benchmark::get_ticks() + 200;
 	cursor_timer_handler();
 }
 
@@ -770,7 +766,7 @@ void ttext_box::set_visible_area(const SDL_Rect& area)
 
 void ttext_box::cursor_timer_handler()
 {
-	if (SDL_GetTicks() > forbid_hide_ticks_) {
+	if (benchmark::get_ticks() > forbid_hide_ticks_) {
 		hide_cursor_ = !hide_cursor_;
 	}
 	BOOST_FOREACH(tcanvas& tmp, canvas()) {
@@ -877,12 +873,17 @@ void ttext_box::delete_char(const bool backspace)
 	normalize_start_end(start, end);
 
 	SDL_Rect new_start;
-	const std::string& text = integrate_->handle_char(true, start.x, start.y, backspace, new_start);
+	int new_src_pos;
+	const std::string& text = integrate_->handle_char(true, start.x, start.y, backspace, new_start, &new_src_pos);
 	if (text != label()) {
 		selection_start_ = new_start;
 		set_label(text);
 		// repoint
-		set_cursor(selection_start_, false);
+		if (new_src_pos != -1) {
+			set_src_pos(new_src_pos);
+		} else {
+			set_cursor(selection_start_, false);
+		}
 	}
 }
 
@@ -895,13 +896,16 @@ void ttext_box::delete_selection()
 	SDL_Rect start, end;
 	normalize_start_end(start, end);
 
-	SDL_Rect new_start;
-	const std::string& text = integrate_->handle_selection(start.x, start.y, end.x, end.y, &new_start);
-	// after delete, start maybe in end outer.
-	selection_start_ = new_start;
+	int new_src_pos;
+	const std::string& text = integrate_->handle_selection(start.x, start.y, end.x, end.y, &new_src_pos);
 	set_label(text);
 
-	set_cursor(selection_start_, false);
+	// after delete, start maybe in end outer.
+	if (new_src_pos != -1) {
+		set_src_pos(new_src_pos);
+	} else {
+		set_cursor(end, false);
+	}
 }
 
 void ttext_box::handle_mouse_selection(tpoint mouse, const bool start_selection)
@@ -911,7 +915,7 @@ void ttext_box::handle_mouse_selection(tpoint mouse, const bool start_selection)
     }
 
 	hide_cursor_ = false;
-	forbid_hide_ticks_ = SDL_GetTicks() + 200;
+	forbid_hide_ticks_ = benchmark::get_ticks() + 200;
 	cursor_timer_handler();
 
 	mouse.x -= get_x();
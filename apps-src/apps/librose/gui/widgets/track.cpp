@@ -22,6 +22,7 @@
 #include "gui/widgets/settings.hpp"
 #include "gui/widgets/window.hpp"
 #include "gui/auxiliary/timer.hpp"
+#include "video.hpp"
 
 #include <boost/bind.hpp>
 
@@ -110,6 +111,8 @@ void ttrack::timer_handler()
 		const SDL_Rect rect = get_rect();
 		texture_clip_rect_setter clip(&rect);
 		did_timer_(*this, get_frame_offset(), true);
+		// drawn out of twindow::draw, flip presents it only when it is damage.
+		add_screen_damage(rect);
 	}	
 }
 
@@ -78,6 +78,7 @@ void ttree_view::remove_node(ttree_view_node* node)
 
 	delete(*it);
 	node->parent_node_->children_.erase(it);
+	invalidate_content_size();
 
 	if (get_size() == tpoint(0, 0)) {
 		return;
@@ -87,6 +88,16 @@ void ttree_view::remove_node(ttree_view_node* node)
 	invalidate_layout(false);
 }
 
+void ttree_view::invalidate_content_size()
+{
+	if (root_node_) {
+		root_node_->invalidate_best_size();
+	}
+	if (content_grid_) {
+		content_grid_->invalidate_best_size();
+	}
+}
+
 void ttree_view::child_populate_dirty_list(twindow& caller
 		, const std::vector<twidget*>& call_stack)
 {
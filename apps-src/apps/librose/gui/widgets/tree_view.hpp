@@ -129,6 +129,15 @@ private:
 	bool left_align_;
 	bool no_indentation_;
 
+	/**
+	 * Drops the cached best size of root_node_ and content_grid_.
+	 *
+	 * Nodes are parented to the tree view, so invalidate_best_size() of a
+	 * node never reaches them. Called whenever nodes are added, removed,
+	 * folded or unfolded.
+	 */
+	void invalidate_content_size();
+
 	/** Inherited from tcontainer_. */
 	virtual void finalize_setup();
 
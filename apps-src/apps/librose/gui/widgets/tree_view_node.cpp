@@ -167,6 +167,7 @@ ttree_view_node& ttree_view_node::add_child(
 			, tree_view()
 			, data
 			, branch));
+	tree_view().invalidate_content_size();
 
 	if (is_folded() || is_root_node()) {
 		return **itor;
@@ -225,6 +226,7 @@ void ttree_view_node::fold()
 {
 	if (!empty() && icon_ && !icon_->get_value()) {
 		icon_->set_value(true);
+		tree_view().invalidate_content_size();
 		if (is_child2(*tree_view().selected_item_)) {
 			tree_view().set_select_item(this);
 		}
@@ -235,6 +237,7 @@ void ttree_view_node::unfold()
 {
 	if (!empty() && icon_ && icon_->get_value()) {
 		icon_->set_value(false);
+		tree_view().invalidate_content_size();
 	}
 }
 
@@ -292,6 +295,7 @@ void ttree_view_node::clear()
 		delete *it;
 	}
 	children_.clear();
+	tree_view().invalidate_content_size();
 
 	if (height_reduction == 0) {
 		return;
@@ -698,6 +702,7 @@ void ttree_view_node::signal_handler_left_button_click(
 		// From folded to unfolded.
 	}
 
+	tree_view().invalidate_content_size();
 	tree_view().invalidate_layout(false);
 }
 
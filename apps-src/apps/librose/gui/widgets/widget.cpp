@@ -105,6 +105,8 @@ twidget::twidget()
 	, fix_rect_(null_rect)
 	, cookie_(NULL)
 	, layout_size_(tpoint(0,0))
+	, best_size_(tpoint(npos, npos))
+	, best_size_valid_(false)
 	, linked_group_()
 	, drag_(drag_none)
 {
@@ -126,6 +128,8 @@ twidget::twidget(const tbuilder_widget& builder)
 	, fix_rect_(null_rect)
 	, cookie_(NULL)
 	, layout_size_(tpoint(0,0))
+	, best_size_(tpoint(npos, npos))
+	, best_size_valid_(false)
 	, linked_group_(builder.linked_group)
 	, drag_(drag_none)
 {
@@ -146,6 +150,7 @@ twidget::~twidget()
 		if (!linked_group_.empty()) {
 			window->remove_linked_widget(linked_group_, this);
 		}
+		window->remove_relayout_widget(this);
 		tdialog* dialog = window->dialog();
 		if (dialog) {
 			dialog->destruct_widget(this);
@@ -164,6 +169,7 @@ void twidget::layout_init(const bool /*full_initialization*/)
 	assert(get_window());
 
 	layout_size_ = tpoint(0,0);
+	best_size_valid_ = false;
 	if (!linked_group_.empty()) {
 		get_window()->add_linked_widget(linked_group_, this);
 	}
@@ -172,12 +178,14 @@ void twidget::layout_init(const bool /*full_initialization*/)
 tpoint twidget::get_best_size() const
 {
 	if (is_null_rect(fix_rect_)) {
-		tpoint result = layout_size_;
-		if (result == tpoint(0, 0)) {
-			result = calculate_best_size();
+		if (layout_size_ != tpoint(0, 0)) {
+			return layout_size_;
 		}
-
-		return result;
+		if (!best_size_valid_) {
+			best_size_ = calculate_best_size();
+			best_size_valid_ = true;
+		}
+		return best_size_;
 
 	} else {
 		return tpoint(fix_rect_.w, fix_rect_.h);
@@ -299,6 +307,18 @@ void twidget::populate_dirty_list(twindow& caller, std::vector<twidget*>& call_s
 void twidget::set_layout_size(const tpoint& size) 
 {
 	layout_size_ = size; 
+	if (parent_) {
+		parent_->invalidate_best_size();
+	}
+}
+
+void twidget::invalidate_best_size()
+{
+	// a parent can have cached its size while this one's layout_size_ was
+	// set, so don't stop at the first invalid one.
+	for (twidget* widget = this; widget; widget = widget->parent_) {
+		widget->best_size_valid_ = false;
+	}
 }
 
 std::string twidget::generate_layout_str(const int level) const
@@ -317,9 +337,12 @@ void twidget::set_visible(const tvisible visible)
 	visible_ = visible;
 
 	if (need_resize) {
+		if (parent_) {
+			parent_->invalidate_best_size();
+		}
 		twindow *window = get_window();
 		if(window) {
-			window->invalidate_layout();
+			window->invalidate_layout(this);
 		}
 	}
 	set_dirty();
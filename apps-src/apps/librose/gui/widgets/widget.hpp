@@ -199,6 +199,11 @@ public:
 	 * During the layout phase some functions can modify layout_size_ so the
 	 * next call to get_best_size() returns the currently best size. This means
 	 * that after the layout phase get_best_size() still returns this value.
+	 *
+	 * When layout_size_ isn't set, the result of calculate_best_size() is
+	 * cached in best_size_ until something changes the size of the widget.
+	 * That change must call invalidate_best_size(), which also drops the
+	 * cache of all parents.
 	 */
 
 	/**
@@ -570,6 +575,9 @@ public:
 	void set_layout_size(const tpoint& size);
 	const tpoint& layout_size() const { return layout_size_; }
 
+	/** Drops the cached best size of this widget and its parents. */
+	void invalidate_best_size();
+
 	virtual std::string generate_layout_str(const int level) const;
 
 	virtual tpoint request_reduce_width(const unsigned maximum_width) { return tpoint(0, 0); }
@@ -683,6 +691,15 @@ private:
 	 */
 	tpoint layout_size_;
 
+	/**
+	 * The cached result of calculate_best_size().
+	 *
+	 * Keeps the last value when invalidated, so twindow can see whether a
+	 * change altered the size.
+	 */
+	mutable tpoint best_size_;
+	mutable bool best_size_valid_;
+
 	/**
 	 * The linked group the widget belongs to.
 	 *
@@ -37,6 +37,7 @@
 #include "video.hpp"
 #include "formula_string_utils.hpp"
 #include "hotkeys.hpp"
+#include "benchmark.hpp"
 
 #include <boost/bind.hpp>
 #include <boost/foreach.hpp>
@@ -262,6 +263,7 @@ twindow::twindow(CVideo& video,
 	, retval_(NONE)
 	, owner_(0)
 	, need_layout_(true)
+	, relayout_widgets_()
 	, variables_()
 	, invalidate_layout_blocked_(false)
 	, suspend_drawing_(true)
@@ -510,7 +512,7 @@ int twindow::show(const bool restore, const unsigned auto_close_timeout)
 			events::pump();
 			absolute_draw();
 			// Add a delay so we don't keep spinning if there's no event.
-			SDL_Delay(10);
+			events::wait_frame();
 		}
 	} catch(...) {
 		/**
@@ -525,6 +527,7 @@ int twindow::show(const bool restore, const unsigned auto_close_timeout)
 		if (restore) {
 			SDL_Rect rect = get_rect();
 			blit_from_surface(get_renderer(), restorer_, NULL, &rect);
+			add_screen_damage(rect);
 			font::undraw_floating_labels();
 		}
 		throw;
@@ -538,6 +541,7 @@ int twindow::show(const bool restore, const unsigned auto_close_timeout)
 	if (restore) {
 		SDL_Rect rect = get_rect();
 		blit_from_surface(get_renderer(), restorer_, NULL, &rect);
+		add_screen_damage(rect);
 		font::undraw_floating_labels();
 	}
 
@@ -581,11 +585,15 @@ void twindow::draw()
 
 	if (layer_draging_ && layer_background_surf_) {
 		owner_->draw_layer(frame_buffer, layer_background_surf_, layer_foreground_surf_);
+		add_screen_damage_full();
 		dirty_list_.clear();
 		return;
 	}
 
 	/***** ***** Layout and get dirty list ***** *****/
+	if (!need_layout_ && !relayout_widgets_.empty() && !layout_partial()) {
+		need_layout_ = true;
+	}
 	if (need_layout_) {
 		VALIDATE(!fix_coordinate_, "layout must not be false during draw.");
 
@@ -597,6 +605,7 @@ void twindow::draw()
 			SDL_Rect rect = get_rect();
 			blit_from_surface(get_renderer(), restorer_, NULL, &rect);
 			// Since the old area might be bigger as the new one, invalidate it.
+			add_screen_damage(rect);
 		}
 
 		layout();
@@ -620,7 +629,7 @@ void twindow::draw()
 		populate_dirty_list(*this, call_stack);
 	}
 
-	Uint32 now = SDL_GetTicks();
+	Uint32 now = benchmark::get_ticks();
 	bool require_clone = false;
 	const SDL_Rect window_rect = get_rect();
 
@@ -664,12 +673,17 @@ void twindow::draw()
 	}
 */
 	int xsrc = draw_offset_.x, ysrc = draw_offset_.y;
+	if (layer_draging_ || xsrc || ysrc) {
+		add_screen_damage_full();
+	}
 
 	BOOST_FOREACH(std::vector<twidget*>& item, dirty_list_) {
 
 		twidget* terminal = item.back();
 
 		const SDL_Rect dirty_rect = terminal->get_dirty_rect();
+		add_screen_damage(dirty_rect);
+		benchmark::count(benchmark::WIDGETS);
 
 		texture_clip_rect_setter clip(&dirty_rect);
 		/*
@@ -870,6 +884,7 @@ void twindow::undraw()
 	if(restorer_) {
 		SDL_Rect rect = get_rect();
 		blit_from_surface(get_renderer(), restorer_, NULL, &rect);
+		add_screen_damage(rect);
 		// Since the old area might be bigger as the new one, invalidate
 		// it.
 	}
@@ -894,6 +909,24 @@ void twindow::invalidate_layout()
 	}
 }
 
+void twindow::invalidate_layout(twidget* widget)
+{
+	if (fix_coordinate_ || invalidate_layout_blocked_ || need_layout_) {
+		return;
+	}
+	if (std::find(relayout_widgets_.begin(), relayout_widgets_.end(), widget) == relayout_widgets_.end()) {
+		relayout_widgets_.push_back(widget);
+	}
+}
+
+void twindow::remove_relayout_widget(const twidget* widget)
+{
+	std::vector<twidget*>::iterator it = std::find(relayout_widgets_.begin(), relayout_widgets_.end(), widget);
+	if (it != relayout_widgets_.end()) {
+		relayout_widgets_.erase(it);
+	}
+}
+
 void twindow::init_linked_size_group(const std::string& id,
 		const bool fixed_width, const bool fixed_height, bool radio)
 {
@@ -943,6 +976,9 @@ void twindow::remove_linked_widget(const std::string& id, const twidget* widget)
 
 void twindow::layout()
 {
+	const Uint32 start = SDL_GetTicks();
+	relayout_widgets_.clear();
+
 	/***** Initialize. *****/
 	boost::intrusive_ptr<const twindow_definition::tresolution> conf =
 		boost::dynamic_pointer_cast<const twindow_definition::tresolution>
@@ -1084,6 +1120,69 @@ void twindow::layout()
 	need_layout_ = false;
 
 	event::init_mouse_location();
+
+	DBG_GUI_L << "twindow::layout, " << id() << ", " << (SDL_GetTicks() - start) << " ms\n";
+}
+
+bool twindow::layout_partial()
+{
+	const Uint32 start = SDL_GetTicks();
+
+	std::vector<twidget*> widgets;
+	widgets.swap(relayout_widgets_);
+
+	std::vector<twidget*> roots;
+	BOOST_FOREACH(twidget* widget, widgets) {
+		if (widget->get_visible() != twidget::INVISIBLE) {
+			// it was skipped by the layout_init of the last layout.
+			widget->layout_init(true);
+		}
+
+		// a linked size group has to be evaluated over all of its members.
+		typedef std::pair<const std::string, tlinked_size> hack;
+		BOOST_FOREACH(const hack& linked_size, linked_size_) {
+			BOOST_FOREACH(const twidget* member, linked_size.second.widgets) {
+				for (const twidget* tmp = member; tmp; tmp = tmp->parent_) {
+					if (tmp == widget) {
+						return false;
+					}
+				}
+			}
+		}
+
+		// find the nearest parent whose size doesn't change, the full layout
+		// would place it at the same rectangle.
+		twidget* root = widget->parent();
+		while (root != this) {
+			if (!root || root->get_visible() == twidget::INVISIBLE
+				|| !root->linked_group_.empty() || root->layout_size_ != tpoint(0, 0)) {
+				return false;
+			}
+			const tpoint previous = root->best_size_;
+			const tpoint size = root->get_best_size();
+			if (size == previous && size.x <= (int)root->get_width() && size.y <= (int)root->get_height()) {
+				break;
+			}
+			root = root->parent();
+		}
+		if (root == this) {
+			return false;
+		}
+		roots.push_back(root);
+	}
+
+	BOOST_FOREACH(twidget* root, roots) {
+		root->place(root->get_origin(), root->get_size());
+		if (root->get_drawing_action() == PARTLY_DRAWN) {
+			root->set_visible_area(root->clip_rect());
+		}
+		root->set_dirty();
+	}
+
+	event::init_mouse_location();
+
+	DBG_GUI_L << "twindow::layout_partial, " << id() << ", " << roots.size() << " roots, " << (SDL_GetTicks() - start) << " ms\n";
+	return true;
 }
 
 std::vector<twidget*> twindow::set_fix_coordinate(const SDL_Rect& map_area)
@@ -1264,13 +1363,12 @@ void twindow::insert_tooltip(const std::string& msg, const twidget& widget)
 	_canvas.set_variable("tip_text_maximum_width", variant(maximum_width / twidget::hdpi_scale));
 	_canvas.set_variable("tip", variant(msg));
 
-	std::vector<tcanvas::tshape_ptr> tip;
-	tcanvas::parse_cfg(definition.cfg, tip);
+	const std::vector<tcanvas::tshape_ptr>& tip = definition.shapes;
 
 	VALIDATE(!SDL_RenderIsClipEnabled(renderer), null_str);
 	trender_target_lock lock(renderer, tooltip_surf_);
 	bool blend_none = true;
-	for (std::vector<tcanvas::tshape_ptr>::iterator it = tip.begin(); it != tip.end(); ++ it) {
+	for (std::vector<tcanvas::tshape_ptr>::const_iterator it = tip.begin(); it != tip.end(); ++ it) {
 		(*it)->draw(tooltip_surf_, w, h, _canvas.variables(), blend_none);
 		blend_none = false;
 	}
@@ -1290,6 +1388,7 @@ void twindow::draw_tooltip()
 		}
 
 		SDL_RenderCopy(renderer, tooltip_surf_.get(), NULL, &rect);
+		add_screen_overlay(rect, tooltip_surf_.get());
 		// sdl_blit(screen, &rect, tooltip_buf_, NULL);
 		// sdl_blit(tooltip_surf_, NULL, screen, &rect);
 	}
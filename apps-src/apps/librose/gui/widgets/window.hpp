@@ -266,6 +266,19 @@ public:
 	 */
 	void invalidate_layout();
 
+	/**
+	 * Updates the layout after the size of widget changed.
+	 *
+	 * Only the nearest parent of widget whose best size doesn't change is
+	 * placed again. When there is none it falls back to invalidate_layout().
+	 * Use it instead of invalidate_layout() when only the label or size of
+	 * one widget changed.
+	 */
+	void invalidate_layout(twidget* widget);
+
+	/** Forgets a widget passed to invalidate_layout(twidget*), when it is destroyed. */
+	void remove_relayout_widget(const twidget* widget);
+
 	/** Inherited from tevent_handler. */
 	twindow& get_window() { return *this; }
 
@@ -455,6 +468,13 @@ public:
 	 */
 	void layout();
 
+	/**
+	 * Layouts the parts of the window affected by relayout_widgets_.
+	 *
+	 * @returns                   false if a full layout is required.
+	 */
+	bool layout_partial();
+
 	void insert_tooltip(const std::string& msg, const twidget& widget);
 	void draw_tooltip();
 	void undraw_tooltip();
@@ -486,6 +506,9 @@ private:
 	 */
 	bool need_layout_;
 
+	/** The widgets passed to invalidate_layout(twidget*) since the last layout. */
+	std::vector<twidget*> relayout_widgets_;
+
 	/** The variables of the canvas. */
 	game_logic::map_formula_callable variables_;
 
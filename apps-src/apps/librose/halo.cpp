@@ -37,7 +37,7 @@ public:
 			const map_location& loc, ORIENTATION, bool infinite, bool xy_is_center);
 
 	void set_location(int x, int y);
-	bool render();
+	bool render(texture& screen, SDL_Renderer* renderer, const SDL_Rect& clip_rect);
 	// void unrender();
 
 	bool expired()     const { return !images_.cycles() && images_.animation_finished(); }
@@ -66,35 +66,84 @@ private:
 	rect_of_hexes overlayed_hexes2_;
 };
 
-std::map<int, effect> haloes;
-int halo_id = 1;
+enum {
+	SLOT_LIVE = 0x1,
+	SLOT_NEW = 0x2,
+	SLOT_DELETED = 0x4,
+	SLOT_CHANGING = 0x8,
+	SLOT_INVALIDATED = 0x10
+};
+
+/**
+ * Haloes are stored flat in slots, a handle is slot + 1 with generation of
+ * the slot in high bits, so a stale handle never reaches reused slot.
+ * State of halo is kept in flags of slot, lists below only index slots
+ * which have that flag, they are compacted after haloes are deleted.
+ */
+struct tslot
+{
+	tslot(const effect& e)
+		: e(e)
+		, flags(0)
+		, generation(0)
+		, sequence(0)
+		, regions(empty_rect)
+		, epoch(0)
+	{}
+
+	effect e;
+	unsigned char flags;
+	int generation;
+	/** Order of adding, haloes are rendered in this order. */
+	unsigned int sequence;
+	/** Range of regions this halo is bucketed in, w = 0 if not bucketed. */
+	SDL_Rect regions;
+	unsigned int epoch;
+};
+
+static const int slot_bits = 20;
+static const int slot_mask = (1 << slot_bits) - 1;
+static const int generation_mask = 0x7ff;
+
+std::vector<tslot> slots;
+std::vector<int> free_slots;
+int live_haloes = 0;
+unsigned int halo_sequence = 0;
+unsigned int query_epoch = 0;
 
 /**
  * Upon unrendering, an invalidation list is send. All haloes in that area and
- * the other invalidated haloes are stored in this set. Then there'll be
- * tested which haloes overlap and they're also stored in this set.
+ * the other invalidated haloes are stored in this list. Then there'll be
+ * tested which haloes overlap and they're also stored in this list.
  */
-std::set<int> invalidated_haloes;
+std::vector<int> invalidated_haloes;
 
 /**
  * A newly added halo will be added to this list, these haloes don't need to be
  * unrendered but do not to be rendered regardless which tiles are invalidated.
- * These haloes will stay in this set until there're really rendered (rendering
+ * These haloes will stay in this list until there're really rendered (rendering
  * won't happen if for example the halo is offscreen).
  */
-std::set<int> new_haloes;
+std::vector<int> new_haloes;
 
 /**
- * Upon deleting, a halo isn't deleted but added to this set, upon unrendering
+ * Upon deleting, a halo isn't deleted but added to this list, upon unrendering
  * the image is unrendered and deleted.
  */
-std::set<int> deleted_haloes;
+std::vector<int> deleted_haloes;
 
 /**
  * Haloes that have an animation or expiration time need to be checked every
- * frame and are stored in this set.
+ * frame and are stored in this list.
+ */
+std::vector<int> changing_haloes;
+
+/**
+ * Rendered haloes bucketed by region_size x region_size hexes, key is (y, x) of region.
+ * Only haloes in regions under draw area are tested whether overlap it.
  */
-std::set<int> changing_haloes;
+static const int region_size = 8;
+std::map<std::pair<int, int>, std::vector<int> > regions;
 
 effect::effect(int xpos, int ypos, const animated<image::tblit>::anim_description& img,
 		const map_location& loc, ORIENTATION orientation, bool infinite, bool xy_is_center)
@@ -127,7 +176,7 @@ void effect::set_location(int x, int y)
 	}
 }
 
-bool effect::render()
+bool effect::render(texture& screen, SDL_Renderer* renderer, const SDL_Rect& clip_rect)
 {
 	if (disp == NULL) {
 		return false;
@@ -163,7 +212,6 @@ bool effect::render()
 	const int ypos = y_ + screeny - (xy_is_center_? blit.height / 2: 0);
 
 	const SDL_Rect rect = create_rect(xpos, ypos, blit.width, blit.height);
-	SDL_Rect clip_rect = disp->map_area();
 
 	// If rendered the first time, need to determine the area affected.
 	// If a halo changes size, it is not updated.
@@ -179,10 +227,6 @@ bool effect::render()
 		return false;
 	}
 
-	texture screen = disp->get_screen_texture();
-	SDL_Renderer* renderer = get_renderer();
-
-	const texture_clip_rect_setter clip_setter(&clip_rect);
 	image::render_blit(renderer, screen, blit, rect.x, rect.y);
 	return true;
 }
@@ -192,6 +236,101 @@ void effect::add_overlay_location()
 	disp->invalidate(overlayed_hexes_);
 }
 
+// hexes under border are -1, they are put in first region, query clamp the same way.
+static int region_of(int hex)
+{
+	return hex > 0? hex / region_size: 0;
+}
+
+static SDL_Rect regions_of(const rect_of_hexes& hexes)
+{
+	const int x = region_of(hexes.left);
+	const int y = region_of(std::min(hexes.top[0], hexes.top[1]));
+	return create_rect(x, y, region_of(hexes.right) - x + 1, region_of(std::max(hexes.bottom[0], hexes.bottom[1])) - y + 1);
+}
+
+static void unbucket(tslot& slot, int at)
+{
+	const SDL_Rect& r = slot.regions;
+	for (int y = r.y; y < r.y + r.h; y ++) {
+		for (int x = r.x; x < r.x + r.w; x ++) {
+			std::map<std::pair<int, int>, std::vector<int> >::iterator it = regions.find(std::make_pair(y, x));
+			if (it == regions.end()) {
+				continue;
+			}
+			std::vector<int>& bucket = it->second;
+			std::vector<int>::iterator it2 = std::find(bucket.begin(), bucket.end(), at);
+			if (it2 != bucket.end()) {
+				bucket.erase(it2);
+			}
+			if (bucket.empty()) {
+				regions.erase(it);
+			}
+		}
+	}
+	slot.regions = empty_rect;
+}
+
+// call it after overlayed hexes of halo maybe changed, it is set_location and render.
+static void rebucket(int at)
+{
+	tslot& slot = slots[at];
+	const rect_of_hexes& hexes = slot.e.overlayed_hexes2();
+	const SDL_Rect r = hexes.valid()? regions_of(hexes): empty_rect;
+	if (r.x == slot.regions.x && r.y == slot.regions.y && r.w == slot.regions.w && r.h == slot.regions.h) {
+		return;
+	}
+	unbucket(slot, at);
+	for (int y = r.y; y < r.y + r.h; y ++) {
+		for (int x = r.x; x < r.x + r.w; x ++) {
+			regions[std::make_pair(y, x)].push_back(at);
+		}
+	}
+	slot.regions = r;
+}
+
+// return slot of handle, -1 if handle is invalid or halo is deleted.
+static int slot_of(int handle)
+{
+	if (handle == NO_HALO) {
+		return -1;
+	}
+	const int at = (handle & slot_mask) - 1;
+	if (at < 0 || at >= (int)slots.size()) {
+		return -1;
+	}
+	const tslot& slot = slots[at];
+	if (!(slot.flags & SLOT_LIVE) || (slot.generation & generation_mask) != (handle >> slot_bits)) {
+		return -1;
+	}
+	return at;
+}
+
+static void set_flag(int at, unsigned char flag, std::vector<int>& list)
+{
+	tslot& slot = slots[at];
+	if (!(slot.flags & flag)) {
+		slot.flags |= flag;
+		list.push_back(at);
+	}
+}
+
+static void compact(std::vector<int>& list, unsigned char flag)
+{
+	std::vector<int>::iterator it = list.begin();
+	for (std::vector<int>::const_iterator it2 = list.begin(); it2 != list.end(); ++ it2) {
+		if (slots[*it2].flags & flag) {
+			*it ++ = *it2;
+		}
+	}
+	list.erase(it, list.end());
+}
+
+static bool sequence_less(int a, int b)
+{
+	return slots[a].sequence < slots[b].sequence;
+}
+
 manager::manager(display& screen) : old(disp)
 {
 	disp = &screen;
@@ -199,36 +338,46 @@ manager::manager(display& screen) : old(disp)
 
 manager::~manager()
 {
-	haloes.clear();
+	slots.clear();
+	free_slots.clear();
+	live_haloes = 0;
 	invalidated_haloes.clear();
 	new_haloes.clear();
 	deleted_haloes.clear();
 	changing_haloes.clear();
+	regions.clear();
 
 	disp = old;
 }
 
-static int next_halo_id()
+static int insert_effect(const effect& e)
 {
-	int id = halo_id ++;
-	while (true) {
-		if (id == NO_HALO) {
-			// turn aournd.
-			id ++;
-			continue;
-		}
-		if (haloes.count(id)) {
-			id ++;
-			continue;
-		}
-		break;
+	int at;
+	if (!free_slots.empty()) {
+		at = free_slots.back();
+		free_slots.pop_back();
+		slots[at].e = e;
+	} else {
+		VALIDATE((int)slots.size() < slot_mask, "too many haloes!");
+		at = slots.size();
+		slots.push_back(tslot(e));
 	}
-	return id;
+	tslot& slot = slots[at];
+	slot.flags = SLOT_LIVE;
+	slot.sequence = halo_sequence ++;
+	live_haloes ++;
+
+	set_flag(at, SLOT_NEW, new_haloes);
+	return at;
+}
+
+static int handle_of(int at)
+{
+	return ((slots[at].generation & generation_mask) << slot_bits) | (at + 1);
 }
 
 int add(int x, int y, const std::string& image, const map_location& loc, ORIENTATION orientation, bool infinite)
 {
-	const int id = next_halo_id();
 	image::tblit blit;
 	animated<image::tblit>::anim_description image_vector;
 	std::vector<std::string> items = utils::parenthetical_split(image, ',');
@@ -263,30 +412,28 @@ int add(int x, int y, const std::string& image, const map_location& loc, ORIENTA
 		image_vector.push_back(animated<image::tblit>::frame_description(time, blit));
 
 	}
-	haloes.insert(std::pair<int, effect>(id, effect(x, y, image_vector, loc, orientation, infinite, true)));
-	new_haloes.insert(id);
-	if (haloes.find(id)->second.does_change() || !infinite) {
-		changing_haloes.insert(id);
+	const int at = insert_effect(effect(x, y, image_vector, loc, orientation, infinite, true));
+	if (slots[at].e.does_change() || !infinite) {
+		set_flag(at, SLOT_CHANGING, changing_haloes);
 	}
-	return id;
+	return handle_of(at);
 }
 
 int add(int x, int y, const image::tblit& blit, const map_location& loc)
 {
-	const int id = next_halo_id();
 	animated<image::tblit>::anim_description image_vector;
 	image_vector.push_back(animated<image::tblit>::frame_description(100, blit));
 
-	haloes.insert(std::pair<int, effect>(id, effect(x, y, image_vector, loc, NORMAL, true, false)));
-	new_haloes.insert(id);
-	return id;
+	const int at = insert_effect(effect(x, y, image_vector, loc, NORMAL, true, false));
+	return handle_of(at);
 }
 
 void set_location(int handle, int x, int y)
 {
-	const std::map<int,effect>::iterator itor = haloes.find(handle);
-	if (itor != haloes.end()) {
-		itor->second.set_location(x,y);
+	const int at = slot_of(handle);
+	if (at != -1) {
+		slots[at].e.set_location(x,y);
+		rebucket(at);
 	}
 }
 
@@ -294,99 +441,140 @@ void remove(int handle)
 {
 	// Silently ignore invalid haloes.
 	// This happens when Wesnoth is being terminated as well.
-	if (handle == NO_HALO || haloes.find(handle) == haloes.end())  {
+	const int at = slot_of(handle);
+	if (at == -1) {
 		return;
 	}
 
-	deleted_haloes.insert(handle);
+	set_flag(at, SLOT_DELETED, deleted_haloes);
 }
 
 void unrender()
 {
-	if (haloes.size() == 0) {
+	if (live_haloes == 0) {
 		return;
 	}
 
-	// Remove expired haloes
-	std::map<int, effect>::iterator itor = haloes.begin();
-	for (; itor != haloes.end(); ++itor ) {
-		if (itor->second.expired()) {
-			deleted_haloes.insert(itor->first);
+	// Remove expired haloes, only changing haloes can expire.
+	std::vector<int>::const_iterator itor;
+	for (itor = changing_haloes.begin(); itor != changing_haloes.end(); ++itor) {
+		if (slots[*itor].e.expired()) {
+			set_flag(*itor, SLOT_DELETED, deleted_haloes);
 		}
 	}
 
-	// Add the haloes marked for deletion to the invalidation set
-	std::set<int>::const_iterator set_itor = deleted_haloes.begin();
-	for (;set_itor != deleted_haloes.end(); ++set_itor) {
-		invalidated_haloes.insert(*set_itor);
-		haloes.find(*set_itor)->second.add_overlay_location();
+	// Add the haloes marked for deletion to the invalidation list
+	for (itor = deleted_haloes.begin(); itor != deleted_haloes.end(); ++itor) {
+		set_flag(*itor, SLOT_INVALIDATED, invalidated_haloes);
+		slots[*itor].e.add_overlay_location();
 	}
 
 	// Test the multi-frame haloes whether they need an update
-	for (set_itor = changing_haloes.begin(); set_itor != changing_haloes.end(); ++set_itor) {
-		if (haloes.find(*set_itor)->second.need_update()) {
-			invalidated_haloes.insert(*set_itor);
-			haloes.find(*set_itor)->second.add_overlay_location();
+	for (itor = changing_haloes.begin(); itor != changing_haloes.end(); ++itor) {
+		if (slots[*itor].e.need_update()) {
+			set_flag(*itor, SLOT_INVALIDATED, invalidated_haloes);
+			slots[*itor].e.add_overlay_location();
 		}
 	}
 
 	// if this effect is in current draw_area, invalidate it.
-	size_t halo_count = invalidated_haloes.size();
+	// only haloes bucketed in regions under draw_area can overlap it.
 	const rect_of_hexes& draw_area = disp->draw_area();
-	for (itor = haloes.begin(); itor != haloes.end(); ++itor) {
-		const effect& e = itor->second;
-		if (invalidated_haloes.find(itor->first) == invalidated_haloes.end()) {
-			const rect_of_hexes& hexes = e.overlayed_hexes2();
-			if (hexes.valid() && hexes.overlap(draw_area)) {
-				// If found, add all locations which the halo invalidates, and add it to the set
-				itor->second.add_overlay_location();
-				invalidated_haloes.insert(itor->first);
-				halo_count ++;
+	if (draw_area.valid() && !regions.empty()) {
+		if (!++ query_epoch) {
+			for (std::vector<tslot>::iterator it = slots.begin(); it != slots.end(); ++ it) {
+				it->epoch = 0;
+			}
+			query_epoch = 1;
+		}
+		const SDL_Rect r = regions_of(draw_area);
+		for (int y = r.y; y < r.y + r.h; y ++) {
+			std::map<std::pair<int, int>, std::vector<int> >::const_iterator it = regions.lower_bound(std::make_pair(y, r.x));
+			for (; it != regions.end() && it->first.first == y && it->first.second < r.x + r.w; ++ it) {
+				for (itor = it->second.begin(); itor != it->second.end(); ++ itor) {
+					tslot& slot = slots[*itor];
+					if (slot.epoch == query_epoch) {
+						continue;
+					}
+					slot.epoch = query_epoch;
+					if (!(slot.flags & SLOT_INVALIDATED) && slot.e.overlayed_hexes2().overlap(draw_area)) {
+						// If found, add all locations which the halo invalidates, and add it to the list
+						slot.e.add_overlay_location();
+						set_flag(*itor, SLOT_INVALIDATED, invalidated_haloes);
+					}
+				}
 			}
 		}
 	}
 
-	if (halo_count == 0) {
+	if (invalidated_haloes.empty()) {
 		return;
 	}
 
 	// Really delete the haloes marked for deletion
-	for(set_itor = deleted_haloes.begin(); set_itor != deleted_haloes.end(); ++set_itor) {
-		// It can happen a deleted halo hasn't been rendered yet, invalidate them as well
-		new_haloes.erase(*set_itor);
+	if (!deleted_haloes.empty()) {
+		for (itor = deleted_haloes.begin(); itor != deleted_haloes.end(); ++itor) {
+			// It can happen a deleted halo hasn't been rendered yet, invalidate them as well
+			tslot& slot = slots[*itor];
+			unbucket(slot, *itor);
+			slot.flags = 0;
+			slot.generation ++;
+			free_slots.push_back(*itor);
+			live_haloes --;
+		}
+		deleted_haloes.clear();
 
-		changing_haloes.erase(*set_itor);
-		invalidated_haloes.erase(*set_itor);
-		haloes.erase(*set_itor);
+		compact(new_haloes, SLOT_NEW);
+		compact(changing_haloes, SLOT_CHANGING);
+		compact(invalidated_haloes, SLOT_INVALIDATED);
 	}
-
-	deleted_haloes.clear();
 }
 
 void render()
 {
-	if (haloes.size() == 0 || (new_haloes.size() == 0 && invalidated_haloes.size() == 0)) {
+	if (live_haloes == 0 || (new_haloes.size() == 0 && invalidated_haloes.size() == 0)) {
 		return;
 	}
 
+	// Render the haloes:
+	// draw haloes in either list, in order of adding
+	std::vector<int> haloes = new_haloes;
+	for (std::vector<int>::const_iterator itor = invalidated_haloes.begin(); itor != invalidated_haloes.end(); ++ itor) {
+		if (!(slots[*itor].flags & SLOT_NEW)) {
+			haloes.push_back(*itor);
+		}
+	}
+	std::sort(haloes.begin(), haloes.end(), sequence_less);
+
 	// Keep track of not rendered new images they have to be kept scheduled
 	// for rendering otherwise the invalidation area is never properly set
-	std::set<int> unrendered_new_haloes;
+	std::vector<int> unrendered_new_haloes;
 
-	// Render the haloes:
-	// iterate through all the haloes and draw if in either set
-	for (std::map<int, effect>::iterator itor = haloes.begin(); itor != haloes.end(); ++itor) {
+	// haloes share screen, renderer and clip, set them once.
+	texture screen = disp->get_screen_texture();
+	SDL_Renderer* renderer = get_renderer();
+	const SDL_Rect clip_rect = disp->map_area();
+	const texture_clip_rect_setter clip_setter(&clip_rect);
 
-		if (new_haloes.find(itor->first) != new_haloes.end() &&	!itor->second.render()) {
-			unrendered_new_haloes.insert(itor->first);
-		} else if(invalidated_haloes.find(itor->first) != invalidated_haloes.end()) {
-			itor->second.render();
+	for (std::vector<int>::const_iterator itor = haloes.begin(); itor != haloes.end(); ++itor) {
+		tslot& slot = slots[*itor];
+		if (slot.flags & SLOT_NEW) {
+			if (!slot.e.render(screen, renderer, clip_rect)) {
+				unrendered_new_haloes.push_back(*itor);
+			} else {
+				slot.flags &= ~SLOT_NEW;
+			}
+		} else {
+			slot.e.render(screen, renderer, clip_rect);
 		}
+		rebucket(*itor);
 	}
 
+	for (std::vector<int>::const_iterator itor = invalidated_haloes.begin(); itor != invalidated_haloes.end(); ++ itor) {
+		slots[*itor].flags &= ~SLOT_INVALIDATED;
+	}
 	invalidated_haloes.clear();
 	new_haloes = unrendered_new_haloes;
 }
 
 } // end namespace halo
-
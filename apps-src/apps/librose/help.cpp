@@ -34,9 +34,11 @@
 #include "font.hpp"
 #include "wml_exception.hpp"
 #include "integrate.hpp"
+#include "filesystem.hpp"
 
 #include <boost/foreach.hpp>
 #include <queue>
+#include <cmath>
 
 namespace help {
 
@@ -98,23 +100,26 @@ std::vector<std::string> split_in_width(const std::string &s, const int font_siz
 	std::vector<std::string> res;
 	try {
 		// [see remark#24]
-		size_t pos = s.find("\n");
-		if (pos == std::string::npos) {
-			unsigned unsplit_width = font::line_size(s, font_size, style).w;
-
-			if (unsplit_width <= width) {
-				res.push_back(s);
-				return res;
-			}
-		} else {
-			const std::string line_str = s.substr(0, pos);
-			unsigned unsplit_width = font::line_size(line_str, font_size, style).w;
-			if (unsplit_width <= width) {
-				res.push_back(line_str);
-				res.push_back(s.substr(pos));
-				return res;
+		// measure first line until it exceeds width, s may be rest of a long paragraph.
+		font::tline_measurer measurer(font_size, style);
+		const utils::utf8_iterator end = utils::utf8_iterator::end(s);
+		utils::utf8_iterator it(s);
+		for (; it != end && *it != '\n'; ++ it) {
+			measurer.push(*it);
+			if (measurer.width() > (int)width) {
+				break;
 			}
 		}
+		if (it == end) {
+			res.push_back(s);
+			return res;
+
+		} else if (*it == '\n') {
+			const size_t pos = it.substr().first - s.begin();
+			res.push_back(s.substr(0, pos));
+			res.push_back(s.substr(pos));
+			return res;
+		}
 		
 		const std::string& first_line = font::word_wrap_text(s, font_size, width, -1, 1, true);
 
@@ -190,6 +195,7 @@ const config* game_cfg = NULL;
 gamemap* map = NULL;
 bool editor = false;
 section* book_toplevel = NULL;
+tsearch_index book_index;
 
 void init_book(const config* _game_cfg, gamemap* _map, bool _editor)
 {
@@ -203,6 +209,7 @@ void clear_book()
 	game_cfg = NULL;
 	map = NULL;
 	hidden_sections.clear();
+	book_index.clear();
 }
 
 const config dummy_cfg;
@@ -761,6 +768,9 @@ std::string generate_topic_text(const std::string &generator, const config *help
 
 topic* find_topic(section &sec, const std::string &id)
 {
+	if (book_index.root() == &sec) {
+		return book_index.find_topic(id);
+	}
 	topic_list::iterator tit =
 		std::find_if(sec.topics.begin(), sec.topics.end(), has_id(id));
 	if (tit != sec.topics.end()) {
@@ -778,6 +788,9 @@ topic* find_topic(section &sec, const std::string &id)
 
 section* find_section(section &sec, const std::string &id)
 {
+	if (book_index.root() == &sec) {
+		return book_index.find_section(id);
+	}
 	section_list::iterator sit =
 		std::find_if(sec.sections.begin(), sec.sections.end(), has_id(id));
 	if (sit != sec.sections.end()) {
@@ -990,6 +1003,7 @@ section parse_config(gui2::tbook* book, const config *cfg)
 
 void generate_contents(gui2::tbook* book, const std::string& tag, section& toplevel)
 {
+	book_index.clear();
 	toplevel.clear();
 	hidden_sections.clear();
 
@@ -999,6 +1013,7 @@ void generate_contents(gui2::tbook* book, const std::string& tag, section& tople
 	}
 	try {
 		toplevel = parse_config(book, help_config);
+		book_index.build(toplevel, get_user_data_dir() + "/cache/book-" + tag + ".idx");
 		// Create a config object that contains everything that is
 		// not referenced from the toplevel element. Read this
 		// config and save these sections and topics so that they
@@ -1050,6 +1065,423 @@ void generate_contents(gui2::tbook* book, const std::string& tag, section& tople
 	}
 }
 
+//
+// search index
+//
+
+static const int title_weight = 3;
+static const double bm25_k1 = 1.2;
+static const double bm25_b = 0.75;
+static const size_t max_prefix_terms = 64;
+static const uint32_t index_magic = 0x58494852; // "RHIX"
+static const uint32_t index_version = 1;
+
+static bool is_separator(const wchar_t ch)
+{
+	if (ch < 0x80) {
+		return !isalnum(ch) && ch != '_';
+	}
+	// Latin-1 punctuation, General Punctuation, CJK Symbols and Punctuation.
+	if ((ch >= 0xa0 && ch <= 0xbf) || (ch >= 0x2000 && ch <= 0x206f) || (ch >= 0x3000 && ch <= 0x303f)) {
+		return true;
+	}
+	// Fullwidth forms, except letters and digits.
+	if (ch >= 0xff00 && ch <= 0xffef) {
+		return !((ch >= 0xff10 && ch <= 0xff19) || (ch >= 0xff21 && ch <= 0xff3a) || (ch >= 0xff41 && ch <= 0xff5a));
+	}
+	return false;
+}
+
+static bool is_cjk_term(const std::string& term)
+{
+	utils::utf8_iterator it(term);
+	return it != utils::utf8_iterator::end(term) && font::is_cjk_char(*it);
+}
+
+/**
+ * Split text into lowercase terms. Words are runs of letters and digits.
+ * CJK text has no space between words, so every CJK character and every
+ * pair of adjacent CJK characters is a term.
+ * Tags of tintegrate's markup are skipped, and so are values of keys in it
+ * except text=.
+ */
+static void tokenize(const std::string& text, std::vector<std::string>& terms)
+{
+	wide_string src;
+	try {
+		src = utils::string_to_wstring(text);
+	} catch (utils::invalid_utf8_exception&) {
+		return;
+	}
+
+	const size_t size = src.size();
+	wide_string word;
+	wchar_t previous_cjk = 0;
+	for (size_t at = 0; at < size; at ++) {
+		const wchar_t ch = src[at];
+		if (font::is_cjk_char(ch) && !is_separator(ch)) {
+			if (!word.empty()) {
+				terms.push_back(utils::lowercase(utils::wstring_to_string(word)));
+				word.clear();
+			}
+			const std::string unigram = utils::wchar_to_string(ch);
+			terms.push_back(unigram);
+			if (previous_cjk) {
+				terms.push_back(utils::wchar_to_string(previous_cjk) + unigram);
+			}
+			previous_cjk = ch;
+			continue;
+		}
+		previous_cjk = 0;
+
+		if (!is_separator(ch)) {
+			word.push_back(ch);
+			continue;
+		}
+
+		if (ch == '=' && !word.empty()) {
+			// key of markup.
+			const bool text_key = word.size() == 4 && word[0] == 't' && word[1] == 'e' && word[2] == 'x' && word[3] == 't';
+			word.clear();
+			if (!text_key && at + 1 < size) {
+				if (src[at + 1] == '\'') {
+					for (at += 2; at < size && src[at] != '\''; at ++) {}
+				} else {
+					for (; at + 1 < size && src[at + 1] != ' ' && src[at + 1] != '<'; at ++) {}
+				}
+			}
+			continue;
+		}
+		if (!word.empty()) {
+			terms.push_back(utils::lowercase(utils::wstring_to_string(word)));
+			word.clear();
+		}
+		if (ch == '<' && at + 1 < size && (src[at + 1] == '/' || isalpha(src[at + 1]))) {
+			// tag, <format>, </format>...
+			size_t end = at + 1;
+			for (; end < size && src[end] != '>' && src[end] != ' ' && src[end] != '\n'; end ++) {}
+			if (end < size && src[end] == '>') {
+				at = end;
+			}
+		}
+	}
+	if (!word.empty()) {
+		terms.push_back(utils::lowercase(utils::wstring_to_string(word)));
+	}
+}
+
+static void write_u32(std::string& blob, uint32_t val)
+{
+	blob.append(reinterpret_cast<const char*>(&val), sizeof(val));
+}
+
+static void write_str(std::string& blob, const std::string& str)
+{
+	write_u32(blob, str.size());
+	blob.append(str);
+}
+
+class tblob_reader
+{
+public:
+	tblob_reader(const std::string& blob)
+		: blob_(blob)
+		, at_(0)
+	{}
+
+	bool read(void* data, size_t size)
+	{
+		if (at_ + size > blob_.size()) {
+			return false;
+		}
+		memcpy(data, blob_.c_str() + at_, size);
+		at_ += size;
+		return true;
+	}
+	bool read_u32(uint32_t& val) { return read(&val, sizeof(val)); }
+	bool read_str(std::string& str)
+	{
+		uint32_t size;
+		if (!read_u32(size) || at_ + size > blob_.size()) {
+			return false;
+		}
+		str.assign(blob_.c_str() + at_, size);
+		at_ += size;
+		return true;
+	}
+	bool end() const { return at_ == blob_.size(); }
+
+private:
+	const std::string& blob_;
+	size_t at_;
+};
+
+void tsearch_index::clear()
+{
+	root_ = NULL;
+	topics_.clear();
+	sections_.clear();
+	docs_.clear();
+	doc_len_.clear();
+	avg_len_ = 0;
+	terms_.clear();
+	postings_.clear();
+	cache_.clear();
+	indexed_ = false;
+}
+
+// keep first one of duplicated id, in the order find_topic/find_section walk.
+void tsearch_index::fill_ids(section& sec)
+{
+	for (topic_list::iterator it = sec.topics.begin(); it != sec.topics.end(); ++ it) {
+		topic& t = *it;
+		if (topics_.insert(std::make_pair(t.id, &t)).second) {
+			docs_.push_back(&t);
+		}
+	}
+	for (section_list::iterator it = sec.sections.begin(); it != sec.sections.end(); ++ it) {
+		sections_.insert(std::make_pair((*it)->id, *it));
+	}
+	for (section_list::iterator it = sec.sections.begin(); it != sec.sections.end(); ++ it) {
+		fill_ids(**it);
+	}
+}
+
+uint64_t tsearch_index::digest() const
+{
+	uint64_t ret = hash64(&index_version, sizeof(index_version));
+	for (std::vector<topic*>::const_iterator it = docs_.begin(); it != docs_.end(); ++ it) {
+		const topic& t = **it;
+		const std::string& title = t.title.str();
+		const std::string& text = t.text.parsed_text().str();
+		ret = hash64(t.id.c_str(), t.id.size() + 1, ret);
+		ret = hash64(title.c_str(), title.size() + 1, ret);
+		ret = hash64(text.c_str(), text.size() + 1, ret);
+	}
+	return ret;
+}
+
+void tsearch_index::index_text()
+{
+	std::map<std::string, std::vector<tposting> > postings;
+	std::vector<std::string> terms;
+	std::map<std::string, int> tfs;
+	int sum_len = 0;
+
+	for (size_t doc = 0; doc < docs_.size(); doc ++) {
+		const topic& t = *docs_[doc];
+		tfs.clear();
+		int len = 0;
+
+		terms.clear();
+		tokenize(t.title.str(), terms);
+		for (std::vector<std::string>::const_iterator it = terms.begin(); it != terms.end(); ++ it) {
+			tfs[*it] += title_weight;
+		}
+		len += terms.size() * title_weight;
+
+		terms.clear();
+		tokenize(t.text.parsed_text().str(), terms);
+		for (std::vector<std::string>::const_iterator it = terms.begin(); it != terms.end(); ++ it) {
+			tfs[*it] ++;
+		}
+		len += terms.size();
+
+		for (std::map<std::string, int>::const_iterator it = tfs.begin(); it != tfs.end(); ++ it) {
+			postings[it->first].push_back(tposting(doc, it->second));
+		}
+		doc_len_.push_back(len);
+		sum_len += len;
+	}
+
+	terms_.reserve(postings.size());
+	postings_.reserve(postings.size());
+	for (std::map<std::string, std::vector<tposting> >::iterator it = postings.begin(); it != postings.end(); ++ it) {
+		terms_.push_back(it->first);
+		postings_.push_back(std::vector<tposting>());
+		postings_.back().swap(it->second);
+	}
+	avg_len_ = docs_.empty()? 0: (double)sum_len / docs_.size();
+}
+
+std::string tsearch_index::serialize(uint64_t digest) const
+{
+	std::string blob;
+	write_u32(blob, index_magic);
+	write_u32(blob, index_version);
+	blob.append(reinterpret_cast<const char*>(&digest), sizeof(digest));
+
+	write_u32(blob, doc_len_.size());
+	for (std::vector<int>::const_iterator it = doc_len_.begin(); it != doc_len_.end(); ++ it) {
+		write_u32(blob, *it);
+	}
+	write_u32(blob, terms_.size());
+	for (size_t at = 0; at < terms_.size(); at ++) {
+		write_str(blob, terms_[at]);
+		const std::vector<tposting>& postings = postings_[at];
+		write_u32(blob, postings.size());
+		for (std::vector<tposting>::const_iterator it = postings.begin(); it != postings.end(); ++ it) {
+			write_u32(blob, it->doc);
+			write_u32(blob, it->tf);
+		}
+	}
+	return blob;
+}
+
+bool tsearch_index::unserialize(const std::string& blob, uint64_t digest)
+{
+	tblob_reader reader(blob);
+	uint32_t magic, version, size;
+	uint64_t digest2;
+	if (!reader.read_u32(magic) || magic != index_magic || !reader.read_u32(version) || version != index_version) {
+		return false;
+	}
+	if (!reader.read(&digest2, sizeof(digest2)) || digest2 != digest) {
+		return false;
+	}
+
+	if (!reader.read_u32(size) || size != docs_.size()) {
+		return false;
+	}
+	int sum_len = 0;
+	doc_len_.resize(size);
+	for (uint32_t at = 0; at < size; at ++) {
+		uint32_t len;
+		if (!reader.read_u32(len)) {
+			return false;
+		}
+		doc_len_[at] = len;
+		sum_len += len;
+	}
+
+	if (!reader.read_u32(size)) {
+		return false;
+	}
+	terms_.resize(size);
+	postings_.resize(size);
+	for (uint32_t at = 0; at < size; at ++) {
+		uint32_t nposts;
+		if (!reader.read_str(terms_[at]) || !reader.read_u32(nposts)) {
+			return false;
+		}
+		std::vector<tposting>& postings = postings_[at];
+		postings.reserve(nposts);
+		for (uint32_t n = 0; n < nposts; n ++) {
+			uint32_t doc, tf;
+			if (!reader.read_u32(doc) || !reader.read_u32(tf) || doc >= docs_.size()) {
+				return false;
+			}
+			postings.push_back(tposting(doc, tf));
+		}
+	}
+	avg_len_ = docs_.empty()? 0: (double)sum_len / docs_.size();
+	return reader.end();
+}
+
+void tsearch_index::build(section& toplevel, const std::string& cache)
+{
+	clear();
+	root_ = &toplevel;
+	fill_ids(toplevel);
+	cache_ = cache;
+}
+
+void tsearch_index::index_lazily()
+{
+	if (indexed_) {
+		return;
+	}
+	indexed_ = true;
+	const uint32_t start = SDL_GetTicks();
+	const std::string& cache = cache_;
+
+	const uint64_t hash = digest();
+	if (!cache.empty() && unserialize(read_file(cache), hash)) {
+		posix_print("help index, %u topics, %u terms, loaded in %u ms\n", (unsigned)docs_.size(), (unsigned)terms_.size(), SDL_GetTicks() - start);
+		return;
+	}
+	doc_len_.clear();
+	terms_.clear();
+	postings_.clear();
+
+	index_text();
+	if (!cache.empty()) {
+		const std::string blob = serialize(hash);
+		create_directory_if_missing(directory_name(cache));
+		write_file(cache, blob.c_str(), blob.size());
+	}
+	posix_print("help index, %u topics, %u terms, built in %u ms\n", (unsigned)docs_.size(), (unsigned)terms_.size(), SDL_GetTicks() - start);
+}
+
+topic* tsearch_index::find_topic(const std::string& id) const
+{
+	boost::unordered_map<std::string, topic*>::const_iterator it = topics_.find(id);
+	return it != topics_.end()? it->second: NULL;
+}
+
+section* tsearch_index::find_section(const std::string& id) const
+{
+	boost::unordered_map<std::string, section*>::const_iterator it = sections_.find(id);
+	return it != sections_.end()? it->second: NULL;
+}
+
+void tsearch_index::score_term(size_t at, std::vector<double>& scores) const
+{
+	const std::vector<tposting>& postings = postings_[at];
+	const double df = postings.size();
+	const double idf = log(1 + (docs_.size() - df + 0.5) / (df + 0.5));
+	for (std::vector<tposting>::const_iterator it = postings.begin(); it != postings.end(); ++ it) {
+		const double tf = it->tf;
+		const double norm = bm25_k1 * (1 - bm25_b + bm25_b * doc_len_[it->doc] / avg_len_);
+		scores[it->doc] += idf * tf * (bm25_k1 + 1) / (tf + norm);
+	}
+}
+
+static bool hit_greater(const tsearch_index::thit& a, const tsearch_index::thit& b)
+{
+	return a.score > b.score;
+}
+
+std::vector<tsearch_index::thit> tsearch_index::search(const std::string& query, size_t max_hits)
+{
+	std::vector<thit> result;
+	std::vector<std::string> terms;
+	tokenize(query, terms);
+	if (terms.empty() || docs_.empty()) {
+		return result;
+	}
+	index_lazily();
+	const std::string last = terms.back();
+	const bool prefix = !is_cjk_term(last) && !isspace(static_cast<unsigned char>(query[query.size() - 1]));
+
+	std::sort(terms.begin(), terms.end());
+	terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+
+	std::vector<double> scores(docs_.size(), 0);
+	for (std::vector<std::string>::const_iterator it = terms.begin(); it != terms.end(); ++ it) {
+		const std::string& term = *it;
+		size_t at = std::lower_bound(terms_.begin(), terms_.end(), term) - terms_.begin();
+		if (prefix && term == last) {
+			for (size_t n = 0; at < terms_.size() && n < max_prefix_terms && !terms_[at].compare(0, term.size(), term); at ++, n ++) {
+				score_term(at, scores);
+			}
+		} else if (at < terms_.size() && terms_[at] == term) {
+			score_term(at, scores);
+		}
+	}
+
+	for (size_t doc = 0; doc < scores.size(); doc ++) {
+		if (scores[doc] > 0) {
+			result.push_back(thit(docs_[doc], scores[doc]));
+		}
+	}
+	std::stable_sort(result.begin(), result.end(), hit_greater);
+	if (result.size() > max_hits) {
+		result.erase(result.begin() + max_hits, result.end());
+	}
+	return result;
+}
+
 } // End namespace help.
 
 std::string single_digit_image(int digit)
@@ -25,6 +25,7 @@ class config;
 #include "gui/auxiliary/canvas.hpp"
 
 #include <list>
+#include <boost/unordered_map.hpp>
 
 class display;
 
@@ -224,6 +225,83 @@ public:
 	}
 };
 
+/// Full-text index of one book. When contents are generated it only maps id
+/// to topic/section, so find_topic/find_section on the indexed toplevel don't
+/// walk the tree. Text is indexed at first search, because it requires every
+/// topic's generator to run.
+class tsearch_index
+{
+public:
+	struct thit {
+		thit(const topic* t, double score)
+			: t(t)
+			, score(score)
+		{}
+
+		const topic* t;
+		double score;
+	};
+
+	tsearch_index()
+		: root_(NULL)
+		, topics_()
+		, sections_()
+		, docs_()
+		, doc_len_()
+		, avg_len_(0)
+		, terms_()
+		, postings_()
+		, cache_()
+		, indexed_(false)
+	{}
+
+	/// Map ids of all topics under toplevel. If cache is not empty, text index
+	/// is read from it when book isn't changed, else written to it after built.
+	void build(section& toplevel, const std::string& cache);
+	void clear();
+
+	const section* root() const { return root_; }
+	topic* find_topic(const std::string& id) const;
+	section* find_section(const std::string& id) const;
+
+	/// Return best matched topics, ranked by BM25.
+	/// Last word of query is prefix if query doesn't end with space.
+	std::vector<thit> search(const std::string& query, size_t max_hits = 20);
+
+private:
+	struct tposting {
+		tposting(int doc, int tf)
+			: doc(doc)
+			, tf(tf)
+		{}
+
+		int doc;
+		// term frequency, word in title is weighted.
+		int tf;
+	};
+
+	void fill_ids(section& sec);
+	void index_lazily();
+	uint64_t digest() const;
+	void index_text();
+	std::string serialize(uint64_t digest) const;
+	bool unserialize(const std::string& blob, uint64_t digest);
+
+	void score_term(size_t at, std::vector<double>& scores) const;
+
+	const section* root_;
+	boost::unordered_map<std::string, topic*> topics_;
+	boost::unordered_map<std::string, section*> sections_;
+	std::vector<topic*> docs_;
+	std::vector<int> doc_len_;
+	double avg_len_;
+	// sorted, so prefix query is a range of it.
+	std::vector<std::string> terms_;
+	std::vector<std::vector<tposting> > postings_;
+	std::string cache_;
+	bool indexed_;
+};
+
 struct delete_section
 {
 	void operator()(section *s) { delete s; }
@@ -246,6 +324,7 @@ extern gamemap* map;
 extern bool editor;
 
 extern section* book_toplevel;
+extern tsearch_index book_index;
 
 std::string escape(const std::string &s);
 std::string hidden_symbol(bool hidden = true);
@@ -799,10 +799,17 @@ public:
 	void change_language();
 
 private:
+	void map_from_records(const uint8_t* data, uint32_t size, bool check);
+	void delete_hero(hero* h);
+
 	size_t map_size_;
 
 	hero** map_;
 	uint16_t map_vsize_;
+
+	// heroes loaded from records are constructed in this one block.
+	hero* block_;
+	size_t block_size_;
 };
 
 //
@@ -1490,7 +1490,9 @@ size_t hero_map::map_size_from_dat = 0;
 hero_map::hero_map(const std::string& path) :
 	map_size_(0),
 	map_(NULL),
-	map_vsize_(0)
+	map_vsize_(0),
+	block_(NULL),
+	block_size_(0)
 {
 	if (!path.empty()) {
 		set_path(path);
@@ -1527,14 +1529,29 @@ void hero_map::realloc_hero_map(const size_t size)
 	map_vsize_ = 0;
 }
 
+void hero_map::delete_hero(hero* h)
+{
+	if (h >= block_ && h < block_ + block_size_) {
+		h->~hero();
+	} else {
+		delete h;
+	}
+}
+
 void hero_map::clear_map()
 {
 	for (size_t i = 0; i != map_vsize_; ++i) {
-		delete(map_[i]);
+		delete_hero(map_[i]);
 	}
 	free(map_);
 	map_ = NULL;
 	map_vsize_ = 0;
+
+	if (block_) {
+		free(block_);
+		block_ = NULL;
+		block_size_ = 0;
+	}
 }
 
 hero_map::iterator hero_map::begin() 
@@ -1588,7 +1605,7 @@ void hero_map::erase(const uint16_t number)
 	if (number >= map_vsize_) {
 		return;
 	}
-	delete map_[number];
+	delete_hero(map_[number]);
 	if (number != (map_vsize_ - 1)) {
 		memcpy(&(map_[number]), &(map_[number + 1]), (map_vsize_ - number - 1) * sizeof(hero*));
 	}
@@ -1599,63 +1616,59 @@ void hero_map::erase(const uint16_t number)
 	}
 }
 
-bool hero_map::map_from_file(const std::string& fname)
+// construct hero of every valid record in place, in one block, and add it.
+// check: check_valid every record, print ones that are invalid.
+void hero_map::map_from_records(const uint8_t* data, uint32_t size, bool check)
 {
-	posix_file_t fp = INVALID_FILE;
-	int64_t fsize, rdpos;
-	uint8_t* fdata = NULL;
-	uint32_t data_size;
-	bool fok = false;
+	// realloc map memory in hero_map
+	realloc_hero_map(HEROS_MAX_HEROS);
 
-	posix_fopen(fname.c_str(), GENERIC_READ, OPEN_EXISTING, fp);
-	if (fp == INVALID_FILE) {
-		goto exit;
-	}
-	fsize = posix_fsize(fp);
-	if (fsize < HEROS_FILE_PREFIX_BYTES) {
-		goto exit;
-	}
-	fdata = (uint8_t*)malloc(fsize);
-	if (!fdata) {
-		goto exit;
+	const uint32_t records = size / HEROS_BYTES_PER_HERO;
+	if (!records) {
+		return;
 	}
-	posix_fseek(fp, HEROS_FILE_PREFIX_BYTES);
-	data_size = posix_fread(fp, fdata, fsize - HEROS_FILE_PREFIX_BYTES);
+	block_ = (hero*)malloc(records * sizeof(hero));
+	block_size_ = records;
 
-	rdpos = 0;
-	// realloc map memory in hero_map
-	realloc_hero_map(HEROS_MAX_HEROS);
-	while (rdpos + HEROS_BYTES_PER_HERO <= data_size) {
-		hero h(fdata + rdpos);
+	for (uint32_t rdpos = 0; rdpos + HEROS_BYTES_PER_HERO <= size; rdpos += HEROS_BYTES_PER_HERO) {
+		hero* h = new (block_ + rdpos / HEROS_BYTES_PER_HERO) hero(data + rdpos);
 
-		if (!h.check_valid()) {
+		if (check && !h->check_valid()) {
 			std::stringstream strstr;
-			strstr << h.name() << "'s set is invalid!";
+			strstr << h->name() << "'s set is invalid!";
 			posix_print_mb(utf8_2_ansi(strstr.str().c_str()));
 		}
-		
-		if (h.valid()) {
-			add(h);
+
+		if (h->valid()) {
+			h->number_ = map_vsize_;
+			map_[map_vsize_ ++] = h;
+		} else {
+			h->~hero();
 		}
-		rdpos += HEROS_BYTES_PER_HERO;
 	}
+}
 
-	fok = true;
+bool hero_map::map_from_file(const std::string& fname)
+{
+	const uint32_t start = SDL_GetTicks();
 
-exit:
-	if (fp != INVALID_FILE) {
-		posix_fclose(fp);
+	tfile lock(fname, GENERIC_READ, OPEN_EXISTING);
+	if (!lock.valid()) {
+		return false;
 	}
-	if (fdata) {
-		free(fdata);
+	const int64_t fsize = lock.read_2_data();
+	if (fsize < HEROS_FILE_PREFIX_BYTES) {
+		return false;
 	}
+	map_from_records((const uint8_t*)lock.data + HEROS_FILE_PREFIX_BYTES, fsize - HEROS_FILE_PREFIX_BYTES, true);
 
-	return fok;
+	posix_print("%s, %u heroes, loaded in %u ms\n", fname.c_str(), map_vsize_, SDL_GetTicks() - start);
+	return true;
 }
 
 bool hero_map::map_from_file_fp(posix_file_t fp, uint32_t file_offset, uint32_t valid_bytes)
 {
-	int64_t fsize, rdpos;
+	int64_t fsize;
 	uint8_t* fdata = NULL;
 	bool fok = false;
 
@@ -1679,16 +1692,7 @@ bool hero_map::map_from_file_fp(posix_file_t fp, uint32_t file_offset, uint32_t
 		data_size = posix_fread(fp, fdata, fsize - file_offset - HEROS_FILE_PREFIX_BYTES);
 	}
 
-	rdpos = 0;
-	// realloc map memory in hero_map
-	realloc_hero_map(HEROS_MAX_HEROS);
-	while (rdpos + HEROS_BYTES_PER_HERO <= data_size) {
-		hero h(fdata + rdpos);
-		if (h.valid()) {
-			add(h);
-		}
-		rdpos += HEROS_BYTES_PER_HERO;
-	}
+	map_from_records(fdata, data_size, false);
 
 	fok = true;
 exit:
@@ -1705,18 +1709,7 @@ bool hero_map::map_from_mem(const uint8_t* mem, int len)
 		return false;
 	}
 
-	int rdpos = HEROS_FILE_PREFIX_BYTES;
-	// realloc map memory in hero_map
-	realloc_hero_map(HEROS_MAX_HEROS);
-	while (rdpos + HEROS_BYTES_PER_HERO <= len) {
-		hero h(mem + rdpos);
-
-		if (h.valid()) {
-			add(h);
-		}
-		rdpos += HEROS_BYTES_PER_HERO;
-	}
-
+	map_from_records(mem + HEROS_FILE_PREFIX_BYTES, len - HEROS_FILE_PREFIX_BYTES, false);
 	return true;
 }
 
@@ -114,7 +114,7 @@ std::string tintegrate::generate_format(int val, const std::string& color, int f
 }
 
 tintegrate::titem::titem(surface surface, int tag_pos, int pos, int x, int y, const std::string& _text,
-						   const std::string& reference_to, int font_size, int style, int src_size,
+						   const std::string& reference_to, int font_size, int style, const SDL_Color& color, int src_size,
 						   bool _floating, bool _box, ALIGNMENT alignment) :
 	rect(),
 	surf(surface),
@@ -125,6 +125,7 @@ tintegrate::titem::titem(surface surface, int tag_pos, int pos, int x, int y, co
 	ref_to(reference_to),
 	font_size(font_size),
 	style(style),
+	color(color),
 	src_size(src_size),
 	floating(_floating), box(_box),
 	align(alignment)
@@ -150,6 +151,7 @@ tintegrate::titem::titem(surface surface, int pos, int x, int y, int src_size, b
 	ref_to(""),
 	font_size(font::SIZE_NORMAL),
 	style(TTF_STYLE_NORMAL),
+	color(font::NORMAL_COLOR),
 	src_size(src_size),
 	floating(_floating),
 	box(_box),
@@ -170,6 +172,7 @@ tintegrate::titem::titem(const config& anim, int pos, const SDL_Rect& rect, int
 	ref_to(""),
 	font_size(font::SIZE_NORMAL),
 	style(TTF_STYLE_NORMAL),
+	color(font::NORMAL_COLOR),
 	src_size(src_size),
 	floating(_floating),
 	box(_box),
@@ -224,11 +227,28 @@ std::string tintegrate::drop_escape(const std::string& str)
 
 tintegrate* share_canvas_integrate = NULL;
 
-tintegrate::tintegrate(const std::string& src, int maximum_width, int maximum_height, int default_font_size, const SDL_Color& default_font_color, bool editable)
+static std::string rendered_text_key(const std::string& text, int font_size, const SDL_Color& color, int style)
+{
+	std::stringstream key;
+	key << text << '\0' << font_size << ',' << style << ',' << (int)color.r << ',' << (int)color.g << ',' << (int)color.b << ',' << (int)color.a;
+	return key.str();
+}
+
+tintegrate::tintegrate(const std::string& src, int maximum_width, int maximum_height, int default_font_size, const SDL_Color& default_font_color, bool editable, tintegrate* reuse)
 	: src_(editable? src: null_str)
 	, editable_(editable)
 	, items_()
 	, last_row_()
+	, rows_()
+	, plain_text_(false)
+	, floating_items_()
+	, line_surfaces_()
+	, reuse_surfaces_()
+	, previous_(NULL)
+	, change_end_(0)
+	, src_delta_(0)
+	, taken_over_(false)
+	, relaid_surfaces_()
 	, title_spacing_(16)
 	, curr_loc_(0, 0)
 	, min_row_height_(font::get_max_height(normal_font_size))
@@ -243,6 +263,13 @@ tintegrate::tintegrate(const std::string& src, int maximum_width, int maximum_he
 	, anims_()
 	, bubble_anims_()
 {
+	if (reuse) {
+		if (relayout(*reuse)) {
+			return;
+		}
+		reuse_surfaces_.swap(reuse->line_surfaces_);
+	}
+
 	// Parse and add the text.
 	std::map<int, std::string> parsed_items;
 
@@ -253,8 +280,18 @@ tintegrate::tintegrate(const std::string& src, int maximum_width, int maximum_he
 		add_text_item(0, 0, src, default_font_color_);
 	}
 
+	layout_cfgs(parsed_items);
+
+	down_one_line(); // End the last line.
+
+	// surfaces that don't appear in this layout are stale.
+	reuse_surfaces_.clear();
+}
+
+void tintegrate::layout_cfgs(const std::map<int, std::string>& parsed_items)
+{
 	std::map<int, std::string>::const_iterator it;
-	for (it = parsed_items.begin(); it != parsed_items.end(); ++it) {
+	for (it = parsed_items.begin(); it != parsed_items.end() && !taken_over_; ++it) {
 		std::string name;
 		if (utils::is_single_cfg(it->second, &name)) {
 			// Should be parsed as WML.
@@ -286,11 +323,179 @@ tintegrate::tintegrate(const std::string& src, int maximum_width, int maximum_he
 #undef TRY
 
 		} else {
+			plain_text_ = true;
 			add_text_item(it->first, it->first, it->second, default_font_color_);
+			plain_text_ = false;
 		}
 	}
+}
 
-	down_one_line(); // End the last line.
+size_t tintegrate::lower_row(const std::vector<trow>& rows, int pos)
+{
+	size_t first = 0;
+	size_t last = rows.size();
+	while (first < last) {
+		size_t mid = (first + last) / 2;
+		if (rows[mid].pos < pos) {
+			first = mid + 1;
+		} else {
+			last = mid;
+		}
+	}
+	return first;
+}
+
+// Typing changes one or two rows of a large text. Rows in front of the edit are same as
+// previous layout's, so wrapping restarts at the row in front of the first edited row.
+// Once a row starts at a src position that previous layout has a row at, behind the edit,
+// the rest wraps as before and is taken over too. see take_over_rest.
+bool tintegrate::relayout(tintegrate& previous)
+{
+	if (!editable_ || !previous.editable_ || previous.rows_.empty() || !previous.floating_items_.empty() || previous.exist_anim_) {
+		return false;
+	}
+	if (previous.maximum_width_ != maximum_width_ || previous.maximum_height_ != maximum_height_
+		|| previous.default_font_size_ != default_font_size_ || previous.default_font_color_ != default_font_color_) {
+		return false;
+	}
+
+	const std::string& previous_src = previous.src_;
+	const int size = std::min(src_.size(), previous_src.size());
+	int prefix = 0;
+	while (prefix < size && src_[prefix] == previous_src[prefix]) {
+		prefix ++;
+	}
+	int suffix = 0;
+	while (suffix < size - prefix && src_[src_.size() - 1 - suffix] == previous_src[previous_src.size() - 1 - suffix]) {
+		suffix ++;
+	}
+
+	// a shorter first word of the edited row may fit the row in front of it.
+	std::vector<trow>& rows = previous.rows_;
+	int row = (int)lower_row(rows, prefix + 1) - 1;
+	if (row < 0) {
+		return false;
+	}
+	if (row) {
+		row --;
+	}
+	while (row >= 0 && !rows[row].plain) {
+		row --;
+	}
+	if (row < 0) {
+		return false;
+	}
+	const int start = rows[row].pos;
+
+	// plain text from start to next markup.
+	const char escape_char = '\\';
+	std::string text;
+	size_t end = start;
+	for (; end < src_.size(); end ++) {
+		char c = src_[end];
+		if (c == escape_char) {
+			if (++ end == src_.size()) {
+				break;
+			}
+			c = src_[end];
+		} else if (c == '<') {
+			break;
+		}
+		text.push_back(c);
+	}
+	// plain text that is [name]...[/name] is parsed as WML, let full layout do it.
+	size_t last = end;
+	while (last && (src_[last - 1] == ' ' || src_[last - 1] == '\t' || src_[last - 1] == '\r' || src_[last - 1] == '\n')) {
+		last --;
+	}
+	if (last && src_[last - 1] == ']') {
+		return false;
+	}
+
+	std::map<int, std::string> parsed_items;
+	if (end < src_.size()) {
+		try {
+			const std::map<int, std::string> rest = utils::to_cfgs(src_.substr(end));
+			for (std::map<int, std::string>::const_iterator it = rest.begin(); it != rest.end(); ++ it) {
+				parsed_items.insert(parsed_items.end(), std::make_pair((int)end + it->first, it->second));
+			}
+		} catch (twml_exception& /* e */) {
+			return false;
+		}
+	}
+
+	previous_ = &previous;
+	change_end_ = src_.size() - suffix;
+	src_delta_ = (int)src_.size() - (int)previous_src.size();
+	line_surfaces_.swap(previous.line_surfaces_);
+
+	const trow& from = rows[row];
+	items_.splice(items_.end(), previous.items_, previous.items_.begin(), from.first);
+	rows_.assign(rows.begin(), rows.begin() + row);
+	curr_loc_ = std::make_pair(0, from.y);
+	if (row) {
+		contents_height_ = from.y + min_row_height_;
+	}
+
+	plain_text_ = true;
+	add_text_item(start, start, text, default_font_color_);
+	plain_text_ = false;
+	layout_cfgs(parsed_items);
+
+	if (!taken_over_) {
+		down_one_line(); // End the last line.
+	}
+
+	// previous layout keeps items of relaid rows only, surfaces of them are stale.
+	for (std::list<titem>::const_iterator it = previous.items_.begin(); it != previous.items_.end(); ++ it) {
+		const titem& item = *it;
+		if (item.surf && !item.text.empty()) {
+			const std::string key = rendered_text_key(item.text, item.font_size, item.color, item.style);
+			if (relaid_surfaces_.find(key) == relaid_surfaces_.end()) {
+				line_surfaces_.erase(key);
+			}
+		}
+	}
+	relaid_surfaces_.clear();
+	previous_ = NULL;
+	return true;
+}
+
+bool tintegrate::take_over_rest(int start)
+{
+	if (!plain_text_ || start < change_end_ || !last_row_.empty() || curr_loc_.first || !floating_items_.empty() || maximum_width_ != previous_->maximum_width_) {
+		return false;
+	}
+
+	std::vector<trow>& rows = previous_->rows_;
+	const size_t row = lower_row(rows, start - src_delta_);
+	if (row == rows.size() || rows[row].pos != start - src_delta_ || !rows[row].plain) {
+		return false;
+	}
+
+	// from here, src is same as previous layout's, so are rows.
+	std::list<titem>& items = previous_->items_;
+	const std::list<titem>::iterator first = rows[row].first;
+	const int dy = curr_loc_.second - rows[row].y;
+	for (std::list<titem>::iterator it = first; it != items.end(); ++ it) {
+		titem& item = *it;
+		item.tag_pos += src_delta_;
+		item.pos += src_delta_;
+		item.rect.y += dy;
+		item.holden_rect.y += dy;
+	}
+	for (std::vector<trow>::const_iterator it = rows.begin() + row; it != rows.end(); ++ it) {
+		rows_.push_back(trow(it->pos + src_delta_, it->y + dy, it->first, it->plain));
+	}
+	items_.splice(items_.end(), items, first, items.end());
+
+	curr_loc_ = previous_->curr_loc_;
+	curr_loc_.second += dy;
+	curr_row_height_ = previous_->curr_row_height_;
+	contents_height_ = previous_->contents_height_ + dy;
+
+	taken_over_ = true;
+	return true;
 }
 
 tintegrate::~tintegrate()
@@ -434,6 +639,9 @@ void tintegrate::handle_format_cfg(int tag_start, const config &cfg)
 void tintegrate::add_text_item(int tag_start, int start, const std::string& text, const SDL_Color& text_color, const std::string& ref_dst,
 							   bool broken_link, int _font_size, bool bold, bool italic)
 {
+	if (previous_ && (taken_over_ || take_over_rest(start))) {
+		return;
+	}
 	const int font_size = _font_size < 0 ? default_font_size_ : _font_size;
 	if (text.empty()) {
 		return;
@@ -453,7 +661,7 @@ void tintegrate::add_text_item(int tag_start, int start, const std::string& text
 			if (editable_) {
 				validate_str(start, src_text_size, "\n");
 			}
-			add_item(titem(surface(), tag_start, start, curr_loc_.first, curr_loc_.second, null_str, null_str, curr_row_height_, TTF_STYLE_NORMAL, src_text_size));
+			add_item(titem(surface(), tag_start, start, curr_loc_.first, curr_loc_.second, null_str, null_str, curr_row_height_, TTF_STYLE_NORMAL, text_color, src_text_size));
 		}
 		start += src_text_size;
 
@@ -488,7 +696,7 @@ void tintegrate::add_text_item(int tag_start, int start, const std::string& text
 		else
 			color = font::YELLOW_COLOR;
 
-		surface surf(font::get_rendered_text(first_part, font_size, color, state));
+		surface surf = get_rendered_text(first_part, font_size, color, state);
 
 		if (!surf.null()) {
 			// [See remark#22]
@@ -502,7 +710,7 @@ void tintegrate::add_text_item(int tag_start, int start, const std::string& text
 				validate_str(start, src_text_size, text);
 			}
 
-			add_item(titem(surf, tag_start, start, curr_loc_.first, curr_loc_.second, first_part, ref_dst, font_size, state, src_text_size));
+			add_item(titem(surf, tag_start, start, curr_loc_.first, curr_loc_.second, first_part, ref_dst, font_size, state, color, src_text_size));
 			start += src_text_size;
 			if (editable_) {
 				start -= items_.back().src_end_is_lf(src_);
@@ -531,6 +739,31 @@ void tintegrate::add_text_item(int tag_start, int start, const std::string& text
 	}
 }
 
+surface tintegrate::get_rendered_text(const std::string& text, int font_size, const SDL_Color& color, int style)
+{
+	const std::string key_str = rendered_text_key(text, font_size, color, style);
+	if (previous_) {
+		relaid_surfaces_.insert(key_str);
+	}
+
+	tsurface_cache::const_iterator it = line_surfaces_.find(key_str);
+	if (it != line_surfaces_.end()) {
+		return it->second;
+	}
+
+	surface surf;
+	it = reuse_surfaces_.find(key_str);
+	if (it != reuse_surfaces_.end()) {
+		surf = it->second;
+	} else {
+		surf = font::get_rendered_text(text, font_size, color, style);
+	}
+	if (!surf.null()) {
+		line_surfaces_.insert(std::make_pair(key_str, surf));
+	}
+	return surf;
+}
+
 surface adaptive_scale_image(surface& surf, double max_ratio)
 {
 	if (max_ratio <= 1) {
@@ -645,13 +878,11 @@ void tintegrate::add_img_item(int start, const std::string& path, const std::str
 int tintegrate::get_y_for_floating_img(const int width, const int x, const int desired_y)
 {
 	int min_y = desired_y;
-	for (std::list<titem>::const_iterator it = items_.begin(); it != items_.end(); ++it) {
-		const titem& itm = *it;
-		if (itm.floating) {
-			if ((itm.rect.x + itm.rect.w > x && itm.rect.x < x + width)
-				|| (itm.rect.x > x && itm.rect.x < x + width)) {
-				min_y = std::max<int>(min_y, itm.rect.y + itm.rect.h);
-			}
+	for (std::vector<const titem*>::const_iterator it = floating_items_.begin(); it != floating_items_.end(); ++it) {
+		const titem& itm = **it;
+		if ((itm.rect.x + itm.rect.w > x && itm.rect.x < x + width)
+			|| (itm.rect.x > x && itm.rect.x < x + width)) {
+			min_y = std::max<int>(min_y, itm.rect.y + itm.rect.h);
 		}
 	}
 	return min_y;
@@ -660,12 +891,10 @@ int tintegrate::get_y_for_floating_img(const int width, const int x, const int d
 int tintegrate::get_min_x(const int y, const int height)
 {
 	int min_x = 0;
-	for (std::list<titem>::const_iterator it = items_.begin(); it != items_.end(); ++it) {
-		const titem& itm = *it;
-		if (itm.floating) {
-			if (itm.rect.y < y + height && itm.rect.y + itm.rect.h > y && itm.align == LEFT) {
-				min_x = std::max<int>(min_x, itm.rect.w + 5);
-			}
+	for (std::vector<const titem*>::const_iterator it = floating_items_.begin(); it != floating_items_.end(); ++it) {
+		const titem& itm = **it;
+		if (itm.rect.y < y + height && itm.rect.y + itm.rect.h > y && itm.align == LEFT) {
+			min_x = std::max<int>(min_x, itm.rect.w + 5);
 		}
 	}
 	return min_x;
@@ -675,15 +904,13 @@ int tintegrate::get_max_x(const int y, const int height)
 {
 	int text_width = maximum_width_;
 	int max_x = text_width;
-	for (std::list<titem>::const_iterator it = items_.begin(); it != items_.end(); ++it) {
-		const titem& itm = *it;
-		if (itm.floating) {
-			if (itm.rect.y < y + height && itm.rect.y + itm.rect.h > y) {
-				if (itm.align == RIGHT) {
-					max_x = std::min<int>(max_x, text_width - itm.rect.w - 5);
-				} else if (itm.align == MIDDLE) {
-					max_x = std::min<int>(max_x, text_width / 2 - itm.rect.w / 2 - 5);
-				}
+	for (std::vector<const titem*>::const_iterator it = floating_items_.begin(); it != floating_items_.end(); ++it) {
+		const titem& itm = **it;
+		if (itm.rect.y < y + height && itm.rect.y + itm.rect.h > y) {
+			if (itm.align == RIGHT) {
+				max_x = std::min<int>(max_x, text_width - itm.rect.w - 5);
+			} else if (itm.align == MIDDLE) {
+				max_x = std::min<int>(max_x, text_width / 2 - itm.rect.w / 2 - 5);
 			}
 		}
 	}
@@ -694,12 +921,16 @@ void tintegrate::add_item(const titem &itm)
 {
 	items_.push_back(itm);
 	if (!itm.floating) {
+		if (editable_ && last_row_.empty()) {
+			rows_.push_back(trow(itm.pos, curr_loc_.second, -- items_.end(), plain_text_));
+		}
 		curr_loc_.first += itm.rect.w;
 		curr_row_height_ = std::max<int>(itm.rect.h, curr_row_height_);
 		contents_height_ = std::max<int>(contents_height_, curr_loc_.second + curr_row_height_);
 		last_row_.push_back(&items_.back());
 	}
 	else {
+		floating_items_.push_back(&items_.back());
 		if (itm.align == LEFT) {
 			curr_loc_.first = itm.rect.w + 5;
 		}
@@ -1354,11 +1585,11 @@ int escape_count(const std::string& str)
 	return escapes;
 }
 
-std::string tintegrate::handle_selection(int startx, int starty, int endx, int endy, SDL_Rect* new_pt) const
+std::string tintegrate::handle_selection(int startx, int starty, int endx, int endy, int* new_src_pos) const
 {
 	std::string ret;
-	if (new_pt) {
-		*new_pt = create_rect(endx, endy, 0, 0);
+	if (new_src_pos) {
+		*new_src_pos = -1;
 	}
 
 	if (!editable_) {
@@ -1410,7 +1641,7 @@ std::string tintegrate::handle_selection(int startx, int starty, int endx, int e
 		end_tmp_pos += end_loc.it->src_size;
 	}
 
-	if (new_pt) {
+	if (new_src_pos) {
 		ret = substr_from_src(0, start_tmp_pos);
 		ret.append(substr_from_src(end_tmp_pos));
 
@@ -1419,8 +1650,7 @@ std::string tintegrate::handle_selection(int startx, int starty, int endx, int e
 		} else {
 			start_tmp_pos = start_loc.it->pos;
 		}
-		tintegrate integrate(ret, maximum_width_, maximum_height_, default_font_size_, default_font_color_, true);
-		*new_pt = integrate.calculate_cursor(start_tmp_pos);
+		*new_src_pos = start_tmp_pos;
 
 	} else {
 		const titem& start_item = *start_loc.it;
@@ -1455,17 +1685,18 @@ std::string tintegrate::handle_selection(int startx, int starty, int endx, int e
 			ret.append(start_item.text.substr(start_tmp_pos - start_item.pos, end_tmp_pos - start_tmp_pos));
 		}
 	}
-	if (new_pt && !new_pt->h) {
-		*new_pt = holden_rect(new_pt->x, new_pt->y);
-	}
 	return ret;
 }
 
-std::string tintegrate::handle_char(bool del, int x, int y, const bool backspace, SDL_Rect& new_pt) const
+std::string tintegrate::handle_char(bool del, int x, int y, const bool backspace, SDL_Rect& new_pt, int* new_src_pos) const
 {
 	std::string ret;
 
+	VALIDATE(!del || new_src_pos, null_str);
 	new_pt = create_rect(0, 0, 0, 0);
+	if (new_src_pos) {
+		*new_src_pos = -1;
+	}
 	if (!editable_ || items_.empty() || x < 0 || y < 0) {
 		return src_;
 	}
@@ -1561,8 +1792,7 @@ std::string tintegrate::handle_char(bool del, int x, int y, const bool backspace
 				src_tmp_pos = tmp_pos;
 			}
 
-			tintegrate integrate(ret, maximum_width_, maximum_height_, default_font_size_, default_font_color_, true);
-			new_pt = integrate.calculate_cursor(src_tmp_pos);
+			*new_src_pos = src_tmp_pos;
 
 		} else if (before_loc.it->text_type()) {
 			if (loc.it->rect.y >= before_loc.it->rect.y + before_loc.it->rect.h) {
@@ -1624,8 +1854,7 @@ std::string tintegrate::handle_char(bool del, int x, int y, const bool backspace
 			} else {
 				tmp_pos = loc.it->pos;
 			}
-			tintegrate integrate(ret, maximum_width_, maximum_height_, default_font_size_, default_font_color_, true);
-			new_pt = integrate.calculate_cursor(tmp_pos);
+			*new_src_pos = tmp_pos;
 
 		} else {
 			if (loc.it->text_type()) {
@@ -1721,8 +1950,7 @@ std::string tintegrate::handle_char(bool del, int x, int y, const bool backspace
 		} else {
 			tmp_pos = loc.it->pos;
 		}
-		tintegrate integrate(ret, maximum_width_, maximum_height_, default_font_size_, default_font_color_, true);
-		new_pt = integrate.calculate_cursor(tmp_pos);
+		*new_src_pos = tmp_pos;
 
 	} else if (!new_pt_cacluated) {
 		std::string::const_iterator it = loc.it->text.begin();
@@ -1801,19 +2029,18 @@ int tintegrate::calculate_src_pos(int x, int y) const
 	return src_pos;
 }
 
-std::string tintegrate::insert_str(bool text, int x, int y, const std::string& str, SDL_Rect& new_pt) const
+std::string tintegrate::insert_str(bool text, int x, int y, const std::string& str, int& new_src_pos) const
 {
 	std::string ret;
 
-	new_pt = create_rect(x, y, 0, 0);
+	new_src_pos = -1;
 	if (!editable_ || str.empty() || x < 0 || y < 0) {
 		return src_;
 	}
 
 	if (src_.empty()) {
-		tintegrate integrate(str, maximum_width_, maximum_height_, default_font_size_, default_font_color_, true);
 		// goto end
-		new_pt = integrate.editable_at2(str.size());
+		new_src_pos = str.size();
 		return str;
 	}
 	
@@ -1855,8 +2082,7 @@ std::string tintegrate::insert_str(bool text, int x, int y, const std::string& s
 			tmp_pos += loc.it->src_size;
 		}
 	}
-	tintegrate integrate(ret, maximum_width_, maximum_height_, default_font_size_, default_font_color_, true);
-	new_pt = integrate.calculate_cursor(tmp_pos);
+	new_src_pos = tmp_pos;
 
 	return ret;
 }
@@ -1907,4 +2133,6 @@ void tintegrate::clear()
 {
 	src_.clear();
 	items_.clear();
+	rows_.clear();
+	floating_items_.clear();
 }
@@ -22,6 +22,7 @@
 #include "gui/auxiliary/canvas.hpp"
 
 #include <list>
+#include <set>
 
 class config;
 class display;
@@ -46,7 +47,11 @@ public:
 	static std::string stuff_escape(const std::string& str);
 	static std::string drop_escape(const std::string& str);
 
-	tintegrate(const std::string& src, int maximum_width, int maximum_height, int default_font_size, const SDL_Color& default_font_color, bool editable = false);
+	// reuse: previous layout of the same control. rendered line surfaces of it will be
+	// taken over, so a re-layout only renders lines whose text/format changed.
+	// if both are editable, rows of it in front of and behind the edited rows are
+	// taken over too, only the edited rows are wrapped again. see relayout.
+	tintegrate(const std::string& src, int maximum_width, int maximum_height, int default_font_size, const SDL_Color& default_font_color, bool editable = false, tintegrate* reuse = NULL);
 	~tintegrate();
 
 	int get_src_text_size(int pos, const std::string& text) const;
@@ -65,9 +70,11 @@ public:
 	int calculate_src_pos(int x, int y) const;
 	bool at_end(int x, int y) const;
 	std::string before_str(int x, int y) const;
-	std::string handle_selection(int startx, int starty, int endx, int endy, SDL_Rect* new_pt) const;
-	std::string handle_char(bool del, int startx, int starty, const bool backspace, SDL_Rect& new_pt) const;
-	std::string insert_str(bool text, int x, int y, const std::string& str, SDL_Rect& new_pt) const;
+	// functions that return edited src set @new_src_pos to cursor's position in it.
+	// caller lays out edited src, and calls calculate_cursor(new_src_pos) on that.
+	std::string handle_selection(int startx, int starty, int endx, int endy, int* new_src_pos) const;
+	std::string handle_char(bool del, int startx, int starty, const bool backspace, SDL_Rect& new_pt, int* new_src_pos = NULL) const;
+	std::string insert_str(bool text, int x, int y, const std::string& str, int& new_src_pos) const;
 	SDL_Rect key_arrow(int x, int y, bool up) const;
 	
 	std::string substr_from_src(int from, int size = 1048576) const;
@@ -98,7 +105,7 @@ public:
 	struct titem {
 
 		titem(surface surface, int tag_pos, int pos, int x, int y, const std::string& text,
-			 const std::string& reference_to, int font_size, int style, int src_size,
+			 const std::string& reference_to, int font_size, int style, const SDL_Color& color, int src_size,
 			 bool floating=false, bool box = false, ALIGNMENT alignment = HERE);
 
 		titem(surface surface, int pos, int x, int y, int src_size, bool floating, bool box, ALIGNMENT);
@@ -137,6 +144,9 @@ public:
 		// If this item is text, state is text style
 		int style;
 
+		// If this item is text, color that it is rendered with.
+		SDL_Color color;
+
 		// text size in src that it crosspond to. 
 		int src_size;
 
@@ -189,6 +199,23 @@ private:
 	};
 	tloc_result location_from_pixel(int x, int y, bool fail_to_back) const;
 
+	/// A row of an editable layout.
+	struct trow {
+		trow(int pos, int y, std::list<titem>::iterator first, bool plain)
+			: pos(pos)
+			, y(y)
+			, first(first)
+			, plain(plain)
+		{}
+
+		// src position of first item.
+		int pos;
+		int y;
+		std::list<titem>::iterator first;
+		// row starts in plain text, layout can restart from it.
+		bool plain;
+	};
+
 	// Create appropriate items from configs. Items will be added to the
 	// internal vector. These methods check that the necessary
 	// attributes are specified.
@@ -242,6 +269,23 @@ private:
 	/// height.
 	void add_item(const titem& itm);
 
+	/// Return rendered surface of one line's text. Use surface of previous layout if possible.
+	surface get_rendered_text(const std::string& text, int font_size, const SDL_Color& color, int style);
+
+	/// Lay out parsed items of src in order, stop when rest is taken over from previous layout.
+	void layout_cfgs(const std::map<int, std::string>& parsed_items);
+
+	/// Lay out edited src from the row in front of the first edited row. Return false if
+	/// previous layout cannot be used, and nothing of it has been taken over.
+	bool relayout(tintegrate& previous);
+
+	/// At start of a row, check whether previous layout has a row at same src and
+	/// take over it and all rows behind it.
+	bool take_over_rest(int start);
+
+	/// Return index of first row whose src position isn't less than pos.
+	static size_t lower_row(const std::vector<trow>& rows, int pos);
+
 	void validate_str(int start, int size, const std::string& text) const;
 
 private:
@@ -249,6 +293,31 @@ private:
 	bool editable_;
 	std::list<titem> items_;
 	std::list<titem *> last_row_;
+	// rows of editable layout, in src order.
+	std::vector<trow> rows_;
+	// plain text, not markup, is being laid out.
+	bool plain_text_;
+	// floating items of items_. get_min_x/get_max_x only care them.
+	std::vector<const titem*> floating_items_;
+
+	// key: text + font_size + style + color
+	typedef std::map<std::string, surface> tsurface_cache;
+	// surfaces used by this layout.
+	tsurface_cache line_surfaces_;
+	// surfaces taken over from previous layout, valid only during construct.
+	tsurface_cache reuse_surfaces_;
+
+	// relayout state, valid only during construct.
+	tintegrate* previous_;
+	// in src, edit ends here. rows behind it may be same as previous layout's.
+	int change_end_;
+	// src size minus previous layout's src size.
+	int src_delta_;
+	// rest has been taken over from previous layout.
+	bool taken_over_;
+	// keys of surfaces that relaid rows use.
+	std::set<std::string> relaid_surfaces_;
+
 	const int title_spacing_;
 	// The current input location when creating items.
 	std::pair<int, int> curr_loc_;
@@ -120,6 +120,9 @@ language_list get_languages()
 static void wesnoth_setlocale(int category, std::string const &slocale,
 	std::vector<std::string> const *alternates)
 {
+	// background translating may be in gettext, locale mustn't change under it.
+	t_string::stop_translating();
+
 	std::string locale = slocale;
 	// FIXME: ideally we should check LANGUAGE and on first invocation
 	// use that value, so someone with es would get the game in Spanish
@@ -191,6 +194,7 @@ static void wesnoth_setlocale(int category, std::string const &slocale,
 
 bool set_language(const language_def& locale)
 {
+	const Uint32 start = SDL_GetTicks();
 	strings_.clear();
 
 	std::string locale_lc;
@@ -225,6 +229,10 @@ bool set_language(const language_def& locale)
 	}
 	// end of string_table fill
 
+	// translations that t_string cached are of previous language.
+	t_string::reset_translations();
+	LOG_G << "switch language to " << locale.localename << ": " << (SDL_GetTicks() - start) << " ms\n";
+
 	return true;
 }
 
@@ -134,6 +134,7 @@ void loadscreen::draw_screen(const std::string &text)
 		}
 		area.x = area.y = 0;
 		sdl_blit(scaled_logo_surface, 0, gdis, &area);
+		add_screen_damage_full();
 		screen_.flip();
 		return;
 	}
@@ -209,6 +210,7 @@ void loadscreen::draw_screen(const std::string &text)
 	}
 
 	// Update the rectangle.
+	add_screen_damage_full();
 	screen_.flip();
 */
 }
@@ -223,6 +225,7 @@ void loadscreen::clear_screen()
 	surface disp(screen_.getSurface());      // Screen surface.
 	// Make everything black.
 	sdl_fill_rect(disp,&area,SDL_MapRGB(disp->format,0,0,0));
+	add_screen_damage_full();
 	screen_.flip();
 */
 }
@@ -345,8 +348,8 @@ void loadscreen::dump_counters() const
 }
 
 
-set_increment_progress::fn_increment_progress set_increment_progress::increment_progress = NULL;
-void* set_increment_progress::ctx = NULL;
+thread_local set_increment_progress::fn_increment_progress set_increment_progress::increment_progress = NULL;
+thread_local void* set_increment_progress::ctx = NULL;
 
 set_increment_progress::set_increment_progress(fn_increment_progress fn, void* ctx) :
 	old_(increment_progress)
@@ -89,8 +89,9 @@ class set_increment_progress
 public:
 	typedef void (* fn_increment_progress)(std::string const &name, uint32_t param1, void* ctx);
 
-	static fn_increment_progress increment_progress;
-	static void* ctx;
+	// per thread, every thread preprocessing reports to its own callback.
+	static thread_local fn_increment_progress increment_progress;
+	static thread_local void* ctx;
 
 	set_increment_progress(fn_increment_progress fn, void* ctx);
 	~set_increment_progress();
@@ -101,7 +102,7 @@ private:
 void increment_preprocessor_progress(std::string const &name, bool is_file);
 
 void wml_config_to_file(const std::string &fname, const config &cfg, uint32_t nfiles = 0, uint32_t sum_size = 0, uint32_t modified = 0, const std::map<std::string, std::string>& app_domains = std::map<std::string, std::string>());
-void wml_config_from_file(const std::string &fname, config &cfg, uint32_t* nfiles = NULL, uint32_t* sum_size = NULL, uint32_t* modified = NULL);
+bool wml_config_from_file(const std::string &fname, config &cfg, uint32_t* nfiles = NULL, uint32_t* sum_size = NULL, uint32_t* modified = NULL);
 bool wml_checksum_from_file(const std::string &fname, uint32_t* nfiles = NULL, uint32_t* sum_size = NULL, uint32_t* modified = NULL);
 unsigned char calcuate_xor_from_file(const std::string &fname);
 
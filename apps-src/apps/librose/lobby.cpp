@@ -345,20 +345,33 @@ size_t tsock::queue_data(const config& buf, const std::string& packet_type)
 	return size;
 }
 
-std::map<std::string, int> tlobby_user::uids;
-int tlobby_user::get_uid(const std::string& nick2, bool must_exist)
+std::string irc_casefold(const char* name, size_t len)
 {
-	static int id = 1;
+	std::string result(name, len);
+	for (std::string::iterator it = result.begin(); it != result.end(); ++ it) {
+		*it = irc::rfc_tolowertab[(unsigned char)*it];
+	}
+	return result;
+}
 
-	std::string nick = nick2;
-	
+boost::unordered_map<std::string, int> tlobby_user::uids;
+std::vector<std::string> tlobby_user::uid_nicks;
+
+int tlobby_user::get_uid(const std::string& nick, bool must_exist)
+{
 	if (lobby->chat->serv()) {
 		char* nick_prefixes = lobby->chat->serv()->nick_prefixes;
 		if (strchr(nick_prefixes, nick[0])) {
 			VALIDATE(false, "nick has invalid prefix!");
 		}
 	}
-	std::map<std::string, int>::const_iterator it = uids.find(nick);
+	if (uid_nicks.empty()) {
+		// uid 0 is npos.
+		uid_nicks.push_back(null_str);
+	}
+
+	const std::string key = irc_casefold(nick);
+	boost::unordered_map<std::string, int>::const_iterator it = uids.find(key);
 	if (it != uids.end()) {
 		return it->second;
 	}
@@ -368,19 +381,31 @@ int tlobby_user::get_uid(const std::string& nick2, bool must_exist)
 		err << " nick isn't in lobby!";
 		VALIDATE(false, err.str());
 	}
-	uids.insert(std::make_pair(nick, id));
-	return id ++;
+	const int id = uid_nicks.size();
+	uids.insert(std::make_pair(key, id));
+	uid_nicks.push_back(nick);
+	return id;
 }
 
 const std::string& tlobby_user::get_nick(int uid)
 {
-	for (std::map<std::string, int>::const_iterator it = uids.begin(); it != uids.end(); ++ it) {
-		if (it->second == uid) {
-			return it->first;
-		}
+	VALIDATE(uid > 0 && uid < (int)uid_nicks.size(), "Cannot find uid!");
+	return uid_nicks[uid];
+}
+
+void tlobby_user::rename(int uid, const std::string& newnick)
+{
+	VALIDATE(uid > 0 && uid < (int)uid_nicks.size(), "Cannot find uid!");
+
+	std::string& nick = uid_nicks[uid];
+	boost::unordered_map<std::string, int>::iterator it = uids.find(irc_casefold(nick));
+	if (it != uids.end() && it->second == uid) {
+		uids.erase(it);
 	}
-	VALIDATE(false, "Cannot find uid!");
-	return null_str;
+	// a uid that went by newnick earlier keeps its logs, but the name now
+	// resolves to this one.
+	uids[irc_casefold(newnick)] = uid;
+	nick = newnick;
 }
 
 #define TLOBBY_USER_NPOS		0
@@ -390,7 +415,8 @@ const int tlobby_user::npos = TLOBBY_USER_NPOS;
 const int tlobby_channel::npos = TLOBBY_CHANNEL_NPOS;
 const int tlobby_channel::t_me = 1;
 const int tlobby_channel::t_friend = 2;
-std::map<std::string, int> tlobby_channel::cids;
+boost::unordered_map<std::string, int> tlobby_channel::cids;
+boost::unordered_map<int, std::string> tlobby_channel::cid_nicks;
 
 tlobby_user null_user(TLOBBY_USER_NPOS, "");
 tlobby_channel null_channel(TLOBBY_CHANNEL_NPOS, "", "");
@@ -400,8 +426,10 @@ int tlobby_channel::get_cid(const std::string& chan, bool must_exist)
 	static int id = min_allocatable;
 	if (cids.empty()) {
 		cids.insert(std::make_pair("friend", t_friend));
+		cid_nicks.insert(std::make_pair(t_friend, "friend"));
 	}
-	std::map<std::string, int>::const_iterator it = cids.find(chan);
+	const std::string key = irc_casefold(chan);
+	boost::unordered_map<std::string, int>::const_iterator it = cids.find(key);
 	if (it != cids.end()) {
 		return it->second;
 	}
@@ -411,19 +439,16 @@ int tlobby_channel::get_cid(const std::string& chan, bool must_exist)
 		err << " channel isn't in lobby!";
 		VALIDATE(false, err.str());
 	}
-	cids.insert(std::make_pair(chan, id));
+	cids.insert(std::make_pair(key, id));
+	cid_nicks.insert(std::make_pair(id, chan));
 	return id ++;
 }
 
 const std::string& tlobby_channel::get_nick(int cid)
 {
-	for (std::map<std::string, int>::const_iterator it = cids.begin(); it != cids.end(); ++ it) {
-		if (it->second == cid) {
-			return it->first;
-		}
-	}
-	VALIDATE(false, "Cannot find cid!");
-	return null_str;
+	boost::unordered_map<int, std::string>::const_iterator it = cid_nicks.find(cid);
+	VALIDATE(it != cid_nicks.end(), "Cannot find cid!");
+	return it->second;
 }
 
 tlobby_channel::~tlobby_channel()
@@ -447,39 +472,43 @@ std::string tlobby_channel::name() const
 
 tlobby_user& tlobby_channel::get_user(int uid) const
 {
-	for (std::vector<tlobby_user*>::const_iterator it = users.begin(); it != users.end(); ++ it) {
-		tlobby_user& user = **it;
-		if (user.uid == uid) {
-			return user;
-		}
+	boost::unordered_map<int, size_t>::const_iterator it = user_at.find(uid);
+	if (it == user_at.end()) {
+		return null_user;
 	}
-	return null_user;
+	return *users[it->second];
 }
 
 tlobby_user& tlobby_channel::insert_user(int uid, const std::string& nick)
 {
 	tlobby_user& user = lobby->chat->insert_user(uid, nick, cid);
+	user_at.insert(std::make_pair(uid, users.size()));
 	users.push_back(&user);
 	return user;
 }
 
 void tlobby_channel::erase_user(int uid)
 {
-	int current_id;
-	std::vector<tlobby_user*>::iterator it = users.begin();
-	for (; it != users.end(); ++ it) {
-		const tlobby_user& u = **it;
-		if (uid == npos || u.uid == uid) {
-			current_id = u.uid;
-			lobby->chat->erase_user(current_id, cid); // after it, u.uid became invalid!
-			if (current_id == uid) {
-				users.erase(it);
-				return;
-			}
+	if (uid == npos) {
+		for (std::vector<tlobby_user*>::const_iterator it = users.begin(); it != users.end(); ++ it) {
+			lobby->chat->erase_user((*it)->uid, cid);
 		}
+		users.clear();
+		user_at.clear();
+		return;
+	}
+
+	boost::unordered_map<int, size_t>::iterator it = user_at.find(uid);
+	VALIDATE(it != user_at.end(), "uid must be npos!");
+	const size_t at = it->second;
+	user_at.erase(it);
+	if (at != users.size() - 1) {
+		users[at] = users.back();
+		user_at[users[at]->uid] = at;
 	}
-	VALIDATE(uid == npos, "uid must be npos!");
-	users.clear();
+	users.pop_back();
+
+	lobby->chat->erase_user(uid, cid); // after it, user's uid became invalid!
 }
 
 namespace chat_logs {
@@ -1306,7 +1335,7 @@ tlobby_user& tlobby::tchat_sock::favor_user(int uid) const
 
 tlobby_user& tlobby::tchat_sock::get_user(int uid)
 {
-	std::map<int, tlobby_user>::iterator it = users_.find(uid);
+	boost::unordered_map<int, tlobby_user>::iterator it = users_.find(uid);
 	if (it == users_.end()) {
 		return null_user;
 	}
@@ -1316,7 +1345,7 @@ tlobby_user& tlobby::tchat_sock::get_user(int uid)
 
 tlobby_user& tlobby::tchat_sock::insert_user(int uid, const std::string& nick, int cid)
 {
-	std::map<int, tlobby_user>::iterator it = users_.find(uid);
+	boost::unordered_map<int, tlobby_user>::iterator it = users_.find(uid);
 	if (it == users_.end()) {
 		it = users_.insert(std::make_pair(uid, tlobby_user(uid, nick))).first;
 	}
@@ -1330,7 +1359,7 @@ tlobby_user& tlobby::tchat_sock::insert_user(int uid, const std::string& nick, i
 
 void tlobby::tchat_sock::erase_user(int uid, int cid)
 {
-	std::map<int, tlobby_user>::iterator it = users_.find(uid);
+	boost::unordered_map<int, tlobby_user>::iterator it = users_.find(uid);
 	VALIDATE(it != users_.end(), "lobby no this uid!");
 
 	tlobby_user& user = it->second;
@@ -1606,6 +1635,10 @@ void tlobby::tchat_sock::handle_command(const char* param[])
 		if (!process_quit_th(param[1])) {
 			return;
 		}
+	} else if (!strcasecmp(param[0], "NICK")) {
+		if (!process_nick(param[1], param[2])) {
+			return;
+		}
 	} else if (!strcasecmp(param[0], "PRIVMSG")) {
 		if (!process_message(param[1], param[2], param[3])) {
 			return;
@@ -1748,7 +1781,6 @@ bool tlobby::tchat_sock::process_message(const std::string& chan, const std::str
 
 bool tlobby::tchat_sock::process_userlist_th(const std::string& chan, const std::string& names)
 {
-	std::vector<std::string> users = utils::split(names, ' ');
 	tlobby_channel& channel = get_channel(tlobby_channel::get_cid(chan, false));
 	if (!channel.valid()) {
 		// I has been received channel: ##fix_your_connection
@@ -1761,16 +1793,38 @@ bool tlobby::tchat_sock::process_userlist_th(const std::string& chan, const std:
 		channel.users_receiving = true;
 	}
 
-	char* nick_prefixes = lobby->chat->serv()->nick_prefixes;
+	const char* nick_prefixes = lobby->chat->serv()->nick_prefixes;
+	const char* p = names.c_str();
+	const char* end = p + names.size();
+	channel.users.reserve(channel.users.size() + std::count(p, end, ' ') + 1);
+
 	std::string nopre_nick;
-	for (std::vector<std::string>::const_iterator it = users.begin(); it != users.end(); ++ it) {
-		nopre_nick = *it;
+	while (p < end) {
+		while (p < end && *p == ' ') {
+			p ++;
+		}
+		const char* p1 = p;
+		while (p1 < end && *p1 != ' ') {
+			p1 ++;
+		}
+		if (p1 == p) {
+			break;
+		}
 		// Ignore prefixes so '!' won't cause issues
-		if (strchr(nick_prefixes, nopre_nick[0])) {
-			nopre_nick = nopre_nick.substr(1);
+		if (strchr(nick_prefixes, *p)) {
+			p ++;
+		}
+		nopre_nick.assign(p, p1 - p);
+		p = p1;
+		if (nopre_nick.empty()) {
+			continue;
 		}
 
-		channel.insert_user(tlobby_user::get_uid(nopre_nick, false), nopre_nick);
+		const int uid = tlobby_user::get_uid(nopre_nick, false);
+		if (!channel.get_user(uid).valid()) {
+			// NAMES can be asked again before the previous reply ends.
+			channel.insert_user(uid, nopre_nick);
+		}
 	}
 	return true;
 }
@@ -1906,6 +1960,23 @@ bool tlobby::tchat_sock::process_quit_th(const std::string& nick)
 	return true;
 }
 
+bool tlobby::tchat_sock::process_nick(const std::string& nick, const std::string& newnick)
+{
+	const int uid = tlobby_user::get_uid(nick, false);
+	tlobby_user::rename(uid, newnick);
+
+	tlobby_user& user = get_user(uid);
+	if (!user.valid()) {
+		return false;
+	}
+	// uid, so every channel membership, stays the same.
+	user.nick = newnick;
+	if (&user == me) {
+		nick_ = newnick;
+	}
+	return true;
+}
+
 void tlobby::tchat_sock::process_quit_bh(const std::string& nick)
 {
 	tlobby_user& user = get_user(tlobby_user::get_uid(nick));
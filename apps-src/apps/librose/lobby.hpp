@@ -22,6 +22,8 @@
 #include <time.h>
 #include "ichat.hpp"
 
+#include <boost/unordered_map.hpp>
+
 namespace irc {
 struct ircnet;
 struct server;
@@ -131,13 +133,25 @@ protected:
 };
 extern tsock null_sock;
 
+/**
+ * Folds a nick or channel name by the IRC (rfc1459) casemapping, so that
+ * names differing only in case map to the same id.
+ */
+std::string irc_casefold(const char* name, size_t len);
+inline std::string irc_casefold(const std::string& name) { return irc_casefold(name.c_str(), name.size()); }
+
 class tlobby_user 
 {
 public:
 	static const int npos;
-	static std::map<std::string, int> uids;
+	/** Folded nick to uid. uids are handed out once and never reused. */
+	static boost::unordered_map<std::string, int> uids;
+	/** Nick of every uid, indexed by uid. */
+	static std::vector<std::string> uid_nicks;
 	static int get_uid(const std::string& nick, bool must_exist = true);
 	static const std::string& get_nick(int uid);
+	/** Moves uid to newnick, so memberships keyed by uid stay intact. */
+	static void rename(int uid, const std::string& newnick);
 
 	tlobby_user(int uid, const std::string& nick)
 		: uid(uid)
@@ -168,7 +182,9 @@ public:
 	static const int t_me;
 	static const int t_friend;
 	static const int min_allocatable = 100;
-	static std::map<std::string, int> cids;
+	/** Folded channel name to cid, and back. */
+	static boost::unordered_map<std::string, int> cids;
+	static boost::unordered_map<int, std::string> cid_nicks;
 	static int get_cid(const std::string& nick, bool must_exist = true);
 	static const std::string& get_nick(int cid);
 	static bool is_allocatable(int cid) { return cid >= min_allocatable; }
@@ -179,6 +195,7 @@ public:
 		, key(key)
 		, topic()
 		, users()
+		, user_at()
 		, users_receiving(false)
 		, who_reqeusting(0)
 		, err(false)
@@ -186,6 +203,7 @@ public:
 	~tlobby_channel();
 
 	tlobby_user& insert_user(int uid, const std::string& nick);
+	/** Erases uid from the channel, or all users when uid is npos. */
 	void erase_user(int uid);
 
 	tlobby_user& get_user(int uid) const;
@@ -199,6 +217,8 @@ public:
 	std::string key;
 	std::string topic;
 	std::vector<tlobby_user*> users;
+	/** Position of each uid in users, erase moves the last user into the hole. */
+	boost::unordered_map<int, size_t> user_at;
 	bool users_receiving;
 	Uint32 who_reqeusting;
 	bool err;
@@ -394,6 +414,7 @@ public:
 		bool process_whois(const std::string& chan, const std::string& nick, bool online, bool away);
 		bool process_quit_th(const std::string& nick);
 		void process_quit_bh(const std::string& nick);
+		bool process_nick(const std::string& nick, const std::string& newnick);
 		void process_forbid_join(const std::string& chan, const std::string& reason);
 
 	public:
@@ -401,7 +422,7 @@ public:
 		tlobby_user* me;
 
 	private:
-		std::map<int, tlobby_user> users_;
+		boost::unordered_map<int, tlobby_user> users_;
 		std::string nick_;
 		char* line_;
 		int line_size_;
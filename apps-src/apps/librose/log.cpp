@@ -24,12 +24,15 @@
 #include "SDL.h"
 
 #include "log.hpp"
+#include "thread.hpp"
 
 #include <boost/foreach.hpp>
 
+#include <algorithm>
 #include <map>
 #include <sstream>
 #include <ctime>
+#include <cstdio>
 
 namespace {
 
@@ -140,11 +143,406 @@ std::string get_timespan(const time_t& t) {
 	return buf;
 }
 
+namespace {
+
+enum {RECORD_PREFIX = 0x1, RECORD_NAMES = 0x2, RECORD_TIMESTAMP = 0x4};
+
+struct trecord_header
+{
+	Uint32 size;
+	Uint32 seq;
+	time_t time;
+	const char* logger;
+	const logd* domain;
+	int indent;
+	int flags;
+};
+
+/**
+ * Ring buffer of records, written by one logging thread and read by the
+ * writer thread. Neither side takes a lock.
+ */
+class tring
+{
+public:
+	explicit tring(size_t size)
+		: data_(NULL)
+		, mask_(1023)
+	{
+		while (mask_ + 1 < size) {
+			mask_ = (mask_ << 1) | 1;
+		}
+		data_ = (char*)malloc(mask_ + 1);
+		SDL_AtomicSet(&head_, 0);
+		SDL_AtomicSet(&tail_, 0);
+		SDL_AtomicSet(&closed_, 0);
+	}
+
+	~tring()
+	{
+		free(data_);
+	}
+
+	size_t max_text() const { return mask_ + 1 - sizeof(trecord_header); }
+
+	bool push(const trecord_header& header, const char* text)
+	{
+		const Uint32 need = sizeof(header) + header.size;
+		const Uint32 head = SDL_AtomicGet(&head_);
+		const Uint32 tail = SDL_AtomicGet(&tail_);
+		// SDL_AtomicGet/Set aren't acquire/release on every platform(gcc/ARM of SDL 2.0.5),
+		// barriers keep copy_in/copy_out on the right side of head_/tail_.
+		SDL_MemoryBarrierAcquire();
+		if (need > mask_ + 1 - (head - tail)) {
+			return false;
+		}
+		copy_in(head, &header, sizeof(header));
+		copy_in(head + sizeof(header), text, header.size);
+		SDL_MemoryBarrierRelease();
+		SDL_AtomicSet(&head_, head + need);
+		return true;
+	}
+
+	bool pop(trecord_header& header, std::string& text)
+	{
+		const Uint32 tail = SDL_AtomicGet(&tail_);
+		if (tail == (Uint32)SDL_AtomicGet(&head_)) {
+			return false;
+		}
+		SDL_MemoryBarrierAcquire();
+		copy_out(tail, &header, sizeof(header));
+		text.resize(header.size);
+		if (header.size) {
+			copy_out(tail + sizeof(header), &text[0], header.size);
+		}
+		SDL_MemoryBarrierRelease();
+		SDL_AtomicSet(&tail_, tail + sizeof(header) + header.size);
+		return true;
+	}
+
+	void close() { SDL_AtomicSet(&closed_, 1); }
+	bool closed() { return SDL_AtomicGet(&closed_) != 0; }
+
+private:
+	void copy_in(Uint32 at, const void* src, size_t size)
+	{
+		const size_t offset = at & mask_;
+		const size_t first = std::min(size, mask_ + 1 - offset);
+		memcpy(data_ + offset, src, first);
+		memcpy(data_, (const char*)src + first, size - first);
+	}
+
+	void copy_out(Uint32 at, void* dst, size_t size) const
+	{
+		const size_t offset = at & mask_;
+		const size_t first = std::min(size, mask_ + 1 - offset);
+		memcpy(dst, data_ + offset, first);
+		memcpy((char*)dst + first, data_, size - first);
+	}
+
+private:
+	char* data_;
+	size_t mask_;
+	SDL_atomic_t head_;
+	SDL_atomic_t tail_;
+	SDL_atomic_t closed_;
+};
+
+lg::tasync_options async_options;
+SDL_atomic_t async_active;
+SDL_atomic_t async_stopping;
+SDL_atomic_t async_seq;
+SDL_atomic_t async_dropped;
+threading::thread* async_writer = NULL;
+threading::mutex rings_mutex;
+std::vector<tring*> rings;
+threading::mutex wake_mutex;
+threading::condition wake_cond;
+
+/**
+ * The stream LOG_STREAM writes to when logging is asynchronous. Text is
+ * collected per thread and pushed to the ring at every '\n'.
+ */
+class tproducer: public std::streambuf
+{
+public:
+	explicit tproducer(tring* ring)
+		: ring_(ring)
+		, pending_()
+		, header_()
+		, stream_(this)
+	{
+		memset(&header_, 0, sizeof(header_));
+	}
+
+	~tproducer()
+	{
+		commit();
+		// the writer thread deletes the ring once it is drained.
+		ring_->close();
+	}
+
+	std::ostream& begin(const char* logger, const logd* domain, bool show_names, bool do_indent)
+	{
+		commit();
+		header_.time = time(NULL);
+		header_.logger = logger;
+		header_.domain = domain;
+		header_.indent = do_indent? indent: 0;
+		header_.flags = RECORD_PREFIX | (show_names? RECORD_NAMES: 0) | (timestamp? RECORD_TIMESTAMP: 0);
+		return stream_;
+	}
+
+	void commit()
+	{
+		if (pending_.empty()) {
+			return;
+		}
+		if (pending_.size() > ring_->max_text()) {
+			pending_.resize(ring_->max_text());
+		}
+		header_.size = pending_.size();
+		header_.seq = SDL_AtomicAdd(&async_seq, 1);
+		while (!ring_->push(header_, pending_.c_str())) {
+			if (async_options.overflow == lg::OVERFLOW_DROP || !SDL_AtomicGet(&async_active)) {
+				SDL_AtomicIncRef(&async_dropped);
+				break;
+			}
+			wake_cond.notify_one();
+			SDL_Delay(1);
+		}
+		pending_.clear();
+		// what follows is the rest of the line, without a prefix.
+		header_.flags = 0;
+		header_.indent = 0;
+	}
+
+private:
+	int overflow(int c)
+	{
+		if (c != traits_type::eof()) {
+			pending_.push_back((char)c);
+			if (c == '\n') {
+				commit();
+			}
+		}
+		return traits_type::not_eof(c);
+	}
+
+	std::streamsize xsputn(const char* s, std::streamsize n)
+	{
+		const char* end = s + n;
+		while (s < end) {
+			const char* eol = (const char*)memchr(s, '\n', end - s);
+			if (!eol) {
+				pending_.append(s, end - s);
+				break;
+			}
+			pending_.append(s, eol + 1 - s);
+			commit();
+			s = eol + 1;
+		}
+		return n;
+	}
+
+private:
+	tring* ring_;
+	std::string pending_;
+	trecord_header header_;
+	std::ostream stream_;
+};
+
+struct tproducer_holder
+{
+	~tproducer_holder()
+	{
+		delete producer;
+	}
+	tproducer* producer;
+};
+thread_local tproducer_holder producer_holder;
+
+tproducer& current_producer()
+{
+	tproducer*& producer = producer_holder.producer;
+	if (!producer) {
+		tring* ring = new tring(async_options.ring_size);
+		{
+			threading::lock lock(rings_mutex);
+			rings.push_back(ring);
+		}
+		producer = new tproducer(ring);
+	}
+	return *producer;
+}
+
+struct trecord
+{
+	trecord_header header;
+	std::string text;
+
+	bool operator<(const trecord& that) const
+	{
+		return (int)(header.seq - that.header.seq) < 0;
+	}
+};
+
+FILE* async_file = NULL;
+size_t async_file_size = 0;
+
+void rotate_async_file()
+{
+	const std::string& file = async_options.file;
+	if (async_file) {
+		fclose(async_file);
+		async_file = NULL;
+	}
+	if (async_options.rotate_files > 0) {
+		for (int n = async_options.rotate_files - 1; n > 0; n --) {
+			std::stringstream from, to;
+			from << file << "." << n;
+			to << file << "." << n + 1;
+			remove(to.str().c_str());
+			rename(from.str().c_str(), to.str().c_str());
+		}
+		const std::string to = file + ".1";
+		remove(to.c_str());
+		rename(file.c_str(), to.c_str());
+	}
+	async_file = fopen(file.c_str(), "w");
+	async_file_size = 0;
+}
+
+void write_async(const std::string& str)
+{
+	if (async_options.file.empty()) {
+		output() << str;
+		return;
+	}
+	if (!async_file) {
+		return;
+	}
+	fwrite(str.c_str(), 1, str.size(), async_file);
+	async_file_size += str.size();
+	if (async_options.rotate_size && async_file_size >= async_options.rotate_size) {
+		rotate_async_file();
+	}
+}
+
+int async_writer_main(void*)
+{
+	std::vector<trecord> batch;
+	std::string line;
+	while (true) {
+		const bool stopping = SDL_AtomicGet(&async_stopping) != 0;
+		{
+			threading::lock lock(rings_mutex);
+			for (std::vector<tring*>::iterator it = rings.begin(); it != rings.end(); ) {
+				tring* ring = *it;
+				// test before draining, records pushed before closing are not lost.
+				const bool closed = ring->closed();
+				batch.push_back(trecord());
+				while (ring->pop(batch.back().header, batch.back().text)) {
+					batch.push_back(trecord());
+				}
+				batch.pop_back();
+				if (closed) {
+					delete ring;
+					it = rings.erase(it);
+				} else {
+					++ it;
+				}
+			}
+		}
+
+		// rings are drained one by one, seq restores the order of the calls.
+		std::sort(batch.begin(), batch.end());
+		for (std::vector<trecord>::const_iterator it = batch.begin(); it != batch.end(); ++ it) {
+			const trecord_header& header = it->header;
+			line.clear();
+			if (header.flags & RECORD_PREFIX) {
+				for (int i = 0; i != header.indent; ++i) {
+					line += "  ";
+				}
+				if (header.flags & RECORD_TIMESTAMP) {
+					line += get_timestamp(header.time);
+				}
+				if (header.flags & RECORD_NAMES) {
+					line = line + header.logger + ' ' + header.domain->first + ": ";
+				}
+			}
+			line += it->text;
+			write_async(line);
+		}
+		const int dropped = SDL_AtomicSet(&async_dropped, 0);
+		if (dropped) {
+			std::stringstream ss;
+			ss << get_timestamp(time(NULL)) << "warning general: " << dropped << " log records dropped\n";
+			write_async(ss.str());
+		}
+		if (!batch.empty() || dropped) {
+			if (async_file) {
+				fflush(async_file);
+			} else {
+				output().flush();
+			}
+		}
+
+		if (stopping) {
+			break;
+		}
+		if (batch.empty()) {
+			threading::lock lock(wake_mutex);
+			wake_cond.wait_timeout(wake_mutex, 50);
+		}
+		batch.clear();
+	}
+	return 0;
+}
+
+}
+
+void start_async(const tasync_options& options)
+{
+	if (async_writer) {
+		return;
+	}
+	async_options = options;
+	if (!async_options.file.empty()) {
+		async_file = fopen(async_options.file.c_str(), "a");
+		async_file_size = async_file? ftell(async_file): 0;
+	}
+	SDL_AtomicSet(&async_stopping, 0);
+	async_writer = new threading::thread(async_writer_main);
+	SDL_AtomicSet(&async_active, 1);
+}
+
+void stop_async()
+{
+	if (!async_writer) {
+		return;
+	}
+	SDL_AtomicSet(&async_active, 0);
+	SDL_AtomicSet(&async_stopping, 1);
+	wake_cond.notify_one();
+	async_writer->join();
+	delete async_writer;
+	async_writer = NULL;
+
+	if (async_file) {
+		fclose(async_file);
+		async_file = NULL;
+	}
+}
+
 std::ostream &logger::operator()(log_domain const &domain, bool show_names, bool do_indent) const
 {
 	if (severity_ > domain.domain_->second)
 		return null_ostream;
-	else {
+	else if (SDL_AtomicGet(&async_active)) {
+		return current_producer().begin(name_, domain.domain_, show_names, do_indent);
+
+	} else {
 		std::ostream& stream = output();
 		if(do_indent) {
 			for(int i = 0; i != indent; ++i)
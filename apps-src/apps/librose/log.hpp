@@ -92,6 +92,45 @@ public:
 };
 
 void timestamps(bool);
+
+enum tlog_overflow {
+	/** Drop the record, the writer reports how many were dropped. */
+	OVERFLOW_DROP,
+	/** Wait until the writer thread made room. */
+	OVERFLOW_BLOCK
+};
+
+struct tasync_options
+{
+	tasync_options()
+		: file()
+		, rotate_size(4 * 1024 * 1024)
+		, rotate_files(3)
+		, ring_size(64 * 1024)
+		, overflow(OVERFLOW_DROP)
+	{}
+
+	/** Log file, empty writes to the current output stream. */
+	std::string file;
+	/** When file exceeds this size it is renamed to file.1, file.1 to file.2 etc. */
+	size_t rotate_size;
+	int rotate_files;
+	/** Bytes of the ring buffer every logging thread gets. */
+	size_t ring_size;
+	tlog_overflow overflow;
+};
+
+/**
+ * Moves the output of the loggers to a writer thread.
+ *
+ * The calling thread only copies the text into its own ring buffer, the
+ * prefix (timestamp, level and domain) is formatted by the writer thread.
+ * LOG_STREAM is used as before, a record ends at every '\n'.
+ */
+void start_async(const tasync_options& options);
+
+/** Writes all pending records and returns to synchronous logging. */
+void stop_async();
 std::string get_timestamp(const time_t& t, const std::string& format="%Y%m%d %H:%M:%S ");
 std::string get_timespan(const time_t& t);
 
@@ -222,7 +222,11 @@ void gamemap::read(const std::string& data)
 	const std::string& map = std::string(data, header_offset + 2);
 
 	try {
-		tiles_ = t_translation::read_game_map(map, starting_positions);
+		if (t_translation::is_game_map_bin(map)) {
+			tiles_ = t_translation::read_game_map_bin(map, starting_positions);
+		} else {
+			tiles_ = t_translation::read_game_map(map, starting_positions);
+		}
 
 	} catch(t_translation::error& e) {
 		// We re-throw the error but as map error.
@@ -282,7 +286,7 @@ void gamemap::read(const std::string& data)
 	}
 }
 
-std::string gamemap::write() const
+std::map<int, t_translation::coordinate> gamemap::starting_positions() const
 {
 	// Convert the starting positions to a map
 	std::map<int, t_translation::coordinate> starting_positions;
@@ -292,15 +296,54 @@ std::string gamemap::write() const
 		t_translation::coordinate position(startingPositions_[i].x + border_size_, startingPositions_[i].y + border_size_);
 		starting_positions[i] = position;
 	}
+	return starting_positions;
+}
 
+std::string gamemap::write() const
+{
 	// Let the low level convertor do the conversion
 	std::ostringstream s;
 	s << "border_size=" << border_size_ << "\nusage="
 		<< (usage_ == IS_MAP ? "map" : "mask") << "\n\n"
-		<< t_translation::write_game_map(tiles_, starting_positions);
+		<< t_translation::write_game_map(tiles_, starting_positions());
 	return s.str();
 }
 
+std::string gamemap::write_bin() const
+{
+	// The header stays text, so read() handles both forms the same way.
+	std::ostringstream s;
+	s << "border_size=" << border_size_ << "\nusage="
+		<< (usage_ == IS_MAP ? "map" : "mask") << "\n\n";
+	return s.str() + t_translation::write_game_map_bin(tiles_, starting_positions());
+}
+
+std::string gamemap::bin_data(const std::string& data)
+{
+	size_t header_offset = data.find("\n\n");
+	if (header_offset == std::string::npos) {
+		header_offset = data.find("\r\n\r\n");
+	}
+	const size_t comma_offset = data.find(",");
+	if (header_offset == std::string::npos || comma_offset < header_offset) {
+		// read() doesn't accept it either, leave it to it.
+		return data;
+	}
+	const std::string map(data, header_offset + 2);
+	if (t_translation::is_game_map_bin(map)) {
+		return data;
+	}
+
+	std::map<int, t_translation::coordinate> starting_positions;
+	t_translation::t_map tiles;
+	try {
+		tiles = t_translation::read_game_map(map, starting_positions);
+	} catch(t_translation::error& e) {
+		throw incorrect_map_format_error(e.message);
+	}
+	return std::string(data, 0, header_offset + 2) + t_translation::write_game_map_bin(tiles, starting_positions);
+}
+
 void gamemap::overlay(const gamemap& m, const config& rules_cfg, int xpos, int ypos, bool border)
 {
 	const config::const_child_itors &rules = rules_cfg.child_range("rule");
@@ -674,7 +717,13 @@ void form_map_str_rectangle(const std::string& data, std::vector<std::vector<std
 	if (usage != "map" || border_size != 1) {
 		return;
 	}
-	const std::string& map = std::string(data, header_offset + 2);
+	std::string map = std::string(data, header_offset + 2);
+	if (t_translation::is_game_map_bin(map)) {
+		// cells are compared as text.
+		std::map<int, t_translation::coordinate> starting_positions;
+		const t_translation::t_map tiles = t_translation::read_game_map_bin(map, starting_positions);
+		map = t_translation::write_game_map(tiles, starting_positions);
+	}
 	const std::string& str = map;
 
 	size_t offset = 0;
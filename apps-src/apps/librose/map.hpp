@@ -121,6 +121,18 @@ public:
 
 	std::string write() const;
 
+	/**
+	 * Same as write() but the tiles use the compact binary form of
+	 * t_translation::write_game_map_bin(), read() accepts both forms.
+	 */
+	std::string write_bin() const;
+
+	/**
+	 * Convert map data in text form to the form write_bin() writes, without
+	 * checking terrains. Studio uses it to embed map_data in scenario bins.
+	 */
+	static std::string bin_data(const std::string& data);
+
 	/** Overlays another map onto this one at the given position. */
 	void overlay(const gamemap& m, const config& rules, int x=0, int y=0, bool border=false);
 
@@ -265,6 +277,9 @@ private:
 	int num_starting_positions() const
 		{ return sizeof(startingPositions_)/sizeof(*startingPositions_); }
 
+	/** The starting positions in the form the t_translation writers take. */
+	std::map<int, t_translation::coordinate> starting_positions() const;
+
 	/** Allows lookup of terrain at a particular location. */
 	const t_translation::t_list operator[](int index) const
 		{ return tiles_[index + border_size_]; }
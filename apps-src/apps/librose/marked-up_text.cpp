@@ -94,16 +94,16 @@ bool is_cjk_char(const wchar_t c)
 		(ch >= 0xff00 && ch < 0xffef);
 }
 
-static void cut_word(std::string& line, std::string& word, int font_size, int style, int max_width)
+// line_measurer is measurer of line, width of line + word is measured from it.
+static void cut_word(std::string& line, const tline_measurer& line_measurer, std::string& word, int max_width)
 {
-	std::string tmp = line;
+	tline_measurer tmp = line_measurer;
 	utils::utf8_iterator tc(word);
 	bool first = true;
 
 	for(;tc != utils::utf8_iterator::end(word); ++tc) {
-		tmp.append(tc.substr().first, tc.substr().second);
-		SDL_Rect tsize = line_size(tmp, font_size, style);
-		if(tsize.w > max_width) {
+		tmp.push(*tc);
+		if(tmp.width() > max_width) {
 			const std::string& w = word;
 			if(line.empty() && first) {
 				line += std::string(w.begin(), tc.substr().second);
@@ -228,6 +228,13 @@ std::string word_wrap_text(const std::string& unwrapped_text, int font_sz,
 	int style = TTF_STYLE_NORMAL;
 	utils::utf8_iterator end = utils::utf8_iterator::end(unwrapped_text);
 
+	// width of word and line are accumulated char by char from glyph metrics.
+	tline_measurer word_measurer(font_sz, style);
+	tline_measurer line_measurer(font_sz, style);
+	size_t word_width = 0;
+	word_measurer.push(' ');
+	const size_t space_width = word_measurer.width();
+
 	while (1) {
 		if (start_of_line) {
 			line_width = 0;
@@ -241,10 +248,12 @@ std::string word_wrap_text(const std::string& unwrapped_text, int font_sz,
 			current_word_result_cut = false;
 			if (*ch == ' ' || *ch == '\n') {
 				current_word = *ch;
+				word_width = space_width;
 				++ ch;
 			} else {
 				wchar_t previous = 0;
 				int chars = 0;
+				word_measurer.clear();
 				for (; ch != utils::utf8_iterator::end(unwrapped_text) && *ch != ' ' && *ch != '\n'; ++ch) {
 
 					if (!current_word.empty() && break_before(*ch) && !no_break_after(previous)) {
@@ -256,12 +265,13 @@ std::string word_wrap_text(const std::string& unwrapped_text, int font_sz,
 					}
 
 					current_word.append(ch.substr().first, ch.substr().second);
+					word_measurer.push(*ch);
 
 					previous = *ch;
 
 					chars ++;
 					if (chars > attention_min_chars) {
-						if (line_size(current_word, font_sz, style).w + (int)line_width > max_width) {
+						if (word_measurer.width() + (int)line_width > max_width) {
 							size_t last_char_size = ch.substr().second - ch.substr().first;
 							current_word.erase(current_word.size() - last_char_size);
 
@@ -272,6 +282,7 @@ std::string word_wrap_text(const std::string& unwrapped_text, int font_sz,
 							break;
 						}
 					}
+					word_width = word_measurer.width();
 				}
 			}
 		}
@@ -282,13 +293,15 @@ std::string word_wrap_text(const std::string& unwrapped_text, int font_sz,
 			start_of_line = true;
 		} else {
 
-			const size_t word_width = line_size(current_word, font_sz, style).w;
-
 			line_width += word_width;
 
 			if (static_cast<long>(line_width) > max_width) {
 				if (!partial_line && static_cast<long>(word_width) > max_width) {
-					cut_word(current_line, current_word, font_sz, style, max_width);
+					cut_word(current_line, line_measurer, current_word, max_width);
+					// rest of word will start next line.
+					word_measurer.clear();
+					word_measurer.push(current_word);
+					word_width = word_measurer.width();
 				}
 				if (current_word == " ") {
 					current_word = "";
@@ -297,6 +310,7 @@ std::string word_wrap_text(const std::string& unwrapped_text, int font_sz,
 
 			} else {
 				current_line += current_word;
+				line_measurer.push(current_word);
 				current_word = "";
 
 			}
@@ -315,6 +329,7 @@ std::string word_wrap_text(const std::string& unwrapped_text, int font_sz,
 
 			wrapped_text += current_line;
 			current_line.clear();
+			line_measurer.clear();
 			line_width = 0;
 			current_height += size.h;
 			line_break = false;
@@ -33,6 +33,8 @@
 #include "serialization/parser.hpp"
 #include "serialization/preprocessor.hpp"
 #include "display.hpp"
+#include "events.hpp"
+#include "thread.hpp"
 #include "gettext.hpp"
 #include "hero.hpp"
 #include "lobby.hpp"
@@ -53,6 +55,157 @@ bool fps = false;
 int draw_delay_ = 20;
 
 config prefs;
+
+/**
+ * Coalesces write_preferences().
+ *
+ * A request only marks prefs dirty. Once no request came for DEBOUNCE
+ * ticks, prefs is serialized on the main thread, where it is safe to
+ * read, and the text is written atomically by a worker thread.
+ */
+class twrite_behind: public events::pump_monitor
+{
+public:
+	enum {DEBOUNCE = 500};
+
+	twrite_behind()
+		: dirty_(false)
+		, last_request_(0)
+		, last_written_()
+		, mutex_()
+		, cond_()
+		, file_mutex_()
+		, pending_()
+		, has_pending_(false)
+		, quit_(false)
+		, thread_(NULL)
+	{
+		thread_.reset(new threading::thread(worker_main, this));
+	}
+
+	~twrite_behind()
+	{
+		flush();
+	}
+
+	void request()
+	{
+		dirty_ = true;
+		last_request_ = SDL_GetTicks();
+	}
+
+	void monitor_process()
+	{
+		if (dirty_ && SDL_GetTicks() - last_request_ >= DEBOUNCE) {
+			post();
+		}
+	}
+
+	/**
+	 * Writes what is pending on calling thread and keeps the worker thread.
+	 * Mobile os can kill a background app without running destructors.
+	 */
+	void sync()
+	{
+		if (!thread_) {
+			return;
+		}
+		if (dirty_) {
+			post();
+		}
+		threading::lock file_lock(file_mutex_);
+		write_pending();
+	}
+
+	/** Writes what is pending and stops the worker thread. */
+	void flush()
+	{
+		if (!thread_) {
+			return;
+		}
+		if (dirty_) {
+			post();
+		}
+		{
+			threading::lock lock(mutex_);
+			quit_ = true;
+		}
+		cond_.notify_one();
+		thread_->join();
+		thread_.reset();
+	}
+
+private:
+	void post()
+	{
+		dirty_ = false;
+
+		std::stringstream out;
+		write(out, prefs);
+		std::string str = out.str();
+		if (str == last_written_) {
+			return;
+		}
+		last_written_ = str;
+
+		threading::lock lock(mutex_);
+		pending_.swap(str);
+		has_pending_ = true;
+		cond_.notify_one();
+	}
+
+	// must be called with file_mutex_ locked, so text taken earlier is never written later.
+	void write_pending()
+	{
+		std::string str;
+		{
+			threading::lock lock(mutex_);
+			if (!has_pending_) {
+				return;
+			}
+			str.swap(pending_);
+			has_pending_ = false;
+		}
+		const std::string file = get_prefs_file();
+		if (!write_file_atomic(file, str.c_str(), str.size())) {
+			ERR_FS << "error writing to preferences file '" << file << "'\n";
+		}
+	}
+
+	static int worker_main(void* param)
+	{
+		twrite_behind& writer = *reinterpret_cast<twrite_behind*>(param);
+		while (true) {
+			{
+				threading::lock lock(writer.mutex_);
+				while (!writer.has_pending_ && !writer.quit_) {
+					writer.cond_.wait(writer.mutex_);
+				}
+				if (!writer.has_pending_) {
+					break;
+				}
+			}
+			threading::lock file_lock(writer.file_mutex_);
+			writer.write_pending();
+		}
+		return 0;
+	}
+
+private:
+	bool dirty_;
+	Uint32 last_request_;
+	std::string last_written_;
+
+	threading::mutex mutex_;
+	threading::condition cond_;
+	threading::mutex file_mutex_;
+	std::string pending_;
+	bool has_pending_;
+	bool quit_;
+	boost::scoped_ptr<threading::thread> thread_;
+};
+
+twrite_behind* write_behind = NULL;
 }
 
 namespace preferences {
@@ -65,6 +218,8 @@ base_manager::base_manager()
 	scoped_istream stream = preprocess_file(get_prefs_file());
 	read(prefs, *stream);
 
+	write_behind = new twrite_behind;
+
 	if (member().empty()) {
 		std::stringstream strstr;
 		std::map<int, int> member;
@@ -89,22 +244,35 @@ base_manager::base_manager()
 
 base_manager::~base_manager()
 {
-	if (no_preferences_save) return;
+	if (!no_preferences_save) {
+		// Set the 'hidden' preferences.
+		prefs["scroll_threshold"] = mouse_scroll_threshold();
 
-	// Set the 'hidden' preferences.
-	prefs["scroll_threshold"] = mouse_scroll_threshold();
+		write_preferences();
+	}
 
-	write_preferences();
+	// flush it before the process exits.
+	delete write_behind;
+	write_behind = NULL;
+}
+
+void flush_preferences()
+{
+	if (write_behind) {
+		write_behind->sync();
+	}
 }
 
 void write_preferences()
 {
-	try {
-		std::stringstream out;
-		write(out, prefs);
-		write_file(get_prefs_file(), out.str().c_str(), out.str().size());
+	if (write_behind) {
+		write_behind->request();
+		return;
+	}
 
-	} catch(io_exception&) {
+	std::stringstream out;
+	write(out, prefs);
+	if (!write_file_atomic(get_prefs_file(), out.str().c_str(), out.str().size())) {
 		ERR_FS << "error writing to preferences file '" << get_prefs_file() << "'\n";
 	}
 }
@@ -40,6 +40,8 @@ namespace preferences {
 	};
 
 	void write_preferences();
+	// writes preferences requested by write_preferences now.
+	void flush_preferences();
 
 	void set(const std::string& key, const std::string &value);
 	void set(const std::string& key, char const *value);
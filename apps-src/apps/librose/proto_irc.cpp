@@ -2360,6 +2360,11 @@ void inbound_newnick(server *serv, char *nick, char *newnick, int quiet, const m
 		safe_strcpy(serv->nick, newnick, NICKLEN);
 	}
 
+	if (!quiet) {
+		fill_params_5(*serv, "NICK", nick, newnick, "\0", "\0");
+		serv->sock->handle_command(serv->params);
+	}
+
 	for (std::list<session*>::const_iterator it = serv->sess_list.begin(); it != serv->sess_list.end(); ++ it) {
 		session* sess = *it;
 		if (sess->server == serv) {
@@ -676,5 +676,8 @@ struct ignore {
 	unsigned int type;	/* one of more of IG_* ORed together */
 };
 
+/* rfc1459 casemapping, the one p_cmp compares by */
+extern const unsigned char rfc_tolowertab[];
+
 }
 #endif
@@ -24,6 +24,7 @@
 #include "config.hpp"
 #include "filesystem.hpp"
 #include "log.hpp"
+#include "thread.hpp"
 #include "loadscreen.hpp"
 #include "serialization/binary_or_text.hpp"
 #include "serialization/string_utils.hpp"
@@ -50,6 +51,8 @@ using std::streambuf;
 // map associating each filename encountered to a number
 typedef std::map<std::string, int> t_file_number_map;
 static t_file_number_map file_number_map;
+// preprocessor may run in more than one thread at the same time.
+static threading::mutex file_number_mutex;
 
 static bool encode_filename = true;
 
@@ -63,6 +66,7 @@ static std::string get_filename(const std::string& file_code){
 	int n = 0;
 	s >> std::hex >> n;
 
+	threading::lock lock(file_number_mutex);
 	BOOST_FOREACH (const t_file_number_map::value_type& p, file_number_map){
 		if(p.second == n)
 			return p.first;
@@ -78,6 +82,7 @@ static std::string get_file_code(const std::string& filename){
 	// current number of encountered filenames
 	static int current_file_number = 0;
 
+	threading::lock lock(file_number_mutex);
 	int& fnum = file_number_map[utils::escape(filename, " \\")];
 	if(fnum == 0)
 		fnum = ++current_file_number;
@@ -219,6 +224,8 @@ class preprocessor_streambuf: public streambuf
 	preprocessor *current_;       /**< Input preprocessor. */
 	preproc_map *defines_;
 	preproc_map default_defines_;
+	/** If not NULL, records every file and directory opened. */
+	std::vector<std::string> *depends_;
 	std::string textdomain_;
 	std::string location_;
 	int linenum_;
@@ -234,17 +241,18 @@ class preprocessor_streambuf: public streambuf
 	friend struct preprocessor_deleter;
 	preprocessor_streambuf(preprocessor_streambuf const &);
 public:
-	preprocessor_streambuf(preproc_map *);
+	preprocessor_streambuf(preproc_map *, std::vector<std::string> *depends = NULL);
 	void error(const std::string &, int);
 };
 
-preprocessor_streambuf::preprocessor_streambuf(preproc_map *def) :
+preprocessor_streambuf::preprocessor_streambuf(preproc_map *def, std::vector<std::string> *depends) :
 	streambuf(),
 	out_buffer_(""),
 	buffer_(),
 	current_(NULL),
 	defines_(def),
 	default_defines_(),
+	depends_(depends),
 	textdomain_("rose-lib"),
 	location_(""),
 	linenum_(0),
@@ -260,6 +268,7 @@ preprocessor_streambuf::preprocessor_streambuf(preprocessor_streambuf const &t)
 	current_(NULL),
 	defines_(t.defines_),
 	default_defines_(),
+	depends_(t.depends_),
 	textdomain_("rose-lib"),
 	location_(""),
 	linenum_(0),
@@ -517,6 +526,9 @@ preprocessor_file::preprocessor_file(preprocessor_streambuf &t, std::string cons
 	pos_(),
 	end_()
 {
+	if (t.depends_) {
+		t.depends_->push_back(name);
+	}
 	if (is_directory(name)) {
 		increment_preprocessor_progress(name, false);
 		get_files_in_dir(name, &files_, NULL, ENTIRE_FILE_PATH, SKIP_MEDIA_DIR, DO_REORDER);
@@ -1124,7 +1136,7 @@ preprocessor_deleter::~preprocessor_deleter()
 }
 
 
-std::istream *preprocess_file(std::string const &fname, preproc_map *defines)
+std::istream *preprocess_file(std::string const &fname, preproc_map *defines, std::vector<std::string> *depends)
 {
 	preproc_map *owned_defines = NULL;
 	if (!defines) {
@@ -1135,7 +1147,7 @@ std::istream *preprocess_file(std::string const &fname, preproc_map *defines)
 		owned_defines = new preproc_map;
 		defines = owned_defines;
 	}
-	preprocessor_streambuf *buf = new preprocessor_streambuf(defines);
+	preprocessor_streambuf *buf = new preprocessor_streambuf(defines, depends);
 	new preprocessor_file(*buf, fname);
 	return new preprocessor_deleter(buf, owned_defines);
 }
\ No newline at end of file
@@ -69,9 +69,11 @@ std::ostream& operator<<(std::ostream& stream, const preproc_map::value_type& de
  * Function to use the WML preprocessor on a file.
  *
  * @param defines                 A map of symbols defined.
+ * @param depends                 If not NULL, receives every file and directory
+ *                                read while the stream is consumed.
  *
  * @returns                       The resulting preprocessed file data.
  */
-std::istream *preprocess_file(std::string const &fname, preproc_map *defines = NULL);
+std::istream *preprocess_file(std::string const &fname, preproc_map *defines = NULL, std::vector<std::string> *depends = NULL);
 
 #endif
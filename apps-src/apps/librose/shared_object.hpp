@@ -17,6 +17,7 @@
 
 #include <climits>
 #include <cassert>
+#include "SDL_atomic.h"
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/hashed_index.hpp>
 #include <boost/multi_index/member.hpp>
@@ -48,6 +49,7 @@ public:
 
 	shared_object(const shared_object& o) : val_(o.val_) {
 		assert(valid());
+		tlock lock;
 		val_->count++;
 	}
 
@@ -76,7 +78,9 @@ public:
 		if (valid() && o == get()) return;
 		clear();
 
-		val_ = &*index().insert(node(o)).first;
+		const node tmp(o);
+		tlock lock;
+		val_ = &*index().insert(tmp).first;
 		val_->count++;
 
 		assert((val_->count) < (node::max_count));
@@ -111,6 +115,14 @@ protected:
 	static hash_map& map() { static hash_map* map = new hash_map; return *map; }
 	static hash_index& index() { return map().template get<0>(); }
 
+	// studio builds bins on more than one thread, map() and count are shared by
+	// all of them. lock is held only for a lookup or counter, so spin.
+	static SDL_SpinLock& spin_lock() { static SDL_SpinLock lock = 0; return lock; }
+	struct tlock {
+		tlock() { SDL_AtomicLock(&spin_lock()); }
+		~tlock() { SDL_AtomicUnlock(&spin_lock()); }
+	};
+
 	const node* val_;
 
 	bool valid() const {
@@ -119,6 +131,7 @@ protected:
 
 	void clear() {
 		if (!valid()) return;
+		tlock lock;
 		val_->count--;
 
 		if (val_->count == 0) index().erase(index().find(val_->val));
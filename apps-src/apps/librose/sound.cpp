@@ -24,11 +24,14 @@
 #include "sound_music_track.hpp"
 #include "util.hpp"
 #include "wml_exception.hpp"
+#include "thread.hpp"
 
 #include "SDL_mixer.h"
 
 #include <boost/foreach.hpp>
+#include <boost/unordered_map.hpp>
 #include <list>
+#include <deque>
 
 static lg::log_domain log_audio("audio");
 #define LOG_AUDIO LOG_STREAM(info, log_audio)
@@ -75,6 +78,16 @@ const size_t n_reserved_channels = UI_sound_channel + 1; // sources, bell, timer
 // Keep this above number of available channels to avoid busy-looping
 unsigned max_cached_chunks = 256;
 
+// Max bytes of decoded samples that we want to cache
+size_t max_cached_bytes = 32 * 1024 * 1024;
+size_t cached_bytes = 0;
+
+sound::tlate_play_policy late_play_policy = sound::LATE_PLAY_QUEUE;
+// play request that waits decoding longer than it will be dropped.
+Uint32 max_late_play_ticks = 200;
+
+sound::tcache_stats cache_stats;
+
 std::map< Mix_Chunk*, int > chunk_usage;
 
 }
@@ -139,8 +152,49 @@ private:
 	Mix_Chunk* data_;
 };
 
+// most recently used chunk is at front.
 std::list< sound_cache_chunk > sound_cache;
 typedef std::list< sound_cache_chunk >::iterator sound_cache_iterator;
+// file ==> position in sound_cache.
+boost::unordered_map<std::string, sound_cache_iterator> sound_cache_index;
+
+struct tdeferred_play
+{
+	tdeferred_play(const std::string& file, sound::channel_group group, unsigned int repeats, unsigned int distance, int id, int loop_ticks, int fadein_ticks)
+		: file(file)
+		, group(group)
+		, repeats(repeats)
+		, distance(distance)
+		, id(id)
+		, loop_ticks(loop_ticks)
+		, fadein_ticks(fadein_ticks)
+		, ticks(SDL_GetTicks())
+	{}
+
+	std::string file;
+	sound::channel_group group;
+	unsigned int repeats;
+	unsigned int distance;
+	int id;
+	int loop_ticks;
+	int fadein_ticks;
+	Uint32 ticks;
+};
+// play requests that wait for their chunk decoding.
+std::vector<tdeferred_play> deferred_plays;
+
+// after a group is stopped, sound requested before it must not start when decoded.
+void drop_deferred_plays(sound::channel_group group1, sound::channel_group group2)
+{
+	std::vector<tdeferred_play>::iterator it = deferred_plays.begin();
+	while (it != deferred_plays.end()) {
+		if (it->group == group1 || it->group == group2) {
+			it = deferred_plays.erase(it);
+		} else {
+			++ it;
+		}
+	}
+}
 std::map<std::string, Mix_Music*> music_cache;
 
 std::vector<std::string> played_before;
@@ -278,6 +332,179 @@ struct audio_lock
 	}
 };
 
+// Decodes sound files on a background thread, so the first play of a sound doesn't hitch the frame.
+// Requests are posted and results are collected by main thread only, sound cache isn't touched here.
+class tsound_decoder
+{
+public:
+	struct tdecoded {
+		tdecoded(const std::string& file, sound::channel_group group, Mix_Chunk* chunk)
+			: file(file)
+			, group(group)
+			, chunk(chunk)
+		{}
+
+		std::string file;
+		sound::channel_group group;
+		Mix_Chunk* chunk;
+	};
+
+	tsound_decoder()
+		: mutex_()
+		, cond_()
+		, requests_()
+		, decoded_()
+		, pending_()
+		, exit_(false)
+		, thread_(NULL)
+	{}
+
+	~tsound_decoder()
+	{
+		stop();
+	}
+
+	bool pending(const std::string& file) const { return pending_.count(file) > 0; }
+
+	void request(const std::string& file, const std::string& filename, sound::channel_group group)
+	{
+		if (!pending_.insert(file).second) {
+			return;
+		}
+		if (!thread_) {
+			exit_ = false;
+			thread_ = new threading::thread(thread_main, this);
+		}
+		threading::lock lock(mutex_);
+		requests_.push_back(trequest(file, filename, group));
+		cond_.notify_one();
+	}
+
+	void collect(std::vector<tdecoded>& result)
+	{
+		{
+			threading::lock lock(mutex_);
+			result.swap(decoded_);
+		}
+		for (std::vector<tdecoded>::const_iterator it = result.begin(); it != result.end(); ++ it) {
+			pending_.erase(it->file);
+		}
+	}
+
+	// must be called before Mix_CloseAudio, decoded chunks depend on the opened audio format.
+	void stop()
+	{
+		if (!thread_) {
+			return;
+		}
+		{
+			threading::lock lock(mutex_);
+			exit_ = true;
+			cond_.notify_one();
+		}
+		delete thread_;
+		thread_ = NULL;
+
+		requests_.clear();
+		for (std::vector<tdecoded>::const_iterator it = decoded_.begin(); it != decoded_.end(); ++ it) {
+			if (it->chunk) {
+				Mix_FreeChunk(it->chunk);
+			}
+		}
+		decoded_.clear();
+		pending_.clear();
+	}
+
+private:
+	struct trequest {
+		trequest(const std::string& file, const std::string& filename, sound::channel_group group)
+			: file(file)
+			, filename(filename)
+			, group(group)
+		{}
+
+		std::string file;
+		std::string filename;
+		sound::channel_group group;
+	};
+
+	static int thread_main(void* data)
+	{
+		reinterpret_cast<tsound_decoder*>(data)->run();
+		return 0;
+	}
+
+	void run()
+	{
+		while (true) {
+			trequest req(null_str, null_str, sound::NULL_CHANNEL);
+			{
+				threading::lock lock(mutex_);
+				while (requests_.empty() && !exit_) {
+					cond_.wait(mutex_);
+				}
+				if (exit_) {
+					return;
+				}
+				req = requests_.front();
+				requests_.pop_front();
+			}
+
+			Mix_Chunk* chunk = Mix_LoadWAV(req.filename.c_str());
+
+			threading::lock lock(mutex_);
+			decoded_.push_back(tdecoded(req.file, req.group, chunk));
+		}
+	}
+
+private:
+	threading::mutex mutex_;
+	threading::condition cond_;
+	std::deque<trequest> requests_;
+	std::vector<tdecoded> decoded_;
+	// main thread only. requested but not yet collected files.
+	std::set<std::string> pending_;
+	bool exit_;
+	threading::thread* thread_;
+};
+
+tsound_decoder decoder;
+
+sound_cache_iterator erase_cache_chunk(sound_cache_iterator it)
+{
+	if (it->get_data()) {
+		cached_bytes -= it->get_data()->alen;
+	}
+	sound_cache_index.erase(it->file);
+	return sound_cache.erase(it);
+}
+
+void clear_sound_cache()
+{
+	sound_cache.clear();
+	sound_cache_index.clear();
+	cached_bytes = 0;
+}
+
+// evict least recently used, not playing chunks until there is place for one more chunk of bytes.
+bool make_room_in_cache(size_t bytes)
+{
+	audio_lock lock;
+
+	sound_cache_iterator it = sound_cache.end();
+	while (it != sound_cache.begin() && (sound_cache.size() >= max_cached_chunks || cached_bytes + bytes > max_cached_bytes)) {
+		// make sure this chunk is not being played before freeing it
+		--it;
+		if (std::find(sound::channel_chunks.begin(), sound::channel_chunks.end(), it->get_data()) == sound::channel_chunks.end()) {
+			it = erase_cache_chunk(it);
+		}
+	}
+	if (cached_bytes + bytes > max_cached_bytes) {
+		LOG_AUDIO << "Sound cache exceeds budget, all cached chunks are busy.\n";
+	}
+	return sound_cache.size() < max_cached_chunks;
+}
+
 } // end of anonymous namespace
 
 
@@ -385,7 +612,9 @@ void close_sound()
 		stop_bell();
 		stop_UI_sound();
 		stop_sound();
-		sound_cache.clear();
+		decoder.stop();
+		deferred_plays.clear();
+		clear_sound_cache();
 		stop_music();
 		mix_ok = false;
 
@@ -450,11 +679,12 @@ void stop_sound()
 	if (mix_ok) {
 		Mix_HaltGroup(SOUND_SOURCES);
 		Mix_HaltGroup(SOUND_FX);
+		drop_deferred_plays(SOUND_SOURCES, SOUND_FX);
 		sound_cache_iterator itor = sound_cache.begin();
 		while(itor != sound_cache.end())
 		{
 			if(itor->group == SOUND_SOURCES || itor->group == SOUND_FX) {
-				itor = sound_cache.erase(itor);
+				itor = erase_cache_chunk(itor);
 			} else {
 				++itor;
 			}
@@ -470,11 +700,12 @@ void stop_bell()
 	if (mix_ok) {
 		Mix_HaltGroup(SOUND_BELL);
 		Mix_HaltGroup(SOUND_TIMER);
+		drop_deferred_plays(SOUND_BELL, SOUND_TIMER);
 		sound_cache_iterator itor = sound_cache.begin();
 		while(itor != sound_cache.end())
 		{
 			if(itor->group == SOUND_BELL || itor->group == SOUND_TIMER) {
-				itor = sound_cache.erase(itor);
+				itor = erase_cache_chunk(itor);
 			} else {
 				++itor;
 			}
@@ -486,11 +717,12 @@ void stop_UI_sound()
 {
 	if (mix_ok) {
 		Mix_HaltGroup(SOUND_UI);
+		drop_deferred_plays(SOUND_UI, SOUND_UI);
 		sound_cache_iterator itor = sound_cache.begin();
 		while(itor != sound_cache.end())
 		{
 			if(itor->group == SOUND_UI) {
-				itor = sound_cache.erase(itor);
+				itor = erase_cache_chunk(itor);
 			} else {
 				++itor;
 			}
@@ -617,6 +849,7 @@ void play_music_config(const config &music_node)
 
 void music_thinker::monitor_process() 
 {
+	flush_decoded_sounds();
 }
 
 void commit_music_changes()
@@ -692,69 +925,9 @@ void play_sound_positioned(const std::string &files, int id, int repeats, unsign
 	}
 }
 
-struct chunk_load_exception { };
-
-static Mix_Chunk* load_chunk(const std::string& file, channel_group group)
-{
-	sound_cache_iterator it_bgn, it_end;
-	sound_cache_iterator it;
-
-	sound_cache_chunk temp_chunk(file); // search the sound cache on this key
-	it_bgn = sound_cache.begin(), it_end = sound_cache.end();
-	it = std::find(it_bgn, it_end, temp_chunk);
-
-	if (it != it_end) {
-		if(it->group != group) {
-			// cached item has been used in multiple sound groups
-			it->group = NULL_CHANNEL;
-		}
-
-		//splice the most recently used chunk to the front of the cache
-		sound_cache.splice(it_bgn, sound_cache, it);
-	} else {
-		// remove the least recently used chunk from cache if it's full
-		bool cache_full = (sound_cache.size() == max_cached_chunks);
-		while( cache_full && it != it_bgn ) {
-			// make sure this chunk is not being played before freeing it
-			std::vector<Mix_Chunk*>::iterator ch_end = channel_chunks.end();
-			if(std::find(channel_chunks.begin(), ch_end, (--it)->get_data()) == ch_end) {
-				sound_cache.erase(it);
-				cache_full = false;
-			}
-		}
-		if(cache_full) {
-			LOG_AUDIO << "Maximum sound cache size reached and all are busy, skipping.\n";
-			throw chunk_load_exception();
-		}
-		temp_chunk.group = group;
-		std::string const &filename = get_binary_file_location("sounds", file);
-
-		if (!filename.empty()) {
-			temp_chunk.set_data(Mix_LoadWAV(filename.c_str()));
-		} else {
-			ERR_AUDIO << "Could not load sound file '" << file << "'.\n";
-			throw chunk_load_exception();
-		}
-
-		if (temp_chunk.get_data() == NULL) {
-			ERR_AUDIO << "Could not load sound file '" << filename << "': "
-				<< Mix_GetError() << "\n";
-			throw chunk_load_exception();
-		}
-
-		sound_cache.push_front(temp_chunk);
-	}
-
-	return sound_cache.begin()->get_data();
-}
-
-void play_sound_internal(const std::string& files, channel_group group, unsigned int repeats,
+static void play_chunk(Mix_Chunk* chunk, channel_group group, unsigned int repeats,
 			unsigned int distance, int id, int loop_ticks, int fadein_ticks)
 {
-	if(files.empty() || distance >= DISTANCE_SILENT || !mix_ok) {
-		return;
-	}
-
 	audio_lock lock;
 
 	// find a free channel in the desired group
@@ -764,16 +937,6 @@ void play_sound_internal(const std::string& files, channel_group group, unsigned
 		return;
 	}
 
-	Mix_Chunk *chunk;
-	std::string file = pick_one(files);
-
-	try {
-		chunk = load_chunk(file, group);
-		assert(chunk);
-	} catch (const chunk_load_exception&) {
-		return;
-	}
-
 	/*
 	 * This check prevents SDL_Mixer from blowing up on Windows when UI sound is played
 	 * in response to toggling the checkbox which disables sound.
@@ -813,6 +976,153 @@ void play_sound_internal(const std::string& files, channel_group group, unsigned
 	channel_chunks[res] = chunk;
 }
 
+// return cached chunk of file. NULL if it isn't decoded yet.
+static Mix_Chunk* find_chunk(const std::string& file, channel_group group)
+{
+	boost::unordered_map<std::string, sound_cache_iterator>::iterator it = sound_cache_index.find(file);
+	if (it == sound_cache_index.end()) {
+		return NULL;
+	}
+
+	sound_cache_iterator chunk = it->second;
+	if (chunk->group != group) {
+		// cached item has been used in multiple sound groups
+		chunk->group = NULL_CHANNEL;
+	}
+	//splice the most recently used chunk to the front of the cache
+	sound_cache.splice(sound_cache.begin(), sound_cache, chunk);
+	return chunk->get_data();
+}
+
+// post file to decoder if it isn't in cache. return false if file doesn't exist.
+static bool request_chunk(const std::string& file, channel_group group)
+{
+	if (sound_cache_index.count(file) || decoder.pending(file)) {
+		return true;
+	}
+	std::string const &filename = get_binary_file_location("sounds", file);
+	if (filename.empty()) {
+		ERR_AUDIO << "Could not load sound file '" << file << "'.\n";
+		return false;
+	}
+	decoder.request(file, filename, group);
+	return true;
+}
+
+void flush_decoded_sounds()
+{
+	if (!mix_ok) {
+		return;
+	}
+
+	std::vector<tsound_decoder::tdecoded> decoded;
+	decoder.collect(decoded);
+	if (decoded.empty()) {
+		return;
+	}
+
+	for (std::vector<tsound_decoder::tdecoded>::const_iterator it = decoded.begin(); it != decoded.end(); ++ it) {
+		const tsound_decoder::tdecoded& result = *it;
+		if (result.chunk == NULL) {
+			ERR_AUDIO << "Could not load sound file '" << result.file << "'\n";
+			continue;
+		}
+		if (sound_cache_index.count(result.file) || !make_room_in_cache(result.chunk->alen)) {
+			if (!sound_cache_index.count(result.file)) {
+				LOG_AUDIO << "Maximum sound cache size reached and all are busy, skipping.\n";
+			}
+			Mix_FreeChunk(result.chunk);
+			continue;
+		}
+
+		sound_cache_chunk temp_chunk(result.file);
+		temp_chunk.group = result.group;
+		temp_chunk.set_data(result.chunk);
+		sound_cache.push_front(temp_chunk);
+		sound_cache_index[result.file] = sound_cache.begin();
+		cached_bytes += result.chunk->alen;
+	}
+
+	// serve the plays that were waiting for these chunks.
+	const Uint32 now = SDL_GetTicks();
+	std::vector<tdeferred_play>::iterator it = deferred_plays.begin();
+	while (it != deferred_plays.end()) {
+		const tdeferred_play& play = *it;
+		if (decoder.pending(play.file)) {
+			++ it;
+			continue;
+		}
+		Mix_Chunk* chunk = find_chunk(play.file, play.group);
+		if (chunk && now - play.ticks <= max_late_play_ticks) {
+			cache_stats.late_plays ++;
+			play_chunk(chunk, play.group, play.repeats, play.distance, play.id, play.loop_ticks, play.fadein_ticks);
+		} else {
+			cache_stats.dropped_plays ++;
+		}
+		it = deferred_plays.erase(it);
+	}
+}
+
+void preload(const std::string& files)
+{
+	if (files.empty() || !mix_ok) {
+		return;
+	}
+	const std::vector<std::string> ids = utils::split(files);
+	for (std::vector<std::string>::const_iterator it = ids.begin(); it != ids.end(); ++ it) {
+		request_chunk(*it, NULL_CHANNEL);
+	}
+}
+
+void set_late_play_policy(tlate_play_policy policy, int max_delay)
+{
+	late_play_policy = policy;
+	max_late_play_ticks = max_delay;
+}
+
+void set_cache_budget(size_t bytes)
+{
+	max_cached_bytes = bytes;
+	if (mix_ok) {
+		make_room_in_cache(0);
+	}
+}
+
+const tcache_stats& get_cache_stats()
+{
+	cache_stats.cached_chunks = sound_cache.size();
+	cache_stats.cached_bytes = cached_bytes;
+	return cache_stats;
+}
+
+void play_sound_internal(const std::string& files, channel_group group, unsigned int repeats,
+			unsigned int distance, int id, int loop_ticks, int fadein_ticks)
+{
+	if(files.empty() || distance >= DISTANCE_SILENT || !mix_ok) {
+		return;
+	}
+
+	flush_decoded_sounds();
+
+	std::string file = pick_one(files);
+	Mix_Chunk* chunk = find_chunk(file, group);
+	if (chunk) {
+		cache_stats.hits ++;
+		play_chunk(chunk, group, repeats, distance, id, loop_ticks, fadein_ticks);
+		return;
+	}
+
+	cache_stats.misses ++;
+	if (!request_chunk(file, group)) {
+		return;
+	}
+	if (late_play_policy == LATE_PLAY_QUEUE) {
+		deferred_plays.push_back(tdeferred_play(file, group, repeats, distance, id, loop_ticks, fadein_ticks));
+	} else {
+		cache_stats.dropped_plays ++;
+	}
+}
+
 void play_sound(const std::string& files, channel_group group, unsigned int repeats)
 {
 	if (preferences::sound_on()) {
@@ -89,6 +89,42 @@ void play_timer(const std::string& files, int loop_ticks, int fadein_ticks);
 // Play user-interface sound, or random one of comma-separated sounds.
 void play_UI_sound(const std::string& files);
 
+// Decode comma-separated sounds in background, so their first play needn't wait.
+void preload(const std::string& files);
+
+// Move chunks decoded in background into cache, and play the requests waiting for them.
+void flush_decoded_sounds();
+
+// What to do when a sound is requested before it has been decoded.
+enum tlate_play_policy {
+	LATE_PLAY_QUEUE,	// play it once decoded, unless it has waited more than max_delay ms.
+	LATE_PLAY_DROP		// skip this play, decoding goes on for next time.
+};
+void set_late_play_policy(tlate_play_policy policy, int max_delay);
+
+// Maximum bytes of decoded samples in cache.
+void set_cache_budget(size_t bytes);
+
+struct tcache_stats
+{
+	tcache_stats()
+		: hits(0)
+		, misses(0)
+		, late_plays(0)
+		, dropped_plays(0)
+		, cached_chunks(0)
+		, cached_bytes(0)
+	{}
+
+	int hits;
+	int misses;
+	int late_plays;
+	int dropped_plays;
+	size_t cached_chunks;
+	size_t cached_bytes;
+};
+const tcache_stats& get_cache_stats();
+
 // A class to periodically check for new music that needs to be played
 class music_thinker : public events::pump_monitor 
 {
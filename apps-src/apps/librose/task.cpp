@@ -232,10 +232,7 @@ bool ttask::tsubtask_copy::do_copy(display& disp, const std::string& src_alias,
 				}
 			}
 			if (r.type == res_file || r.type == res_dir) {
-				fok = SDL_CopyFiles(src.c_str(), dst.c_str());
-				if (fok && r.type == res_dir) {
-					fok = compare_directory(src, dst);
-				}
+				fok = copy_files_parallel(src, dst);
 			} else {
 				bool has_resolved = false;
 				if (!is_directory(dst)) {
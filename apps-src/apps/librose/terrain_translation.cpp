@@ -27,6 +27,7 @@
 #include "serialization/string_utils.hpp"
 #include "util.hpp"
 #include "wml_exception.hpp"
+#include "webrtc/base/base64.h"
 
 
 #define ERR_G LOG_STREAM(err, lg::general)
@@ -275,34 +276,106 @@ std::string write_list(const t_list& list)
 	return result.str();
 }
 
+namespace {
+
+/**
+ * Caches the conversion of map cells, most maps only use a few dozen
+ * different cell strings so nearly every cell becomes a table lookup.
+ */
+class tcell_cache
+{
+public:
+	tcell_cache()
+		: entries_()
+	{}
+
+	t_terrain lookup(const char* text, size_t len, int& start_position)
+	{
+		// Strip the spaces around us
+		while (len && (*text == ' ' || *text == '\t')) {
+			++ text;
+			-- len;
+		}
+		while (len && (text[len - 1] == ' ' || text[len - 1] == '\t')) {
+			-- len;
+		}
+		if (!len) {
+			return t_terrain();
+		}
+		if (len > MAX_CELL_SIZE) {
+			return string_to_number_(std::string(text, len), start_position, NO_LAYER);
+		}
+
+		// fnv-1a
+		uint32_t hash = 2166136261u;
+		for (size_t n = 0; n < len; n ++) {
+			hash = (hash ^ (uint8_t)text[n]) * 16777619u;
+		}
+		tentry& entry = entries_[hash % TABLE_SIZE];
+		if (entry.len != len || memcmp(entry.text, text, len)) {
+			entry.start_position = -1;
+			entry.terrain = string_to_number_(std::string(text, len), entry.start_position, NO_LAYER);
+			memcpy(entry.text, text, len);
+			entry.len = len;
+		}
+		start_position = entry.start_position;
+		return entry.terrain;
+	}
+
+private:
+	enum {MAX_CELL_SIZE = 15, TABLE_SIZE = 251};
+
+	struct tentry {
+		// len is 0 until used, lookup never matches it since empty cell returns early.
+		tentry()
+			: len(0)
+			, terrain()
+			, start_position(-1)
+		{}
+
+		size_t len;
+		char text[MAX_CELL_SIZE];
+		t_terrain terrain;
+		int start_position;
+	};
+	tentry entries_[TABLE_SIZE];
+};
+
+}
+
 t_map read_game_map(const std::string& str,	std::map<int, coordinate>& starting_positions)
 {
 	t_map result;
 
-	size_t offset = 0;
+	const char* const end = str.c_str() + str.size();
+	const char* cur = str.c_str();
 	size_t x = 0, y = 0, width = 0;
 
 	// Skip the leading newlines
-	while(offset < str.length() && utils::isnewline(str[offset])) {
-		++offset;
+	while (cur < end && utils::isnewline(*cur)) {
+		++ cur;
 	}
 
 	// Did we get an empty map?
-	if((offset + 1) >= str.length()) {
+	if (cur + 1 >= end) {
 		return result;
 	}
 
-	while(offset < str.length()) {
+	tcell_cache cache;
+	size_t rows_hint = 0;
 
-		// Get a terrain chunk
-		const std::string separators = ",\n\r";
-		const size_t pos_separator = str.find_first_of(separators, offset);
-		const std::string terrain = str.substr(offset, pos_separator - offset);
+	while (cur < end) {
+
+		// Get a terrain chunk, it is converted in place without copying it out.
+		const char* separator = cur;
+		while (separator < end && *separator != ',' && *separator != '\n' && *separator != '\r') {
+			++ separator;
+		}
 
 		// Process the chunk
 		int starting_position = -1;
 		// The gamemap never has a wildcard
-		const t_terrain tile = string_to_number_(terrain, starting_position, NO_LAYER);
+		const t_terrain tile = cache.lookup(cur, separator - cur, starting_position);
 
 		// Add to the resulting starting position
 		if(starting_position != -1) {
@@ -318,27 +391,36 @@ t_map read_game_map(const std::string& str,	std::map<int, coordinate>& starting_
 			}
 		}
 
-		// Make space for the new item
-		// NOTE we increase the vector every loop for every x and y.
-		// Profiling with an increase of y with 256 items didn't show
-		// an significant speed increase.
-		// So didn't rework the system to allocate larger vectors at once.
+		// Make space for the new item. Once the first line is known every
+		// column reserves the estimated height, so growing it is cheap.
 		if(result.size() <= x) {
 			result.resize(x + 1);
+			if (rows_hint) {
+				result[x].reserve(rows_hint);
+			}
 		}
-		if(result[x].size() <= y) {
-			result[x].resize(y + 1);
+		t_list& column = result[x];
+		if(column.size() <= y) {
+			column.resize(y + 1);
 		}
 
 		// Add the resulting terrain number
-		result[x][y] = tile;
+		column[y] = tile;
 
 		// Evaluate the separator
-		if(pos_separator == std::string::npos || utils::isnewline(str[pos_separator])) {
+		if(separator == end || utils::isnewline(*separator)) {
 			// the first line we set the with the other lines we check the width
 			if(y == 0) {
 				// x contains the offset in the map
 				width = x + 1;
+
+				rows_hint = std::count(separator, end, '\n') + 1;
+				if (rows_hint > max_map_size() + 1) {
+					rows_hint = max_map_size() + 1;
+				}
+				for (t_map::iterator it = result.begin(); it != result.end(); ++ it) {
+					it->reserve(rows_hint);
+				}
 			} else {
 				if((x + 1) != width ) {
 					ERR_G << "Map not a rectangle error occurred at line offset " << y << " position offset " << x << "\n";
@@ -355,21 +437,21 @@ t_map read_game_map(const std::string& str,	std::map<int, coordinate>& starting_
 			x = 0;
 
 			// Avoid in infinite loop if the last line ends without an EOL
-			if(pos_separator == std::string::npos) {
-				offset = str.length();
+			if(separator == end) {
+				cur = end;
 
 			} else {
 
-				offset = pos_separator + 1;
+				cur = separator + 1;
 				// Skip the following newlines
-				while(offset < str.length() && utils::isnewline(str[offset])) {
-					++offset;
+				while(cur < end && utils::isnewline(*cur)) {
+					++cur;
 				}
 			}
 
 		} else {
 			++x;
-			offset = pos_separator + 1;
+			cur = separator + 1;
 			if (x > max_map_size()) {
 				ERR_G << "Map size exceeds limit (x > " << max_map_size() << ")\n";
 				throw error("Map width limit exceeded.");
@@ -420,6 +502,194 @@ std::string write_game_map(const t_map& map, std::map<int, coordinate> starting_
 	return str.str();
 }
 
+namespace {
+
+// ':' is never in map text, so the magic can't be mistaken for a terrain.
+const char map_bin_magic[] = "RMB1:";
+const size_t map_bin_magic_len = sizeof(map_bin_magic) - 1;
+
+void put_varint(std::string& out, uint32_t value)
+{
+	while (value >= 0x80) {
+		out.push_back((char)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((char)value);
+}
+
+void put_u32(std::string& out, uint32_t value)
+{
+	for (int n = 0; n < 4; n ++) {
+		out.push_back((char)(value >> (n * 8)));
+	}
+}
+
+class tbin_reader
+{
+public:
+	tbin_reader(const std::string& str)
+		: cur_((const uint8_t*)str.c_str())
+		, end_((const uint8_t*)str.c_str() + str.size())
+	{}
+
+	uint32_t u32()
+	{
+		need(4);
+		const uint32_t result = cur_[0] | (cur_[1] << 8) | (cur_[2] << 16) | ((uint32_t)cur_[3] << 24);
+		cur_ += 4;
+		return result;
+	}
+
+	uint32_t varint()
+	{
+		uint32_t result = 0;
+		for (int shift = 0; shift < 32; shift += 7) {
+			need(1);
+			const uint8_t byte = *cur_ ++;
+			result |= (uint32_t)(byte & 0x7f) << shift;
+			if (!(byte & 0x80)) {
+				return result;
+			}
+		}
+		throw error("Corrupted binary map.");
+	}
+
+private:
+	void need(size_t size) const
+	{
+		if ((size_t)(end_ - cur_) < size) {
+			throw error("Truncated binary map.");
+		}
+	}
+
+private:
+	const uint8_t* cur_;
+	const uint8_t* end_;
+};
+
+}
+
+bool is_game_map_bin(const std::string& str)
+{
+	return !str.compare(0, map_bin_magic_len, map_bin_magic);
+}
+
+std::string write_game_map_bin(const t_map& map, const std::map<int, coordinate>& starting_positions)
+{
+	const size_t w = map.size();
+	const size_t h = w? map[0].size(): 0;
+
+	std::string bin;
+	put_varint(bin, w);
+	put_varint(bin, h);
+
+	// palette, in order of first use.
+	std::map<t_terrain, uint32_t> indexes;
+	std::vector<t_terrain> palette;
+	for (size_t y = 0; y < h; ++ y) {
+		for (size_t x = 0; x < w; ++ x) {
+			if (indexes.insert(std::make_pair(map[x][y], (uint32_t)palette.size())).second) {
+				palette.push_back(map[x][y]);
+			}
+		}
+	}
+	put_varint(bin, palette.size());
+	for (std::vector<t_terrain>::const_iterator it = palette.begin(); it != palette.end(); ++ it) {
+		put_u32(bin, it->base);
+		put_u32(bin, it->overlay);
+	}
+
+	put_varint(bin, starting_positions.size());
+	for (std::map<int, coordinate>::const_iterator it = starting_positions.begin(); it != starting_positions.end(); ++ it) {
+		put_u32(bin, it->first);
+		put_varint(bin, it->second.x);
+		put_varint(bin, it->second.y);
+	}
+
+	// tiles, row by row like the text form, as (run, index) pairs.
+	uint32_t run = 0, index = 0;
+	for (size_t y = 0; y < h; ++ y) {
+		for (size_t x = 0; x < w; ++ x) {
+			const uint32_t at = indexes.find(map[x][y])->second;
+			if (run && at == index) {
+				run ++;
+				continue;
+			}
+			if (run) {
+				put_varint(bin, run);
+				put_varint(bin, index);
+			}
+			run = 1;
+			index = at;
+		}
+	}
+	if (run) {
+		put_varint(bin, run);
+		put_varint(bin, index);
+	}
+	return map_bin_magic + rtc::Base64::Encode(bin);
+}
+
+t_map read_game_map_bin(const std::string& str, std::map<int, coordinate>& starting_positions)
+{
+	if (!is_game_map_bin(str)) {
+		throw error("Not a binary map.");
+	}
+	// map_data may end with newline when it is written in a cfg.
+	std::string bin;
+	if (!rtc::Base64::DecodeFromArray(str.c_str() + map_bin_magic_len, str.size() - map_bin_magic_len,
+		rtc::Base64::DO_PARSE_WHITE | rtc::Base64::DO_PAD_YES | rtc::Base64::DO_TERM_BUFFER, &bin, NULL)) {
+		throw error("Corrupted binary map.");
+	}
+	tbin_reader reader(bin);
+
+	const size_t w = reader.varint();
+	const size_t h = reader.varint();
+	if (w > max_map_size() + 2 || h > max_map_size() + 2) {
+		throw error("Map size exceeds limit.");
+	}
+	if (!w != !h) {
+		throw error("Map not a rectangle.");
+	}
+
+	const uint32_t colors = reader.varint();
+	if (colors > w * h) {
+		throw error("Corrupted binary map.");
+	}
+	std::vector<t_terrain> palette(colors);
+	for (std::vector<t_terrain>::iterator it = palette.begin(); it != palette.end(); ++ it) {
+		it->base = reader.u32();
+		it->overlay = reader.u32();
+	}
+
+	const uint32_t positions = reader.varint();
+	for (uint32_t n = 0; n < positions; n ++) {
+		const int id = reader.u32();
+		const size_t x = reader.varint();
+		const size_t y = reader.varint();
+		starting_positions[id] = coordinate(x, y);
+	}
+
+	t_map result(w, t_list(h));
+	size_t x = 0, y = 0;
+	while (y < h) {
+		uint32_t run = reader.varint();
+		const uint32_t index = reader.varint();
+		if (!run || index >= palette.size() || run > (h - y) * w - x) {
+			throw error("Corrupted binary map.");
+		}
+		const t_terrain tile = palette[index];
+		for (; run; run --) {
+			result[x][y] = tile;
+			if (++ x == w) {
+				x = 0;
+				++ y;
+			}
+		}
+	}
+	return result;
+}
+
 bool terrain_matches(const t_terrain& src, const t_terrain& dest)
 {
 	return terrain_matches(src, t_list(1, dest));
@@ -253,6 +253,28 @@ namespace t_translation {
 	 */
 	std::string write_game_map(const t_map& map, std::map<int, coordinate> starting_positions = std::map<int, coordinate>());
 
+	/**
+	 * Write a gamemap in the compact binary form.
+	 *
+	 * The form holds a palette of the used terrains, the starting positions
+	 * and the tiles row by row as run-length encoded palette indexes. It is
+	 * meant to be embedded in xwml bins, whose values are C strings, so it is
+	 * base64 after a printable magic and never contains NUL, comma or newline.
+	 *
+	 * @returns			A string for read_game_map_bin.
+	 */
+	std::string write_game_map_bin(const t_map& map, const std::map<int, coordinate>& starting_positions = std::map<int, coordinate>());
+
+	/** Whether @p str was generated by write_game_map_bin. */
+	bool is_game_map_bin(const std::string& str);
+
+	/**
+	 * Reads a gamemap written by write_game_map_bin.
+	 *
+	 * Has the same result as read_game_map on the text form of the map.
+	 */
+	t_map read_game_map_bin(const std::string& str, std::map<int, coordinate>& starting_positions);
+
 	/**
 	 * Tests whether a specific terrain matches a list of expressions.
 	 * The list can use wildcard matching with *.
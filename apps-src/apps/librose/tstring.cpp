@@ -20,19 +20,26 @@
 
 #include "global.hpp"
 
+#include <algorithm>
+#include <deque>
 #include <map>
 #include <vector>
 
 #include "tstring.hpp"
 #include "gettext.hpp"
 #include "log.hpp"
+#include "thread.hpp"
+#include <boost/foreach.hpp>
 #include <boost/functional/hash.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
 
 static lg::log_domain log_config("config");
 #define LOG_CF LOG_STREAM(info, log_config)
 #define ERR_CF LOG_STREAM(err, log_config)
 
-static unsigned language_counter = 0;
+// written with messages_mutex locked, read by str() without lock.
+static SDL_atomic_t language_counter;
 
 namespace {
 	const char TRANSLATABLE_PART = 0x01;
@@ -42,6 +49,243 @@ namespace {
 
 	std::vector<std::string> id_to_textdomain;
 	std::map<std::string, unsigned int> textdomain_to_id;
+	// config is parsed in more than one thread when studio builds.
+	threading::mutex textdomain_mutex;
+}
+
+namespace {
+/**
+ * Translation of msgid in one language generation. It is never modified after
+ * being published, so it can be read without lock.
+ */
+struct ttranslation
+{
+	ttranslation(unsigned timestamp, const std::string& str)
+		: timestamp(timestamp)
+		, str(&str)
+	{}
+
+	unsigned timestamp;
+	// in translated_texts.
+	const std::string* str;
+};
+}
+
+/**
+ * One (textdomain, msgid), shared by all t_string that use it.
+ * It is translated again when translation isn't of language_counter.
+ */
+struct t_string_base::tmessage
+{
+	tmessage(const std::string& textdomain, const std::string& msgid)
+		: textdomain(textdomain)
+		, msgid(msgid)
+		, translation(NULL)
+	{}
+
+	std::string textdomain;
+	std::string msgid;
+	// ttranslation*, set by SDL_AtomicSetPtr.
+	void* translation;
+};
+
+namespace {
+	// deque never moves its elements, segments can point to them.
+	std::deque<t_string_base::tmessage> messages;
+	boost::unordered_map<std::string, t_string_base::tmessage*> message_map;
+	threading::mutex messages_mutex;
+
+	// translations of current and previous language generation, indexed by
+	// timestamp & 1. a reader that got translation just before language changed
+	// can still use it until the next change.
+	std::deque<ttranslation> translations[2];
+
+	// texts that translations point to. str() returns reference to them and
+	// caller may keep it over language changes, so they are never freed.
+	// only distinct texts are kept, switching back to a language adds nothing.
+	boost::unordered_set<std::string> translated_texts;
+
+	t_string_base::tmessage* intern_message(const std::string& textdomain, const std::string& msgid)
+	{
+		std::string key = textdomain;
+		key.push_back('\0');
+		key += msgid;
+
+		threading::lock lock(messages_mutex);
+		boost::unordered_map<std::string, t_string_base::tmessage*>::const_iterator it = message_map.find(key);
+		if (it != message_map.end()) {
+			return it->second;
+		}
+		messages.push_back(t_string_base::tmessage(textdomain, msgid));
+		t_string_base::tmessage* message = &messages.back();
+		message_map.insert(std::make_pair(key, message));
+		return message;
+	}
+
+	const ttranslation* get_translation(t_string_base::tmessage& message)
+	{
+		return reinterpret_cast<const ttranslation*>(SDL_AtomicGetPtr(&message.translation));
+	}
+
+	// must be called with messages_mutex locked.
+	const ttranslation& publish_translation(t_string_base::tmessage& message, unsigned timestamp, const std::string& str)
+	{
+		std::deque<ttranslation>& pool = translations[timestamp & 1];
+		pool.push_back(ttranslation(timestamp, *translated_texts.insert(str).first));
+		ttranslation& translation = pool.back();
+		SDL_AtomicSetPtr(&message.translation, &translation);
+		return translation;
+	}
+
+	// must be called with messages_mutex locked, when timestamp begins.
+	void release_translations(unsigned timestamp)
+	{
+		// pool of timestamp holds translations of timestamp - 2, unlink them.
+		BOOST_FOREACH (t_string_base::tmessage& message, messages) {
+			const ttranslation* translation = get_translation(message);
+			if (translation && translation->timestamp != timestamp - 1) {
+				SDL_AtomicSetPtr(&message.translation, NULL);
+			}
+		}
+		translations[timestamp & 1].clear();
+	}
+
+	// after language changed, translate all known messages in background,
+	// then str() of most strings needn't call gettext in UI thread.
+	class ttranslator
+	{
+	public:
+		ttranslator()
+			: mutex_()
+			, keys_()
+			, translated_()
+			, timestamp_(0)
+			, start_ticks_(0)
+			, done_(false)
+			, exit_(false)
+			, thread_(NULL)
+		{}
+
+		~ttranslator()
+		{
+			stop();
+		}
+
+		// must be called with messages_mutex locked.
+		void start(unsigned timestamp)
+		{
+			stop();
+
+			keys_.clear();
+			BOOST_FOREACH (const t_string_base::tmessage& message, messages) {
+				keys_.push_back(std::make_pair(message.textdomain, message.msgid));
+			}
+			translated_.clear();
+			timestamp_ = timestamp;
+			start_ticks_ = SDL_GetTicks();
+			done_ = false;
+			exit_ = false;
+			thread_ = new threading::thread(thread_main, this);
+		}
+
+		// must be called with messages_mutex locked.
+		void stop()
+		{
+			if (!thread_) {
+				return;
+			}
+			{
+				threading::lock lock(mutex_);
+				exit_ = true;
+			}
+			delete thread_;
+			thread_ = NULL;
+		}
+
+		// must be called with messages_mutex locked.
+		void apply()
+		{
+			if (!thread_) {
+				return;
+			}
+			{
+				threading::lock lock(mutex_);
+				if (!done_) {
+					return;
+				}
+			}
+			delete thread_;
+			thread_ = NULL;
+
+			if (timestamp_ != (unsigned)SDL_AtomicGet(&language_counter)) {
+				return;
+			}
+			for (size_t n = 0; n < translated_.size(); n ++) {
+				t_string_base::tmessage& message = messages[n];
+				const ttranslation* translation = get_translation(message);
+				if (!translation || translation->timestamp != timestamp_) {
+					publish_translation(message, timestamp_, translated_[n]);
+				}
+			}
+			LOG_CF << "translated " << translated_.size() << " messages in " << (SDL_GetTicks() - start_ticks_) << " ms\n";
+			translated_.clear();
+		}
+
+	private:
+		bool exiting()
+		{
+			threading::lock lock(mutex_);
+			return exit_;
+		}
+
+		static int thread_main(void* data)
+		{
+			reinterpret_cast<ttranslator*>(data)->run();
+			return 0;
+		}
+
+		void run()
+		{
+			translated_.reserve(keys_.size());
+			for (std::vector<std::pair<std::string, std::string> >::const_iterator it = keys_.begin(); it != keys_.end(); ++ it) {
+				if (exiting()) {
+					break;
+				}
+				translated_.push_back(dsgettext(it->first.c_str(), it->second.c_str()));
+			}
+			threading::lock lock(mutex_);
+			done_ = true;
+		}
+
+	private:
+		threading::mutex mutex_;
+		std::vector<std::pair<std::string, std::string> > keys_;
+		std::vector<std::string> translated_;
+		unsigned timestamp_;
+		Uint32 start_ticks_;
+		bool done_;
+		bool exit_;
+		threading::thread* thread_;
+	};
+	ttranslator translator;
+
+	const std::string& translate_message(t_string_base::tmessage& message)
+	{
+		const unsigned timestamp = SDL_AtomicGet(&language_counter);
+		const ttranslation* translation = get_translation(message);
+		if (translation && translation->timestamp == timestamp) {
+			return *translation->str;
+		}
+
+		threading::lock lock(messages_mutex);
+		translator.apply();
+		translation = get_translation(message);
+		if (!translation || translation->timestamp != (unsigned)SDL_AtomicGet(&language_counter)) {
+			// background translating hasn't reached it.
+			translation = &publish_translation(message, SDL_AtomicGet(&language_counter), dsgettext(message.textdomain.c_str(), message.msgid.c_str()));
+		}
+		return *translation->str;
+	}
 }
 
 size_t t_string_base::hash_value() const {
@@ -52,9 +296,9 @@ size_t t_string_base::hash_value() const {
 	return seed;
 }
 
-t_string_base::walker::walker(const t_string_base& string) :
+t_string_base::walker::walker(const t_string_base& string, std::string::size_type begin) :
 	string_(string.value_),
-	begin_(0),
+	begin_(begin),
 	end_(string_.size()),
 	textdomain_(),
 	translatable_(false)
@@ -106,12 +350,15 @@ void t_string_base::walker::update()
 			end_ = string_.size();
 
 		id = string_[begin_ + 1] + string_[begin_ + 2] * 256;
-		if(id >= id_to_textdomain.size()) {
-			ERR_CF << "Error: invalid string: " << string_ << "\n";
-			begin_ = string_.size();
-			return;
+		{
+			threading::lock lock(textdomain_mutex);
+			if(id >= id_to_textdomain.size()) {
+				ERR_CF << "Error: invalid string: " << string_ << "\n";
+				begin_ = string_.size();
+				return;
+			}
+			textdomain_ = id_to_textdomain[id];
 		}
-		textdomain_ = id_to_textdomain[id];
 		begin_ += 3;
 		translatable_ = true;
 
@@ -145,6 +392,7 @@ t_string_base::t_string_base() :
 	value_(),
 	translated_value_(),
 	translation_timestamp_(0),
+	segments_(),
 	translatable_(false),
 	last_untranslatable_(false)
 {
@@ -158,6 +406,7 @@ t_string_base::t_string_base(const t_string_base& string) :
 	value_(string.value_),
 	translated_value_(string.translated_value_),
 	translation_timestamp_(string.translation_timestamp_),
+	segments_(string.segments_),
 	translatable_(string.translatable_),
 	last_untranslatable_(string.last_untranslatable_)
 {
@@ -167,6 +416,7 @@ t_string_base::t_string_base(const std::string& string) :
 	value_(string),
 	translated_value_(),
 	translation_timestamp_(0),
+	segments_(),
 	translatable_(false),
 	last_untranslatable_(false)
 {
@@ -176,6 +426,7 @@ t_string_base::t_string_base(const std::string& string, const std::string& textd
 	value_(1, ID_TRANSLATABLE_PART),
 	translated_value_(),
 	translation_timestamp_(0),
+	segments_(),
 	translatable_(true),
 	last_untranslatable_(false)
 {
@@ -185,26 +436,31 @@ t_string_base::t_string_base(const std::string& string, const std::string& textd
 		return;
 	}
 
-	std::map<std::string, unsigned int>::const_iterator idi = textdomain_to_id.find(textdomain);
 	unsigned int id;
-
-	if(idi == textdomain_to_id.end()) {
-		id = id_to_textdomain.size();
-		textdomain_to_id[textdomain] = id;
-		id_to_textdomain.push_back(textdomain);
-	} else {
-		id = idi->second;
+	{
+		threading::lock lock(textdomain_mutex);
+		std::map<std::string, unsigned int>::const_iterator idi = textdomain_to_id.find(textdomain);
+
+		if(idi == textdomain_to_id.end()) {
+			id = id_to_textdomain.size();
+			textdomain_to_id[textdomain] = id;
+			id_to_textdomain.push_back(textdomain);
+		} else {
+			id = idi->second;
+		}
 	}
 
 	value_ += char(id & 0xff);
 	value_ += char(id >> 8);
 	value_ += string;
+	parse_segments();
 }
 
 t_string_base::t_string_base(const char* string) :
 	value_(string),
 	translated_value_(),
 	translation_timestamp_(0),
+	segments_(),
 	translatable_(false),
 	last_untranslatable_(false)
 {
@@ -257,6 +513,7 @@ std::string t_string_base::to_serialized() const
 			chunk.last_untranslatable_ = false;
 			chunk.value_ = TRANSLATABLE_PART + w.textdomain() +
 				TEXTDOMAIN_SEPARATOR + substr;
+			chunk.parse_segments();
 		} else {
 			chunk.translatable_ = false;
 			chunk.value_ = substr;
@@ -273,6 +530,7 @@ t_string_base& t_string_base::operator=(const t_string_base& string)
 	value_ = string.value_;
 	translated_value_ = string.translated_value_;
 	translation_timestamp_ = string.translation_timestamp_;
+	segments_ = string.segments_;
 	translatable_ = string.translatable_;
 	last_untranslatable_ = string.last_untranslatable_;
 
@@ -284,6 +542,7 @@ t_string_base& t_string_base::operator=(const std::string& string)
 	value_ = string;
 	translated_value_ = "";
 	translation_timestamp_ = 0;
+	segments_.clear();
 	translatable_ = false;
 	last_untranslatable_ = false;
 
@@ -295,6 +554,7 @@ t_string_base& t_string_base::operator=(const char* string)
 	value_ = string;
 	translated_value_ = "";
 	translation_timestamp_ = 0;
+	segments_.clear();
 	translatable_ = false;
 	last_untranslatable_ = false;
 
@@ -332,25 +592,31 @@ t_string_base& t_string_base::operator+=(const t_string_base& string)
 	}
 
 	if(translatable_ || string.translatable_) {
+		// only parts from here are parsed again.
+		std::string::size_type from = value_.size();
 		if(!translatable_) {
 			value_ = UNTRANSLATABLE_PART + value_;
 			translatable_ = true;
 			last_untranslatable_ = true;
+			from = 0;
 		} else
 			translated_value_ = "";
 		if(string.translatable_) {
-			if (last_untranslatable_ && string.value_[0] == UNTRANSLATABLE_PART)
+			if (last_untranslatable_ && string.value_[0] == UNTRANSLATABLE_PART) {
+				from = std::min(from, last_part());
 				value_.append(string.value_.begin() + 1, string.value_.end());
-			else
+			} else
 				value_ += string.value_;
 			last_untranslatable_ = string.last_untranslatable_;
 		} else {
 			if (!last_untranslatable_) {
 				value_ += UNTRANSLATABLE_PART;
 				last_untranslatable_ = true;
-			}
+			} else
+				from = std::min(from, last_part());
 			value_ += string.value_;
 		}
+		parse_segments(from);
 	} else {
 		value_ += string.value_;
 	}
@@ -368,12 +634,14 @@ t_string_base& t_string_base::operator+=(const std::string& string)
 	}
 
 	if(translatable_) {
+		std::string::size_type from = value_.size();
 		if (!last_untranslatable_) {
 			value_ += UNTRANSLATABLE_PART;
 			last_untranslatable_ = true;
-		}
+		} else
+			from = last_part();
 		value_ += string;
-		translated_value_ = "";
+		parse_segments(from);
 	} else {
 		value_ += string;
 	}
@@ -391,12 +659,14 @@ t_string_base& t_string_base::operator+=(const char* string)
 	}
 
 	if(translatable_) {
+		std::string::size_type from = value_.size();
 		if (!last_untranslatable_) {
 			value_ += UNTRANSLATABLE_PART;
 			last_untranslatable_ = true;
-		}
+		} else
+			from = last_part();
 		value_ += string;
-		translated_value_ = "";
+		parse_segments(from);
 	} else {
 		value_ += string;
 	}
@@ -424,22 +694,42 @@ bool t_string_base::operator<(const t_string_base &that) const
 	return value_ < that.value_;
 }
 
-const std::vector<t_string_base::trans_str>& t_string_base::valuex() const
+std::string::size_type t_string_base::last_part() const
 {
-	static std::vector<trans_str>	t;
-	trans_str				ti;
+	// begin of segment is after its mark.
+	return segments_.empty() || !segments_.back().begin? 0: segments_.back().begin - 1;
+}
 
-	t.clear();
+void t_string_base::parse_segments(std::string::size_type from)
+{
+	while (!segments_.empty() && (!from || segments_.back().begin > from)) {
+		segments_.pop_back();
+	}
+	translated_value_.clear();
+	for(walker w(*this, from); !w.eos(); w.next()) {
+		tsegment segment;
+		segment.begin = w.begin() - value_.begin();
+		segment.end = w.end() - value_.begin();
+		segment.message = NULL;
+		if(w.translatable()) {
+			segment.message = intern_message(w.textdomain(), std::string(w.begin(), w.end()));
+		}
+		segments_.push_back(segment);
+	}
+}
 
-	if (translatable_) {
-		for(walker w(*this); !w.eos(); w.next()) {
-			std::string part(w.begin(), w.end());
+std::vector<t_string_base::trans_str> t_string_base::valuex() const
+{
+	std::vector<trans_str> t;
+	trans_str ti;
 
-			if(w.translatable()) {
-				ti.str = part;
-				ti.td = w.textdomain();
+	if (translatable_) {
+		for (std::vector<tsegment>::const_iterator it = segments_.begin(); it != segments_.end(); ++ it) {
+			if (it->message) {
+				ti.str = it->message->msgid;
+				ti.td = it->message->textdomain;
 			} else {
-				ti.str = part;
+				ti.str.assign(value_, it->begin, it->end - it->begin);
 			}
 			t.push_back(ti);
 		}
@@ -455,22 +745,26 @@ const std::string& t_string_base::str() const
 	if(!translatable_)
 		return value_;
 
-	if (translatable_ && !translated_value_.empty() && translation_timestamp_ == language_counter)
+	if (segments_.size() == 1 && segments_[0].message) {
+		// most translatable string is one msgid, use translation of message directly.
+		return translate_message(*segments_[0].message);
+	}
+
+	const unsigned timestamp = SDL_AtomicGet(&language_counter);
+	if (!translated_value_.empty() && translation_timestamp_ == timestamp)
 		return translated_value_;
 
 	translated_value_.clear();
 
-	for(walker w(*this); !w.eos(); w.next()) {
-		std::string part(w.begin(), w.end());
-
-		if(w.translatable()) {
-			translated_value_ += dsgettext(w.textdomain().c_str(), part.c_str());
+	for (std::vector<tsegment>::const_iterator it = segments_.begin(); it != segments_.end(); ++ it) {
+		if (it->message) {
+			translated_value_ += translate_message(*it->message);
 		} else {
-			translated_value_ += part;
+			translated_value_.append(value_, it->begin, it->end - it->begin);
 		}
 	}
 
-	translation_timestamp_ = language_counter;
+	translation_timestamp_ = timestamp;
 	return translated_value_;
 }
 
@@ -523,9 +817,24 @@ void t_string::add_textdomain(const std::string &name, const std::string &path)
 	bind_textdomain_codeset(name.c_str(), "UTF-8");
 }
 
+void t_string::stop_translating()
+{
+	threading::lock lock(messages_mutex);
+	translator.stop();
+}
+
+unsigned t_string::translation_timestamp()
+{
+	return SDL_AtomicGet(&language_counter);
+}
+
 void t_string::reset_translations()
 {
-	++language_counter;
+	threading::lock lock(messages_mutex);
+	const unsigned timestamp = SDL_AtomicGet(&language_counter) + 1;
+	release_translations(timestamp);
+	SDL_AtomicSet(&language_counter, timestamp);
+	translator.start(timestamp);
 }
 
 std::ostream& operator<<(std::ostream& stream, const t_string_base& string)
@@ -536,7 +845,7 @@ std::ostream& operator<<(std::ostream& stream, const t_string_base& string)
 
 void split_t_string(const t_string& tstr, std::string& textdomain, std::string& msgid)
 {
-	std::vector<t_string_base::trans_str> trans = tstr.valuex();
+	const std::vector<t_string_base::trans_str> trans = tstr.valuex();
 	for (std::vector<t_string_base::trans_str>::const_iterator ti = trans.begin(); ti != trans.end(); ti ++) {
 		// only support one textdomain
 		textdomain = ti->td;
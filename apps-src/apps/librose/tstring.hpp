@@ -30,7 +30,7 @@ public:
 	class walker
 	{
 	public:
-		explicit walker(const t_string_base& string);
+		explicit walker(const t_string_base& string, std::string::size_type begin = 0);
 
 		void next()                               { begin_ = end_; update(); }
 		bool eos() const                          { return begin_ == string_.size(); }
@@ -110,11 +110,34 @@ public:
 		std::string		str;
 		std::string		td;
 	};
-	const std::vector<trans_str>& valuex() const;
+	std::vector<trans_str> valuex() const;
+
+	struct tmessage;
+	/**
+	 * Translatable string is parsed into segments when it is built, so interned
+	 * t_string shared by threads is never modified by str()/valuex().
+	 * Segment is [begin, end) of value_, message is NULL if it is untranslatable.
+	 */
+	struct tsegment {
+		std::string::size_type begin;
+		std::string::size_type end;
+		tmessage* message;
+	};
+
+private:
+	/**
+	 * Parse value_ from from, which must be the mark of a part, into segments_.
+	 * Segments before it are kept, so appending parses only the new parts.
+	 */
+	void parse_segments(std::string::size_type from = 0);
+	/** Where the mark of the last segment is. */
+	std::string::size_type last_part() const;
+
 private:
 	std::string value_;
 	mutable std::string translated_value_;
 	mutable unsigned translation_timestamp_;
+	std::vector<tsegment> segments_;
 	bool translatable_, last_untranslatable_;
 };
 
@@ -179,8 +202,15 @@ public:
 
 	static void add_textdomain(const std::string &name, const std::string &path);
 	static void reset_translations();
-
-	const std::vector<t_string_base::trans_str>& valuex() const { return get().valuex(); }
+	/**
+	 * Stop background translating that reset_translations() started.
+	 * Call it before locale changes, the thread may be in gettext.
+	 */
+	static void stop_translating();
+	/** Bumped by reset_translations(), tells which language generation str() returns. */
+	static unsigned translation_timestamp();
+
+	std::vector<t_string_base::trans_str> valuex() const { return get().valuex(); }
 	const t_string_base& get() const { return super::get(); }
 };
 inline std::ostream& operator<<(std::ostream& os, const t_string& str) { return os << str.get(); }
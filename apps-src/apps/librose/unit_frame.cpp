@@ -19,11 +19,69 @@
 
 #include "display.hpp"
 #include "serialization/string_utils.hpp"
+#include "sound.hpp"
+#include "thread.hpp"
 #include "unit_frame.hpp"
 
-progressive_string::progressive_string(const std::string & data,int duration) :
-	data_(),
-	input_(data)
+size_t tprogressive_track::find_segment(int time) const
+{
+	size_t sub;
+	if (step_ > 0) {
+		sub = time > 0? std::min<size_t>((time - 1) / step_ + 1, starts_.size()): 0;
+
+	} else if (monotonic_) {
+		sub = std::lower_bound(starts_.begin(), starts_.end(), time) - starts_.begin();
+
+	} else {
+		// negative segment time, start times aren't sorted.
+		sub = 0;
+		while (sub < starts_.size() && starts_[sub] < time) {
+			sub ++;
+		}
+	}
+	return sub? sub - 1: 0;
+}
+
+void tprogressive_track::push_segment(int time)
+{
+	if (starts_.empty()) {
+		step_ = time > 0? time: 0;
+	} else if (time != step_) {
+		step_ = 0;
+	}
+	if (time < 0) {
+		monotonic_ = false;
+	}
+	starts_.push_back(duration_);
+	duration_ += time;
+}
+
+static threading::mutex tracks_mutex;
+
+/**
+ * Return compiled track of data. Tracks of same input and duration are shared,
+ * so every frame built from one animation string parses it only once.
+ */
+template <class ttrack>
+static boost::shared_ptr<const ttrack> shared_track(const std::string& data, int duration)
+{
+	typedef std::map<std::pair<std::string, int>, boost::shared_ptr<const ttrack> > ttrack_map;
+	static ttrack_map tracks;
+
+	threading::lock lock(tracks_mutex);
+	const std::pair<std::string, int> key(data, duration);
+	typename ttrack_map::const_iterator it = tracks.find(key);
+	if (it != tracks.end()) {
+		return it->second;
+	}
+	boost::shared_ptr<const ttrack> track(new ttrack(data, duration));
+	tracks.insert(std::make_pair(key, track));
+	return track;
+}
+
+progressive_string::ttrack::ttrack(const std::string & data,int duration) :
+	tprogressive_track(data),
+	data_()
 {
 		const std::vector<std::string> first_pass = utils::split(data);
 		const int time_chunk = std::max<int>(duration / (first_pass.size()?first_pass.size():1),1);
@@ -36,39 +94,28 @@ progressive_string::progressive_string(const std::string & data,int duration) :
 			} else {
 				data_.push_back(std::pair<std::string,int>(second_pass[0],time_chunk));
 			}
+			push_segment(data_.back().second);
 		}
 }
-int progressive_string::duration() const
-{
-	int total =0;
-	std::vector<std::pair<std::string,int> >::const_iterator cur_halo;
-	for(cur_halo = data_.begin() ; cur_halo != data_.end() ; ++cur_halo) {
-		total += cur_halo->second;
-	}
-	return total;
 
+progressive_string::progressive_string(const std::string & data,int duration) :
+	track_(shared_track<ttrack>(data, duration))
+{
 }
 
 static const std::string empty_string;
 
 const std::string& progressive_string::get_current_element(int current_time)const
 {
-	int time = 0;
-	unsigned int sub_halo = 0;
-	if(data_.empty()) return empty_string;
-	while(time < current_time&& sub_halo < data_.size()) {
-		time += data_[sub_halo].second;
-		++sub_halo;
-
-	}
-	if(sub_halo) sub_halo--;
-	return data_[sub_halo].first;
+	const ttrack& track = *track_;
+	if(track.data_.empty()) return empty_string;
+	return track.data_[track.find_segment(current_time)].first;
 }
 
 template <class T>
-progressive_<T>::progressive_(const std::string &data, int duration) :
-	data_(),
-	input_(data)
+progressive_<T>::ttrack::ttrack(const std::string &data, int duration) :
+	tprogressive_track(data),
+	data_()
 {
 	int split_flag = utils::REMOVE_EMPTY; // useless to strip spaces
 	const std::vector<std::string> comma_split = utils::split(data,',',split_flag);
@@ -84,53 +131,42 @@ progressive_<T>::progressive_(const std::string &data, int duration) :
 		T range1 = (range.size() > 1) ? lexical_cast<T>(range[1]) : range0;
 		typedef std::pair<T,T> range_pair;
 		data_.push_back(std::pair<range_pair,int>(range_pair(range0, range1), time));
+		push_segment(time);
 	}
 }
 
+template <class T>
+progressive_<T>::progressive_(const std::string &data, int duration) :
+	track_(shared_track<ttrack>(data, duration))
+{
+}
+
 template <class T>
 const T progressive_<T>::get_current_element(int current_time, T default_val) const
 {
-	int time = 0;
-	unsigned int sub_halo = 0;
+	const ttrack& track = *track_;
 	int searched_time = current_time;
 	if(searched_time < 0) searched_time = 0;
-	if(searched_time > duration()) searched_time = duration();
-	if(data_.empty()) return default_val;
-	while(time < searched_time&& sub_halo < data_.size()) {
-		time += data_[sub_halo].second;
-		++sub_halo;
+	if(searched_time > track.duration()) searched_time = track.duration();
+	if(track.data_.empty()) return default_val;
 
-	}
-	if(sub_halo != 0) {
-		sub_halo--;
-		time -= data_[sub_halo].second;
-	}
+	const size_t sub_halo = track.find_segment(searched_time);
+	const int time = track.start(sub_halo);
 
-	const T first =  data_[sub_halo].first.first;
-	const T second =  data_[sub_halo].first.second;
+	const T first =  track.data_[sub_halo].first.first;
+	const T second =  track.data_[sub_halo].first.second;
 
 	return T((static_cast<double>(searched_time - time) /
-		static_cast<double>(data_[sub_halo].second)) *
+		static_cast<double>(track.data_[sub_halo].second)) *
 		(second - first) + first);
 }
 
-template<class T>
-int progressive_<T>::duration() const
-{
-	int total = 0;
-	typename std::vector<std::pair<std::pair<T, T>, int> >::const_iterator cur_halo;
-	for(cur_halo = data_.begin() ; cur_halo != data_.end() ; ++cur_halo) {
-		total += cur_halo->second;
-	}
-	return total;
-
-}
-
 template <class T>
 bool progressive_<T>::does_not_change() const
 {
-return data_.empty() ||
-	( data_.size() == 1 && data_[0].first.first == data_[0].first.second);
+	const std::vector<std::pair<std::pair<T, T>, int> >& data = track_->data_;
+return data.empty() ||
+	( data.size() == 1 && data[0].first.first == data[0].first.second);
 }
 
 // Force compilation of the following template instantiations
@@ -233,6 +269,11 @@ frame_builder::frame_builder(const config& cfg,const std::string& frame_string)
 	primary_frame_(t_unset),
 	drawing_layer_(cfg[frame_string + "layer"])
 {
+	// warm sound while loading. filtered sound(tag:file) is resolved at play time.
+	if (!sound_.empty() && sound_.find(':') == std::string::npos) {
+		sound::preload(sound_);
+	}
+
 	if(!cfg.has_attribute(frame_string + "auto_vflip")) {
 		auto_vflip_ = t_unset;
 	} else if(cfg[frame_string + "auto_vflip"].to_bool()) {
@@ -23,31 +23,86 @@
 
 #include "image.hpp"
 
+#include <boost/shared_ptr.hpp>
+
 class config;
 
+/**
+ * Keyframe timeline shared by progressive_string and progressive_<T>.
+ * Compiled once per (input, duration) and shared between all tracks built
+ * from the same string, so lookups never re-sum the segment durations.
+ */
+class tprogressive_track {
+public:
+	tprogressive_track(const std::string& input)
+		: input_(input)
+		, starts_()
+		, duration_(0)
+		, step_(0)
+		, monotonic_(true)
+	{}
+
+	/** Index of segment that time falls in, same as walking segments from time 0. */
+	size_t find_segment(int time) const;
+	int start(size_t segment) const { return starts_[segment]; }
+
+	const std::string& input() const { return input_; }
+	int duration() const { return duration_; }
+
+protected:
+	/** Append segment, must be called in order. */
+	void push_segment(int time);
+
+private:
+	std::string input_;
+	// start time of every segment
+	std::vector<int> starts_;
+	int duration_;
+	// > 0 if every segment has this same time.
+	int step_;
+	// false if some segment has negative time.
+	bool monotonic_;
+};
+
 class progressive_string {
 	public:
 		progressive_string(const std::string& data = "",int duration = 0);
-		int duration() const;
+		int duration() const { return track_->duration(); }
 		const std::string & get_current_element(int time) const;
-		bool does_not_change() const { return data_.size() <= 1; }
-		std::string get_original() const { return input_; }
+		bool does_not_change() const { return track_->data_.size() <= 1; }
+		std::string get_original() const { return track_->input(); }
+
+		class ttrack: public tprogressive_track
+		{
+		public:
+			ttrack(const std::string& data, int duration);
+
+			std::vector<std::pair<std::string,int> > data_;
+		};
 	private:
-		std::vector<std::pair<std::string,int> > data_;
-		std::string input_;
+		boost::shared_ptr<const ttrack> track_;
 };
 
 template <class T>
 class progressive_
 {
-	std::vector<std::pair<std::pair<T, T>, int> > data_;
-	std::string input_;
 public:
+	class ttrack: public tprogressive_track
+	{
+	public:
+		ttrack(const std::string& data, int duration);
+
+		std::vector<std::pair<std::pair<T, T>, int> > data_;
+	};
+
 	progressive_(const std::string& data = "", int duration = 0);
-	int duration() const;
+	int duration() const { return track_->duration(); }
 	const T get_current_element(int time,T default_val=0) const;
 	bool does_not_change() const;
-	std::string get_original() const { return input_; }
+	std::string get_original() const { return track_->input(); }
+
+private:
+	boost::shared_ptr<const ttrack> track_;
 };
 
 typedef progressive_<int> progressive_int;
@@ -30,6 +30,7 @@
 #include "display.hpp"
 #include "gettext.hpp"
 #include "base_instance.hpp"
+#include "benchmark.hpp"
 #include <boost/foreach.hpp>
 #include <vector>
 #include <map>
@@ -99,6 +100,72 @@ texture frameTexture = NULL;
 texture whiteTexture;
 int frame_width = 0;
 int frame_height = 0;
+
+// area of frameTexture changed since last flip.
+std::vector<SDL_Rect> damage_rects;
+bool damage_full = true;
+// overlays of this frame and last presented frame.
+std::vector<std::pair<SDL_Rect, const void*> > overlays;
+std::vector<std::pair<SDL_Rect, const void*> > last_overlays;
+// only software renderer keeps window content between present,
+// others must copy whole frame texture every present.
+bool partial_present = false;
+}
+
+void add_screen_damage(const SDL_Rect& rect)
+{
+	if (damage_full) {
+		return;
+	}
+	SDL_Rect r = intersect_rects(rect, screen_area());
+	if (r.w <= 0 || r.h <= 0) {
+		return;
+	}
+
+	// merge with a rect when the union wastes little fill-rate, repeat since the union may reach others.
+	bool merged = true;
+	while (merged) {
+		merged = false;
+		for (std::vector<SDL_Rect>::iterator it = damage_rects.begin(); it != damage_rects.end(); ++ it) {
+			const SDL_Rect u = union_rects(*it, r);
+			if (u.w * u.h <= (it->w * it->h + r.w * r.h) * 5 / 4) {
+				r = u;
+				damage_rects.erase(it);
+				merged = true;
+				break;
+			}
+		}
+	}
+	damage_rects.push_back(r);
+
+	const int max_damage_rects = 16;
+	if ((int)damage_rects.size() > max_damage_rects) {
+		add_screen_damage_full();
+	}
+}
+
+void add_screen_damage_full()
+{
+	damage_full = true;
+	damage_rects.clear();
+}
+
+void add_screen_overlay(const SDL_Rect& rect, const void* content)
+{
+	overlays.push_back(std::make_pair(rect, content));
+}
+
+static bool overlays_equal(const std::vector<std::pair<SDL_Rect, const void*> >& a, const std::vector<std::pair<SDL_Rect, const void*> >& b)
+{
+	if (a.size() != b.size()) {
+		return false;
+	}
+	for (size_t n = 0; n < a.size(); n ++) {
+		if (a[n].second != b[n].second || memcmp(&a[n].first, &b[n].first, sizeof(SDL_Rect))) {
+			return false;
+		}
+	}
+	return true;
 }
 
 SDL_Renderer* get_renderer()
@@ -251,6 +318,12 @@ int CVideo::setMode(int w, int h, int bits_per_pixel, int flags)
 	}
 #endif
 	renderer = SDL_CreateRenderer(window, -1, 0);
+	{
+		SDL_RendererInfo info;
+		partial_present = SDL_GetRendererInfo(renderer, &info) == 0 && (info.flags & SDL_RENDERER_SOFTWARE);
+	}
+	add_screen_damage_full();
+	last_overlays.clear();
 
 #if (defined(__APPLE__) && TARGET_OS_IPHONE)
 	if (gui2::twidget::hdpi) {
@@ -330,13 +403,57 @@ void CVideo::flip()
 {
     // when enable background audio, will enter it during background.
     if (!instance->foreground()) {
+		// what is on screen is unknown when back to foreground.
+		add_screen_damage_full();
         return;
     }
 
+	// overlays are drawn before and undrawn after flip, they damage only when differ from last frame.
+	if (!overlays_equal(overlays, last_overlays)) {
+		for (std::vector<std::pair<SDL_Rect, const void*> >::const_iterator it = last_overlays.begin(); it != last_overlays.end(); ++ it) {
+			add_screen_damage(it->first);
+		}
+		for (std::vector<std::pair<SDL_Rect, const void*> >::const_iterator it = overlays.begin(); it != overlays.end(); ++ it) {
+			add_screen_damage(it->first);
+		}
+	}
+	last_overlays.swap(overlays);
+	overlays.clear();
+
+	if (!damage_full && damage_rects.empty()) {
+		// nothing changed, skip this frame.
+		return;
+	}
+
+	if (!damage_full) {
+		// above this, one full copy is cheaper than many small ones.
+		const int full_threshold = frame_width * frame_height / 2;
+		int area = 0;
+		for (std::vector<SDL_Rect>::const_iterator it = damage_rects.begin(); it != damage_rects.end(); ++ it) {
+			area += it->w * it->h;
+		}
+		if (!partial_present || area > full_threshold) {
+			damage_full = true;
+		}
+	}
+
 	texture null_tex;
 	trender_target_lock lock(renderer, null_tex);
-	SDL_RenderCopy(renderer, frameTexture.get(), NULL, NULL);
+	if (damage_full) {
+		SDL_RenderCopy(renderer, frameTexture.get(), NULL, NULL);
+		benchmark::count(benchmark::PRESENT_RECTS);
+		benchmark::count(benchmark::PRESENT_PIXELS, frame_width * frame_height);
+	} else {
+		benchmark::count(benchmark::PRESENT_RECTS, damage_rects.size());
+		for (std::vector<SDL_Rect>::const_iterator it = damage_rects.begin(); it != damage_rects.end(); ++ it) {
+			SDL_RenderCopy(renderer, frameTexture.get(), &*it, &*it);
+			benchmark::count(benchmark::PRESENT_PIXELS, it->w * it->h);
+		}
+	}
 	SDL_RenderPresent(renderer);
+
+	damage_rects.clear();
+	damage_full = false;
 }
 
 void CVideo::lock_updates(bool value)
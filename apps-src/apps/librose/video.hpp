@@ -36,6 +36,14 @@ int get_screen_height();
 SDL_Rect screen_area();
 const SDL_PixelFormat& get_screen_format();
 
+// every draw into screen texture should report the area it changed,
+// CVideo::flip presents only the damaged area, and skips frame without damage.
+void add_screen_damage(const SDL_Rect& rect);
+void add_screen_damage_full();
+// cursor, tooltip and floating label are drawn before flip and undrawn after it.
+// they damage screen only when their rect or content differs from last frame's.
+void add_screen_overlay(const SDL_Rect& rect, const void* content);
+
 class CVideo : private boost::noncopyable 
 {
 public:
@@ -274,8 +274,15 @@ void wml_config_to_file(const std::string& fname, const config &cfg, uint32_t nf
 }
 
 
-bool wml_config_from_data(uint8_t *data, uint32_t datalen, uint8_t *namebuf, uint8_t *valbuf, std::vector<std::string> &tdomain, config &cfg)
+// whether size bytes from rdpos are in data. bin may be truncated or corrupted.
+static bool wml_data_has(const uint8_t* rdpos, const uint8_t* end, uint32_t size)
 {
+	return size <= (uint32_t)(end - rdpos);
+}
+
+bool wml_config_from_data(uint8_t *data, uint32_t datalen, uint8_t *namebuf, uint8_t *valbuf, uint32_t buflen, std::vector<std::string> &tdomain, config &cfg)
+{
+	const uint8_t* end = data + datalen;
 	int									retval;
 	uint8_t								*rdpos = data;
 	uint32_t							u32n, len, transcnt, tdidx;
@@ -291,7 +298,7 @@ bool wml_config_from_data(uint8_t *data, uint32_t datalen, uint8_t *namebuf, uin
 
 		// posix_print("in while, rdpos: %p, pos: %u(0x%x)", rdpos, rdpos - data + 4, rdpos - data + 4);
 		// read {[cfg]}{len}{name}
-		if (memcmp(rdpos, WMLBIN_MARK_CONFIG, WMLBIN_MARK_CONFIG_LEN)) {
+		if (!wml_data_has(rdpos, end, WMLBIN_MARK_CONFIG_LEN + sizeof(u32n)) || memcmp(rdpos, WMLBIN_MARK_CONFIG, WMLBIN_MARK_CONFIG_LEN)) {
 			// invalid format.
 			return false;
 		}
@@ -300,6 +307,9 @@ bool wml_config_from_data(uint8_t *data, uint32_t datalen, uint8_t *namebuf, uin
 		len = posix_lo16(u32n);
 		deep = posix_hi16(u32n);
 		rdpos = rdpos + sizeof(u32n);
+		if (len >= buflen || !wml_data_has(rdpos, end, len) || deep >= lastcfg.size()) {
+			return false;
+		}
 
 		memcpy(namebuf, rdpos, len);
 		namebuf[len] = 0;
@@ -315,14 +325,20 @@ bool wml_config_from_data(uint8_t *data, uint32_t datalen, uint8_t *namebuf, uin
 		}
 
 		// read {[val]}{len}{name0}{len}{val0}{len}{name1}{len}{val1}{...}
-		if (!memcmp(rdpos, WMLBIN_MARK_VALUE, WMLBIN_MARK_VALUE_LEN)) {
+		if (wml_data_has(rdpos, end, WMLBIN_MARK_VALUE_LEN) && !memcmp(rdpos, WMLBIN_MARK_VALUE, WMLBIN_MARK_VALUE_LEN)) {
 			// value
 			rdpos = rdpos + WMLBIN_MARK_VALUE_LEN;
 
-			while ((rdpos < data + datalen) && memcmp(rdpos, WMLBIN_MARK_CONFIG, WMLBIN_MARK_CONFIG_LEN)) {
+			while ((rdpos < end) && (!wml_data_has(rdpos, end, WMLBIN_MARK_CONFIG_LEN) || memcmp(rdpos, WMLBIN_MARK_CONFIG, WMLBIN_MARK_CONFIG_LEN))) {
 				// name
+				if (!wml_data_has(rdpos, end, sizeof(len))) {
+					return false;
+				}
 				memcpy(&len, rdpos, sizeof(len));
 				rdpos = rdpos + sizeof(len);
+				if (len >= buflen || !wml_data_has(rdpos, end, len + sizeof(u32n) + sizeof(len))) {
+					return false;
+				}
 
 				memcpy(namebuf, rdpos, len);
 				namebuf[len] = 0;
@@ -337,6 +353,9 @@ bool wml_config_from_data(uint8_t *data, uint32_t datalen, uint8_t *namebuf, uin
 
 				memcpy(&len, rdpos, sizeof(len));
 				rdpos = rdpos + sizeof(len);
+				if (len >= buflen || !wml_data_has(rdpos, end, len) || tdidx > tdomain.size()) {
+					return false;
+				}
 				memcpy(valbuf, rdpos, len);
 				valbuf[len] = 0;
 				rdpos = rdpos + len;
@@ -350,6 +369,9 @@ bool wml_config_from_data(uint8_t *data, uint32_t datalen, uint8_t *namebuf, uin
 					transcnt --;
 					while (transcnt != 0) {
 						// value
+						if (!wml_data_has(rdpos, end, sizeof(u32n) + sizeof(len))) {
+							return false;
+						}
 						memcpy(&u32n, rdpos, sizeof(u32n));
 						rdpos = rdpos + sizeof(u32n);
 
@@ -357,6 +379,9 @@ bool wml_config_from_data(uint8_t *data, uint32_t datalen, uint8_t *namebuf, uin
 
 						memcpy(&len, rdpos, sizeof(len));
 						rdpos = rdpos + sizeof(len);
+						if (len >= buflen || !wml_data_has(rdpos, end, len) || tdidx > tdomain.size()) {
+							return false;
+						}
 						memcpy(valbuf, rdpos, len);
 						valbuf[len] = 0;
 						rdpos = rdpos + len;
@@ -381,7 +406,7 @@ bool wml_config_from_data(uint8_t *data, uint32_t datalen, uint8_t *namebuf, uin
 
 #define MIN_XMIN_BIN_SIZE		28	// 16 + 4 + 4 +....+4... last +4 is size of textdomain.
 
-void wml_config_from_file(const std::string &fname, config &cfg, uint32_t* nfiles, uint32_t* sum_size, uint32_t* modified)
+bool wml_config_from_file(const std::string &fname, config &cfg, uint32_t* nfiles, uint32_t* sum_size, uint32_t* modified)
 {
 	int64_t fsize;
 	uint32_t							max_str_len, data_len, tdcnt, idx, len;
@@ -397,16 +422,16 @@ void wml_config_from_file(const std::string &fname, config &cfg, uint32_t* nfile
 	tfile lock(fname, GENERIC_READ, OPEN_EXISTING);
 	if (!lock.valid()) {
 		posix_print("------<xwml.cpp>::wml_config_from_file, cannot create %s for read\n", fname.c_str());
-		return;
+		return false;
 	}
 	fsize = posix_fsize(lock.fp);
 	if (fsize <= MIN_XMIN_BIN_SIZE) {
-		return;
+		return false;
 	}
 	posix_fseek(lock.fp, 0);
 	posix_fread(lock.fp, &len, 4);
 	if (len != mmioFOURCC('X', 'W', 'M', 'L')) {
-		return;
+		return false;
 	}
 	posix_fread(lock.fp, &len, 4);
 	if (nfiles) {
@@ -426,12 +451,19 @@ void wml_config_from_file(const std::string &fname, config &cfg, uint32_t* nfile
 	posix_fread(lock.fp, &data_len, sizeof(data_len));
 
 	uint32_t header_len = 16 + sizeof(max_str_len) + sizeof(data_len);
+	if (data_len > fsize - header_len - sizeof(tdcnt)) {
+		// truncated
+		return false;
+	}
 	posix_fseek(lock.fp, header_len + data_len);
 
 	// read textdomain
 	posix_fread(lock.fp, &tdcnt, sizeof(tdcnt));
 	for (idx = 0; idx < tdcnt; idx ++) {
 		posix_fread(lock.fp, &len, sizeof(uint32_t));
+		if (len > MAXLEN_TEXTDOMAIN) {
+			return false;
+		}
 		posix_fread(lock.fp, tdname, len);
 		tdname[len] = 0;
 		tdomain.push_back(tdname);
@@ -448,7 +480,11 @@ void wml_config_from_file(const std::string &fname, config &cfg, uint32_t* nfile
 	posix_fseek(lock.fp, header_len);
 	posix_fread(lock.fp, lock.data, data_len);
 
-	wml_config_from_data((uint8_t*)lock.data, data_len, namebuf, valbuf, tdomain, cfg);
+	const bool ret = wml_config_from_data((uint8_t*)lock.data, data_len, namebuf, valbuf, max_str_len + 1 + 1024, tdomain, cfg);
+	if (!ret) {
+		posix_print("------<xwml.cpp>::wml_config_from_file, %s is corrupted\n", fname.c_str());
+		cfg.clear();
+	}
 
 	if (namebuf) {
 		free(namebuf);
@@ -456,6 +492,7 @@ void wml_config_from_file(const std::string &fname, config &cfg, uint32_t* nfile
 	if (valbuf) {
 		free(valbuf);
 	}
+	return ret;
 }
 
 bool wml_checksum_from_file(const std::string &fname, uint32_t* nfiles, uint32_t* sum_size, uint32_t* modified)
@@ -540,21 +577,35 @@ wml_building_rules_from_fileֻ
 
 //   2.1.ַܵһ,hi8(hi16(u32))ֵӴĿ,0
 //   2.2.lo16(u32)Ӵַ
-#define vstr_to_fp(fp, vstr, idx, size, u32n, max_str_len) do {	\
+#define vstr_to_fp(fp, vstr, idx, size, u32n, strings) do {	\
 	size = (vstr).size();	\
 	posix_fwrite(fp, &size, sizeof(size));	\
 	for (idx = 0; idx < size; idx ++) {	\
-		u32n = (vstr)[idx].size();	\
+		u32n = tb_string_index(strings, (vstr)[idx]);	\
 		posix_fwrite(fp, &u32n, sizeof(u32n));	\
-		posix_fwrite(fp, (vstr)[idx].c_str(), u32n);	\
-		max_str_len = posix_max(max_str_len, u32n);	\
 	}	\
 } while (0)
 
+// tb-*.dat index. rules are followed by interned string table, rules refer strings by index.
+// footer: offset of string table, TB_INDEX_MARK. file without footer is former format, strings are inline.
+#define TB_INDEX_MARK		mmioFOURCC('T', 'B', 'I', 'X')
+
+static uint32_t tb_string_index(std::map<std::string, uint32_t>& strings, const std::string& str)
+{
+	std::map<std::string, uint32_t>::const_iterator it = strings.find(str);
+	if (it != strings.end()) {
+		return it->second;
+	}
+	const uint32_t index = strings.size();
+	strings.insert(std::make_pair(str, index));
+	return index;
+}
+
 void wml_building_rules_to_file(const std::string& fname, terrain_builder::building_rule* rules, uint32_t rules_size, uint32_t nfiles, uint32_t sum_size, uint32_t modified)
 {
 	posix_file_t						fp = INVALID_FILE;
 	uint32_t							max_str_len, u32n, idx, size, size1; 
+	std::map<std::string, uint32_t>		strings;
 
 	posix_print("<xwml.cpp>::wml_building_rules_to_file------fname: %s, will save %u rules\n", fname.c_str(), rules_size);
 
@@ -637,11 +688,11 @@ void wml_building_rules_to_file(const std::string& fname, terrain_builder::build
 			posix_fwrite(fp, &u32n, sizeof(int));
 
 			// std::vector<std::string> set_flag;
-			vstr_to_fp(fp, constraint->set_flag, idx, size, u32n, max_str_len);
+			vstr_to_fp(fp, constraint->set_flag, idx, size, u32n, strings);
 			// std::vector<std::string> no_flag;
-			vstr_to_fp(fp, constraint->no_flag, idx, size, u32n, max_str_len);
+			vstr_to_fp(fp, constraint->no_flag, idx, size, u32n, strings);
 			// std::vector<std::string> has_flag;
-			vstr_to_fp(fp, constraint->has_flag, idx, size, u32n, max_str_len);
+			vstr_to_fp(fp, constraint->has_flag, idx, size, u32n, strings);
 
 			// (typedef std::vector<rule_image> rule_imagelist) rule_imagelist images
 			size = constraint->images.size();
@@ -682,15 +733,11 @@ void wml_building_rules_to_file(const std::string& fname, terrain_builder::build
 //						bool random_start;
 //					}
 
-					u32n = imgitor->image_string.size();
+					u32n = tb_string_index(strings, imgitor->image_string);
 					posix_fwrite(fp, &u32n, sizeof(u32n));	
-					posix_fwrite(fp, imgitor->image_string.c_str(), u32n);
-					max_str_len = posix_max(max_str_len, u32n);
 
-					u32n = imgitor->variations.size();
+					u32n = tb_string_index(strings, imgitor->variations);
 					posix_fwrite(fp, &u32n, sizeof(u32n));	
-					posix_fwrite(fp, imgitor->variations.c_str(), u32n);
-					max_str_len = posix_max(max_str_len, u32n);
 
 					u32n = imgitor->random_start? 1: 0;
 					posix_fwrite(fp, &u32n, sizeof(int));
@@ -738,6 +785,24 @@ void wml_building_rules_to_file(const std::string& fname, terrain_builder::build
 	}
 
 	// Ĵ洢С
+	// interned string table, in index order.
+	const uint32_t strings_offset = (uint32_t)SDL_RWtell(fp);
+	std::vector<const std::string*> table(strings.size());
+	for (std::map<std::string, uint32_t>::const_iterator it = strings.begin(); it != strings.end(); ++ it) {
+		table[it->second] = &it->first;
+	}
+	size = table.size();
+	posix_fwrite(fp, &size, sizeof(size));
+	for (idx = 0; idx < size; idx ++) {
+		u32n = table[idx]->size();
+		posix_fwrite(fp, &u32n, sizeof(u32n));
+		posix_fwrite(fp, table[idx]->c_str(), u32n);
+		max_str_len = posix_max(max_str_len, u32n);
+	}
+	posix_fwrite(fp, &strings_offset, sizeof(strings_offset));
+	u32n = TB_INDEX_MARK;
+	posix_fwrite(fp, &u32n, sizeof(u32n));
+
 	posix_fseek(fp, 16);
 	posix_fwrite(fp, &max_str_len, sizeof(max_str_len));
 
@@ -749,6 +814,20 @@ void wml_building_rules_to_file(const std::string& fname, terrain_builder::build
 
 #define MAXLEN_BR_STRPLUS1		270
 
+// @strings: interned string table. NULL when former format, string is inline.
+static const std::string& tb_string_from_data(uint8_t*& rdpos, const std::vector<std::string>* strings, std::string& tmp)
+{
+	uint32_t u32n;
+	memcpy(&u32n, rdpos, sizeof(uint32_t));
+	rdpos = rdpos + sizeof(uint32_t);
+	if (strings) {
+		return (*strings)[u32n];
+	}
+	tmp.assign((const char*)rdpos, u32n);
+	rdpos = rdpos + u32n;
+	return tmp;
+}
+
 typedef struct {
 	int first;
 	int second;
@@ -759,8 +838,10 @@ terrain_builder::building_rule* wml_building_rules_from_file(const std::string&
 	posix_file_t fp = INVALID_FILE;
 	int64_t fsize;
 	uint32_t datalen, max_str_len, rules_size, idx, len, size, size1, idx1, size2, idx2;
-	uint8_t* data = NULL, *strbuf = NULL, *variations = NULL;
-	uint8_t* rdpos;
+	uint8_t* data = NULL;
+	uint8_t* rdpos, *rules_end;
+	std::vector<std::string> strings;
+	std::string tmp, tmp2;
 	terrain_builder::building_rule * rules = NULL;
 	map_location loc;
 	tmp_pair tmppair;
@@ -787,8 +868,6 @@ terrain_builder::building_rule* wml_building_rules_from_file(const std::string&
 
 	datalen = fsize - 16 - sizeof(max_str_len) - sizeof(rules_size);
 	data = (uint8_t *)malloc(datalen);
-	strbuf = (uint8_t *)malloc(max_str_len + 1);
-	variations = (uint8_t *)malloc(max_str_len + 1);
 
 	// read file data to memory
 	posix_fread(fp, data, datalen);
@@ -796,6 +875,28 @@ terrain_builder::building_rule* wml_building_rules_from_file(const std::string&
 	posix_print("max_str_len: %u, fsize: %u, datalen: %u\n", max_str_len, (int)fsize, datalen);
 	
 	rdpos = data;
+	rules_end = data + datalen;
+
+	// indexed format, build every string once.
+	if (datalen >= 8) {
+		uint32_t strings_offset;
+		memcpy(&len, data + datalen - 4, sizeof(uint32_t));
+		memcpy(&strings_offset, data + datalen - 8, sizeof(uint32_t));
+		strings_offset -= 16 + sizeof(max_str_len) + sizeof(rules_size);
+		if (len == TB_INDEX_MARK && strings_offset < datalen - 8) {
+			rules_end = data + strings_offset;
+			uint8_t* strpos = rules_end;
+			memcpy(&size, strpos, sizeof(uint32_t));
+			strpos = strpos + sizeof(uint32_t);
+			strings.reserve(size);
+			for (idx = 0; idx < size; idx ++) {
+				memcpy(&len, strpos, sizeof(uint32_t));
+				strings.push_back(std::string((const char*)strpos + sizeof(uint32_t), len));
+				strpos = strpos + sizeof(uint32_t) + len;
+			}
+		}
+	}
+	const std::vector<std::string>* strings_ptr = rules_end != data + datalen? &strings: NULL;
 
 	// allocate memory for rules pointer array
 	if (rules_size) {
@@ -809,7 +910,7 @@ terrain_builder::building_rule* wml_building_rules_from_file(const std::string&
 /*
 	uint32_t previous, current, start, stop = SDL_GetTicks();
 */
-	while (rdpos < data + datalen) {
+	while (rdpos < rules_end && rule_index < rules_size) {
 		int x, y;
 /*
 		start = stop;
@@ -846,6 +947,7 @@ terrain_builder::building_rule* wml_building_rules_from_file(const std::string&
 		// size of constraints
 		memcpy(&size, rdpos, sizeof(int));
 		rdpos = rdpos + sizeof(int);
+		pbr.constraints.reserve(size);
 /*
 		current = SDL_GetTicks();
 		posix_print(" + %u", current - previous);
@@ -876,6 +978,9 @@ terrain_builder::building_rule* wml_building_rules_from_file(const std::string&
 
 			memcpy(&size1, rdpos, sizeof(uint32_t));
 			rdpos = rdpos + sizeof(uint32_t);
+			match.terrain.reserve(size1);
+			match.mask.reserve(size1);
+			match.masked_terrain.reserve(size1);
 			for (idx1 = 0; idx1 < size1; idx1 ++) {
 				memcpy(&tmppair, rdpos, 8);
 				match.terrain.push_back(t_translation::t_terrain(tmppair.first, tmppair.second));
@@ -899,37 +1004,29 @@ terrain_builder::building_rule* wml_building_rules_from_file(const std::string&
 			// size of flags in set_flag
 			memcpy(&size1, rdpos, sizeof(uint32_t));
 			rdpos = rdpos + sizeof(uint32_t);
+			constraint.set_flag.reserve(size1);
 			for (idx1 = 0; idx1 < size1; idx1 ++) {
-				memcpy(&len, rdpos, sizeof(uint32_t));
-				memcpy(strbuf, rdpos + sizeof(uint32_t), len);
-				strbuf[len] = 0;
-				constraint.set_flag.push_back((char*)strbuf);
-				rdpos = rdpos + sizeof(uint32_t) + len;				
+				constraint.set_flag.push_back(tb_string_from_data(rdpos, strings_ptr, tmp));
 			}
 			// size of flags in no_flag
 			memcpy(&size1, rdpos, sizeof(uint32_t));
 			rdpos = rdpos + sizeof(uint32_t);
+			constraint.no_flag.reserve(size1);
 			for (idx1 = 0; idx1 < size1; idx1 ++) {
-				memcpy(&len, rdpos, sizeof(uint32_t));
-				memcpy(strbuf, rdpos + sizeof(uint32_t), len);
-				strbuf[len] = 0;
-				constraint.no_flag.push_back((char*)strbuf);
-				rdpos = rdpos + sizeof(uint32_t) + len;				
+				constraint.no_flag.push_back(tb_string_from_data(rdpos, strings_ptr, tmp));
 			}
 			// size of flags in has_flag
 			memcpy(&size1, rdpos, sizeof(uint32_t));
 			rdpos = rdpos + sizeof(uint32_t);
+			constraint.has_flag.reserve(size1);
 			for (idx1 = 0; idx1 < size1; idx1 ++) {
-				memcpy(&len, rdpos, sizeof(uint32_t));
-				memcpy(strbuf, rdpos + sizeof(uint32_t), len);
-				strbuf[len] = 0;
-				constraint.has_flag.push_back((char*)strbuf);
-				rdpos = rdpos + sizeof(uint32_t) + len;				
+				constraint.has_flag.push_back(tb_string_from_data(rdpos, strings_ptr, tmp));
 			}
 
 			// size of rule_image in rule_imagelist
 			memcpy(&size1, rdpos, sizeof(uint32_t));
 			rdpos = rdpos + sizeof(uint32_t);
+			constraint.images.reserve(size1);
 			for (idx1 = 0; idx1 < size1; idx1 ++) {
 				// struct terrain_builder::rule_image& ri = constraint->second.images[idx1];
 				// rule_image
@@ -950,24 +1047,19 @@ terrain_builder::building_rule* wml_building_rules_from_file(const std::string&
 				// size of rule_image in rule_imagelist
 				memcpy(&size2, rdpos, sizeof(uint32_t));
 				rdpos = rdpos + sizeof(uint32_t);
+				constraint.images.back().variants.reserve(size2);
 				for (idx2 = 0; idx2 < size2; idx2 ++) {
 					bool random_start;
 
-					memcpy(&len, rdpos, sizeof(uint32_t));
-					memcpy(strbuf, rdpos + sizeof(uint32_t), len);
-					strbuf[len] = 0;
-					rdpos = rdpos + sizeof(uint32_t) + len;
+					const std::string& image_string = tb_string_from_data(rdpos, strings_ptr, tmp);
 
 					// Adds the main (default) variant of the image, if present
-					memcpy(&len, rdpos, sizeof(uint32_t));
-					memcpy(variations, rdpos + sizeof(uint32_t), len);
-					variations[len] = 0;
-					rdpos = rdpos + sizeof(uint32_t) + len;
+					const std::string& variations = tb_string_from_data(rdpos, strings_ptr, tmp2);
 
 					memcpy(&len, rdpos, sizeof(int));
 					random_start = len? true: false;
 					rdpos = rdpos + sizeof(int);
-					constraint.images.back().variants.push_back(terrain_builder::rule_image_variant((char*)strbuf, (char*)variations, random_start));
+					constraint.images.back().variants.push_back(terrain_builder::rule_image_variant(image_string, variations, random_start));
 				}
 			}
 /*
@@ -989,12 +1081,6 @@ terrain_builder::building_rule* wml_building_rules_from_file(const std::string&
 	if (data) {
 		free(data);
 	}
-	if (strbuf) {
-		free(strbuf);
-	}
-	if (variations) {
-		free(variations);
-	}
 
 	if (rules_size_ptr) {
 		*rules_size_ptr = rule_index;
@@ -15,6 +15,8 @@
 
 #include "animation.hpp"
 #include "builder.hpp"
+#include "map.hpp"
+#include "map_exception.hpp"
 
 #include <iomanip>
 #include <boost/foreach.hpp>
@@ -385,6 +387,7 @@ editor::wml2bin_desc::wml2bin_desc()
 	, bin_nfiles(0)
 	, bin_sum_size(0)
 	, bin_modified(0)
+	, wml_changed(false)
 	, require_build(false)
 {}
 
@@ -404,26 +407,124 @@ void editor::wml2bin_desc::refresh_checksum(const std::string& working_dir)
 #define BASENAME_LANGUAGE	"language.bin"
 
 // file processor function only support prefixed with game_config::path.
+threading::mutex editor::tres_path_lock::mutex;
 int editor::tres_path_lock::deep = 0;
 editor::tres_path_lock::tres_path_lock(editor& o)
-	: original_(game_config::path)
 {
-	VALIDATE(!deep, null_str);
+	threading::lock lock(mutex);
+	if (!deep) {
+		original_ = game_config::path;
+		game_config::path = o.working_dir_;
+	} else {
+		// nested lock(concurrent build) must not change path.
+		VALIDATE(game_config::path == o.working_dir_, null_str);
+	}
 	deep ++;
-	game_config::path = o.working_dir_;
 }
 
 editor::tres_path_lock::~tres_path_lock()
 {
-	game_config::path = original_;
+	threading::lock lock(mutex);
 	deep --;
+	if (!deep) {
+		game_config::path = original_;
+	}
 }
 
 editor::editor(const std::string& working_dir) 
 	: cache_(game_config::config_cache::instance())
 	, working_dir_(working_dir)
 	, wml2bin_descs_()
+	, build_manifest_()
+	, build_manifest_dir_()
+{
+}
+
+// record of bins is written to cache directory, one manifest for every res directory.
+static threading::mutex build_manifest_mutex;
+
+std::string editor::build_manifest_file() const
 {
+	std::stringstream ss;
+	ss << get_user_data_dir() << "/cache/build-" << std::hex << std::setw(16) << std::setfill('0') << hash64(working_dir_.c_str(), working_dir_.size()) << ".cfg";
+	return ss.str();
+}
+
+void editor::load_build_manifest()
+{
+	threading::lock lock(build_manifest_mutex);
+	if (build_manifest_dir_ == working_dir_) {
+		return;
+	}
+	build_manifest_.clear();
+	build_manifest_dir_ = working_dir_;
+
+	const std::string file = build_manifest_file();
+	if (!file_exists(file)) {
+		return;
+	}
+	try {
+		read(build_manifest_, read_file(file));
+	} catch (config::error& e) {
+		build_manifest_.clear();
+		posix_print("------<editor.cpp>::load_build_manifest, corrupted %s, %s\n", file.c_str(), e.message.c_str());
+	}
+}
+
+void editor::record_build(const std::string& bin_file, const std::string& define, const game_config::config_cache& cache, uint32_t nfiles, uint32_t sum_size, uint32_t modified)
+{
+	load_build_manifest();
+
+	config record;
+	record["name"] = bin_file;
+	record["define"] = define;
+	record["nfiles"] = nfiles;
+	record["sum_size"] = sum_size;
+	record["modified"] = modified;
+	const std::set<std::string>& depends = cache.get_depends();
+	for (std::set<std::string>::const_iterator it = depends.begin(); it != depends.end(); ++ it) {
+		config& depend = record.add_child("depend");
+		depend["name"] = *it;
+		depend["hash"] = game_config::depend_hash(*it);
+	}
+
+	threading::lock lock(build_manifest_mutex);
+	config& exist = build_manifest_.find_child("bin", "name", bin_file);
+	if (exist) {
+		exist = record;
+	} else {
+		build_manifest_.add_child("bin", record);
+	}
+
+	const std::string file = build_manifest_file();
+	if (create_directory_if_missing(directory_name(file))) {
+		std::stringstream ss;
+		write(ss, build_manifest_);
+		const std::string& str = ss.str();
+		write_file(file, str.c_str(), str.size());
+	}
+}
+
+// return false if there is no valid record, caller should compare checksum.
+bool editor::check_build_record(const std::string& bin_file, const std::string& define, wml2bin_desc& desc) const
+{
+	const config& record = build_manifest_.find_child("bin", "name", bin_file);
+	if (!record || record["define"].str() != define) {
+		return false;
+	}
+	// bin isn't one that studio built, it may be copied from other place.
+	if (record["nfiles"].to_unsigned() != desc.bin_nfiles || record["sum_size"].to_unsigned() != desc.bin_sum_size || record["modified"].to_unsigned() != (uint32_t)desc.bin_modified) {
+		return false;
+	}
+
+	desc.wml_changed = false;
+	BOOST_FOREACH (const config& depend, record.child_range("depend")) {
+		if (depend["hash"].str() != game_config::depend_hash(depend["name"].str())) {
+			desc.wml_changed = true;
+			break;
+		}
+	}
+	return true;
 }
 
 void editor::set_working_dir(const std::string& dir)
@@ -458,22 +559,21 @@ bool editor::make_system_bins_exist()
 	get_wml2bin_desc_from_wml(system_bins);
 	const std::vector<std::pair<editor::BIN_TYPE, editor::wml2bin_desc> >& descs = wml2bin_descs();
 
+	bool ret = true;
 	int count = (int)descs.size();
-	for (int at = 0; at < count; at ++) {
+	for (int at = 0; at < count && ret; at ++) {
 		const std::pair<editor::BIN_TYPE, editor::wml2bin_desc>& desc = descs[at];
 
-		bool ret = false;
 		try {
 			ret = cfgs_2_cfg(desc.first, desc.second.bin_name, desc.second.app, true, desc.second.wml_nfiles, desc.second.wml_sum_size, (uint32_t)desc.second.wml_modified);
 		} catch (twml_exception& /*e*/) {
-			return false;
-		}
-		if (!ret) {
-			return false;
+			ret = false;
 		}
 	}
+	// file hashes are saved once all bins are built.
+	game_config::save_depend_hashes();
 
-	return true;
+	return ret;
 }
 
 // check location:
@@ -706,15 +806,35 @@ void editor::generate_app_bin_config()
 	SDL_CloseDir(dir);
 }
 
-bool editor::cfgs_2_cfg(const editor::BIN_TYPE type, const std::string& name, const std::string& app, bool write_file, uint32_t nfiles, uint32_t sum_size, uint32_t modified, const std::map<std::string, std::string>& app_domains)
+// map_data of scenarios is embedded in compact binary form, gamemap::read loads
+// it without parsing every cell.
+static void compact_map_data(config& cfg)
+{
+	BOOST_FOREACH (config& scenario, cfg.child_range("scenario")) {
+		const std::string& data = scenario["map_data"].str();
+		if (data.empty()) {
+			continue;
+		}
+		try {
+			scenario["map_data"] = gamemap::bin_data(data);
+		} catch (incorrect_map_format_error& e) {
+			throw game::error(std::string("<") + scenario["id"].str() + ">" + e.message);
+		}
+	}
+}
+
+// err isn't NULL when called by build thread, error is put in it instead of showing dialog.
+bool editor::cfgs_2_cfg(const editor::BIN_TYPE type, const std::string& name, const std::string& app, bool write_file, uint32_t nfiles, uint32_t sum_size, uint32_t modified, const std::map<std::string, std::string>& app_domains, game_config::config_cache* target_cache, std::string* err)
 {
 	config tmpcfg;
+	game_config::config_cache& cache = target_cache? *target_cache: cache_;
 
 	tres_path_lock lock(*this);
 	game_config::config_cache_transaction main_transaction;
 
 	try {
-		cache_.clear_defines();
+		cache.clear_defines();
+		cache.clear_depends();
 
 		if (type == editor::TB_DAT) {
 			VALIDATE(write_file, "write_file must be true when generate TB_DAT!");
@@ -725,8 +845,8 @@ bool editor::cfgs_2_cfg(const editor::BIN_TYPE type, const std::string& name, co
 			str = str.substr(terrain_builder::tb_dat_prefix.size());
 
 			const config& tb_cfg = tbs_config_.find_child("tb", "id", str);
-			cache_.add_define(tb_cfg["define"].str());
-			cache_.get_config(working_dir_ + "/data/tb.cfg", tmpcfg);
+			cache.add_define(tb_cfg["define"].str());
+			cache.get_config(working_dir_ + "/data/tb.cfg", tmpcfg);
 
 			if (write_file) {
 				const config& tb_parsed_cfg = tmpcfg.find_child("tb", "id", str);
@@ -743,12 +863,12 @@ bool editor::cfgs_2_cfg(const editor::BIN_TYPE type, const std::string& name, co
 			const config& campaign_cfg = app_cfg.find_child(app_cfg[BINKEY_ID_CHILD], "id", name_str);
 
 			if (!campaign_cfg["define"].empty()) {
-				cache_.add_define(campaign_cfg["define"].str());
+				cache.add_define(campaign_cfg["define"].str());
 			}
 			if (!app_cfg[BINKEY_MACROS].empty()) {
-				cache_.get_config(working_dir_ + "/" + app_cfg[BINKEY_MACROS], tmpcfg);
+				cache.get_config(working_dir_ + "/" + app_cfg[BINKEY_MACROS], tmpcfg);
 			}
-			cache_.get_config(working_dir_ + "/" + app_cfg[BINKEY_PATH] + "/" + name_str, tmpcfg);
+			cache.get_config(working_dir_ + "/" + app_cfg[BINKEY_PATH] + "/" + name_str, tmpcfg);
 
 			const config& refcfg = tmpcfg.child(app_cfg[BINKEY_SCENARIO_CHILD]);
 			// check scenario config valid
@@ -760,27 +880,31 @@ bool editor::cfgs_2_cfg(const editor::BIN_TYPE type, const std::string& name, co
 			}
 
 			if (write_file) {
+				compact_map_data(tmpcfg.child(app_cfg[BINKEY_SCENARIO_CHILD]));
 				const std::string xwml_app_path = working_dir_ + "/xwml/" + game_config::generate_app_dir(app);
 				SDL_MakeDirectory(xwml_app_path.c_str());
 				wml_config_to_file(xwml_app_path + "/" + name, refcfg, nfiles, sum_size, modified, app_domains);
+				record_build(xwml_app_path + "/" + name, campaign_cfg["define"].str(), cache, nfiles, sum_size, modified);
 			}
 
 		} else if (type == editor::GUI) {
 			// no pre-defined
 			VALIDATE(write_file, "write_file must be true when generate GUI!");
 
-			cache_.get_config(working_dir_ + "/data/gui", tmpcfg);
+			cache.get_config(working_dir_ + "/data/gui", tmpcfg);
 			if (write_file) {
 				wml_config_to_file(working_dir_ + "/xwml/" + BASENAME_GUI, tmpcfg, nfiles, sum_size, modified, app_domains);
+				record_build(working_dir_ + "/xwml/" + BASENAME_GUI, null_str, cache, nfiles, sum_size, modified);
 			}
 
 		} else if (type == editor::LANGUAGE)  {
 			// no pre-defined
 			VALIDATE(write_file, "write_file must be true when generate LANGUAGE!");
 
-			cache_.get_config(working_dir_ + "/data/languages", tmpcfg);
+			cache.get_config(working_dir_ + "/data/languages", tmpcfg);
 			if (write_file) {
 				wml_config_to_file(working_dir_ + "/xwml/" + BASENAME_LANGUAGE, tmpcfg, nfiles, sum_size, modified, app_domains);
+				record_build(working_dir_ + "/xwml/" + BASENAME_LANGUAGE, null_str, cache, nfiles, sum_size, modified);
 			}
 		} else if (type == editor::EXTENDABLE)  {
 			// no pre-defined
@@ -792,12 +916,12 @@ bool editor::cfgs_2_cfg(const editor::BIN_TYPE type, const std::string& name, co
 			// terrain builder rule
 			const std::string tb_cfg = working_dir_ + "/data/tb.cfg";
 			if (file_exists(tb_cfg)) {
-				cache_.get_config(tb_cfg, tbs_config_);
+				cache.get_config(tb_cfg, tbs_config_);
 			}
 		} else {
 			// type == editor::MAIN_DATA
-			cache_.add_define("CORE");
-			cache_.get_config(working_dir_ + "/data", tmpcfg);
+			cache.add_define("CORE");
+			cache.get_config(working_dir_ + "/data", tmpcfg);
 
 			// check scenario config valid
 			std::string err_str = check_data_bin(tmpcfg);
@@ -807,6 +931,7 @@ bool editor::cfgs_2_cfg(const editor::BIN_TYPE type, const std::string& name, co
 
 			if (write_file) {
 				wml_config_to_file(working_dir_ + "/xwml/" + BASENAME_DATA, tmpcfg, nfiles, sum_size, modified, app_domains);
+				record_build(working_dir_ + "/xwml/" + BASENAME_DATA, "CORE", cache, nfiles, sum_size, modified);
 			}
 			editor_config::data_cfg = tmpcfg;
 
@@ -814,8 +939,13 @@ bool editor::cfgs_2_cfg(const editor::BIN_TYPE type, const std::string& name, co
 		} 
 	}
 	catch (game::error& e) {
+		const std::string msg = _("Error loading game configuration files: '") + e.message + _("' (The game will now exit)");
+		if (err) {
+			*err = msg;
+			return false;
+		}
 		display* disp = display::get_singleton();
-		gui2::show_error_message(disp->video(), _("Error loading game configuration files: '") + e.message + _("' (The game will now exit)"));
+		gui2::show_error_message(disp->video(), msg);
 		return false;
 	}
 	return true;
@@ -861,6 +991,7 @@ std::vector<std::string> generate_tb_short_paths(const std::string& id, const co
 void editor::get_wml2bin_desc_from_wml(const std::vector<editor::BIN_TYPE>& system_bin_types)
 {
 	tres_path_lock lock(*this);
+	load_build_manifest();
 
 	editor::wml2bin_desc desc;
 	file_tree_checksum dir_checksum;
@@ -884,7 +1015,7 @@ void editor::get_wml2bin_desc_from_wml(const std::vector<editor::BIN_TYPE>& syst
 	BOOST_FOREACH (const config& bcfg, campaigns_config_.child_range("bin")) {
 		const std::string& key = bcfg[BINKEY_ID_CHILD].str();
 		BOOST_FOREACH (const config& cfg, bcfg.child_range(key)) {
-			app_bins.push_back(tapp_bin(cfg["id"].str(), bcfg["app"].str(), bcfg[BINKEY_PATH].str(), bcfg[BINKEY_MACROS].str()));
+			app_bins.push_back(tapp_bin(cfg["id"].str(), bcfg["app"].str(), bcfg[BINKEY_PATH].str(), bcfg[BINKEY_MACROS].str(), cfg["define"].str()));
 			bin_types.push_back(editor::SCENARIO_DATA);
 		}
 	}
@@ -896,6 +1027,7 @@ void editor::get_wml2bin_desc_from_wml(const std::vector<editor::BIN_TYPE>& syst
 
 		short_paths.clear();
 		bool calculated_wml_checksum = false;
+		std::string define;
 
 		int filter = SKIP_MEDIA_DIR;
 		if (type == editor::TB_DAT) {
@@ -932,6 +1064,7 @@ void editor::get_wml2bin_desc_from_wml(const std::vector<editor::BIN_TYPE>& syst
 
 			desc.bin_name = bin.id + ".bin";
 			desc.app = bin.app;
+			define = bin.define;
 
 			bin_to_path = working_dir_ + "/xwml/" + game_config::generate_app_dir(bin.app);
 
@@ -952,6 +1085,22 @@ void editor::get_wml2bin_desc_from_wml(const std::vector<editor::BIN_TYPE>& syst
 			filter |= SKIP_SCENARIO_DIR | SKIP_GUI_DIR;
 
 			desc.bin_name = BASENAME_DATA;
+			define = "CORE";
+		}
+
+		const std::string bin_file = bin_to_path + "/" + desc.bin_name;
+		if (!wml_checksum_from_file(bin_file, &desc.bin_nfiles, &desc.bin_sum_size, (uint32_t*)&desc.bin_modified)) {
+			desc.bin_nfiles = desc.bin_sum_size = desc.bin_modified = 0;
+		}
+
+		// TB_DAT depends on images too, preprocessor doesn't know them.
+		const bool recorded = type != editor::TB_DAT && check_build_record(bin_file, define, desc);
+		if (recorded && !desc.wml_changed) {
+			// files that bin depends on are same as when it was built, needn't walk tree.
+			desc.wml_nfiles = desc.bin_nfiles;
+			desc.wml_sum_size = desc.bin_sum_size;
+			desc.wml_modified = desc.bin_modified;
+			calculated_wml_checksum = true;
 		}
 
 		if (!calculated_wml_checksum) {
@@ -960,13 +1109,13 @@ void editor::get_wml2bin_desc_from_wml(const std::vector<editor::BIN_TYPE>& syst
 			desc.wml_sum_size = dir_checksum.sum_size;
 			desc.wml_modified = dir_checksum.modified;
 		}
-
-		if (!wml_checksum_from_file(bin_to_path + "/" + desc.bin_name, &desc.bin_nfiles, &desc.bin_sum_size, (uint32_t*)&desc.bin_modified)) {
-			desc.bin_nfiles = desc.bin_sum_size = desc.bin_modified = 0;
+		if (!recorded) {
+			desc.wml_changed = desc.wml_nfiles != desc.bin_nfiles || desc.wml_sum_size != desc.bin_sum_size || desc.wml_modified != desc.bin_modified;
 		}
 
 		wml2bin_descs_.push_back(std::pair<BIN_TYPE, wml2bin_desc>(type, desc));
 	}
+	game_config::save_depend_hashes();
 
 	return;
 }
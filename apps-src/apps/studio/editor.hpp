@@ -5,6 +5,7 @@
 #include "config.hpp"
 #include "version.hpp"
 #include "task.hpp"
+#include "thread.hpp"
 
 #include <set>
 
@@ -90,6 +91,8 @@ public:
 		~tres_path_lock();
 
 	private:
+		// builder threads share one path, only the outermost lock set it.
+		static threading::mutex mutex;
 		static int deep;
 		std::string original_;
 	};
@@ -105,22 +108,26 @@ public:
 		uint32_t bin_nfiles;
 		uint32_t bin_sum_size;
 		time_t bin_modified;
+		// wml that bin depends on changed since bin was built.
+		bool wml_changed;
 		bool require_build;
 
 		bool valid() const { return !bin_name.empty(); }
 		void refresh_checksum(const std::string& working_dir);
 	};
 	struct tapp_bin {
-		tapp_bin(const std::string& id, const std::string& app, const std::string& path, const std::string& macros)
+		tapp_bin(const std::string& id, const std::string& app, const std::string& path, const std::string& macros, const std::string& define)
 			: id(id)
 			, app(app)
 			, path(path)
 			, macros(macros)
+			, define(define)
 		{}
 		std::string id;
 		std::string app;
 		std::string path;
 		std::string macros;
+		std::string define;
 	};
 
 	editor(const std::string& working_dir);
@@ -130,7 +137,8 @@ public:
 
 	bool make_system_bins_exist();
 
-	bool cfgs_2_cfg(const BIN_TYPE type, const std::string& name, const std::string& app, bool write_file, uint32_t nfiles = 0, uint32_t sum_size = 0, uint32_t modified = 0, const std::map<std::string, std::string>& app_domains = std::map<std::string, std::string>());
+	// cache: NULL use singleton. builder thread should use its own cache.
+	bool cfgs_2_cfg(const BIN_TYPE type, const std::string& name, const std::string& app, bool write_file, uint32_t nfiles = 0, uint32_t sum_size = 0, uint32_t modified = 0, const std::map<std::string, std::string>& app_domains = std::map<std::string, std::string>(), game_config::config_cache* cache = NULL, std::string* err = NULL);
 	void get_wml2bin_desc_from_wml(const std::vector<editor::BIN_TYPE>& system_bin_types);
 	void reload_extendable_cfg();
 	std::string check_scenario_cfg(const config& scenario_cfg);
@@ -146,12 +154,22 @@ public:
 private:
 	void generate_app_bin_config();
 
+	// build manifest records, for every bin, files that preprocessor read
+	// and their hash when it was built.
+	std::string build_manifest_file() const;
+	void load_build_manifest();
+	void record_build(const std::string& bin_file, const std::string& define, const game_config::config_cache& cache, uint32_t nfiles, uint32_t sum_size, uint32_t modified);
+	bool check_build_record(const std::string& bin_file, const std::string& define, wml2bin_desc& desc) const;
+
 private:
 	std::string working_dir_;
 	config campaigns_config_;
 	config tbs_config_;
 	game_config::config_cache& cache_;
 	std::vector<std::pair<BIN_TYPE, wml2bin_desc> > wml2bin_descs_;
+
+	config build_manifest_;
+	std::string build_manifest_dir_;
 };
 
 class tapp_copier;
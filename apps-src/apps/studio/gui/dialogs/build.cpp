@@ -25,16 +25,20 @@
 #include <algorithm>
 
 tbuild::tbuild()
-	: editor_(game_config::path)
+	: build_threads_(std::max(1, SDL_GetCPUCount()))
 	, build_ctx_(*this)
-	, exit_task_(false)
+	, build_total_nfiles_(0)
+	, parallel_at_(0)
+	, build_target_ticks_(0)
 	, require_set_task_bar_(true)
+	, editor_(game_config::path)
 {
+	SDL_AtomicSet(&exit_task_, 0);
 }
 
 tbuild::~tbuild()
 {
-	exit_task_ = true;
+	SDL_AtomicSet(&exit_task_, 1);
 }
 
 void tbuild::pre_show(gui2::ttrack& track)
@@ -48,9 +52,18 @@ void tbuild::pre_show(gui2::ttrack& track)
 
 static void increment_progress_cb2(std::string const &name, uint32_t param1, void* param2)
 {
+	// param2 is context of the target that this thread is building.
 	tbuild::tbuild_ctx* ctx = (tbuild::tbuild_ctx*)param2;
-	ctx->name = name;
-	ctx->nfiles ++;
+	ctx->owner.increment_progress(*ctx, name);
+}
+
+void tbuild::increment_progress(tbuild_ctx& ctx, const std::string& name)
+{
+	threading::lock lock(build_mutex_);
+	ctx.name = name;
+	ctx.nfiles ++;
+	build_ctx_.name = name;
+	build_ctx_.nfiles ++;
 }
 
 void tbuild::do_build2()
@@ -58,28 +71,120 @@ void tbuild::do_build2()
 	thread_->Start();
 }
 
+// TB_DAT use binary_paths_manager and MAIN_DATA reload game_config, both modify
+// process-wide state, so they are built one after another on worker thread.
+static bool require_serial_build(editor::BIN_TYPE type)
+{
+	return type == editor::TB_DAT || type == editor::MAIN_DATA;
+}
+
+bool tbuild::build_target(int at, game_config::config_cache* cache)
+{
+	const std::pair<editor::BIN_TYPE, editor::wml2bin_desc>& desc = editor_.wml2bin_descs()[at];
+	main_->Invoke<void>(RTC_FROM_HERE, rtc::Bind(&tbuild::handle_desc, this, desc, true, at, true));
+
+	const uint32_t start_ticks = SDL_GetTicks();
+	tbuild_ctx ctx(*this);
+	ctx.reset(at);
+	set_increment_progress progress(increment_progress_cb2, &ctx);
+
+	// this is build thread, errors are shown by main thread after all targets.
+	bool ret = false;
+	std::string err;
+	try {
+		ret = editor_.cfgs_2_cfg(desc.first, desc.second.bin_name, desc.second.app, true, desc.second.wml_nfiles, desc.second.wml_sum_size, (uint32_t)desc.second.wml_modified, tdomains, cache, &err);
+	} catch (twml_exception& e) {
+		threading::lock lock(build_mutex_);
+		build_wml_errors_.push_back(e);
+	}
+	{
+		threading::lock lock(build_mutex_);
+		build_target_ticks_ += SDL_GetTicks() - start_ticks;
+		if (!err.empty()) {
+			build_errors_.push_back(err);
+		}
+	}
+	main_->Invoke<void>(RTC_FROM_HERE, rtc::Bind(&tbuild::handle_desc, this, desc, false, at, ret));
+	return ret;
+}
+
+void tbuild::build_parallel_targets()
+{
+	// every thread has its own cache, so defines of one target don't affect others.
+	game_config::config_cache cache;
+	while (!SDL_AtomicGet(&exit_task_)) {
+		int at;
+		{
+			threading::lock lock(build_mutex_);
+			if (parallel_at_ == parallel_queue_.size()) {
+				break;
+			}
+			at = parallel_queue_[parallel_at_ ++];
+		}
+		build_target(at, &cache);
+	}
+}
+
+int tbuild::build_thread_func(void* param)
+{
+	tbuild* build = reinterpret_cast<tbuild*>(param);
+	build->build_parallel_targets();
+	return 0;
+}
+
 void tbuild::DoWork()
 {
 	// this is in thread. don't call any operator aboult dialog.
 	const std::vector<std::pair<editor::BIN_TYPE, editor::wml2bin_desc> >& descs = editor_.wml2bin_descs();
-	set_increment_progress progress(increment_progress_cb2, &build_ctx_);
+	const uint32_t start_ticks = SDL_GetTicks();
+
+	std::vector<int> serial_queue;
+	parallel_queue_.clear();
+	parallel_at_ = 0;
+	build_target_ticks_ = 0;
+	build_total_nfiles_ = 0;
+	build_ctx_.nfiles = 0;
+	build_ctx_.name.clear();
+	build_errors_.clear();
+	build_wml_errors_.clear();
 
 	int count = (int)descs.size();
-	for (int at = 0; at < count && !exit_task_; at ++) {
+	for (int at = 0; at < count; at ++) {
 		const std::pair<editor::BIN_TYPE, editor::wml2bin_desc>& desc = descs[at];
 		if (!desc.second.require_build) {
 			continue;
 		}
-		main_->Invoke<void>(RTC_FROM_HERE, rtc::Bind(&tbuild::handle_desc, this, desc, true, at, true));
-
-		bool ret = false;
-		try {
-			ret = editor_.cfgs_2_cfg(desc.first, desc.second.bin_name, desc.second.app, true, desc.second.wml_nfiles, desc.second.wml_sum_size, (uint32_t)desc.second.wml_modified, tdomains);
-		} catch (twml_exception& e) {
-			e.show();
+		build_total_nfiles_ += desc.second.wml_nfiles;
+		if (build_threads_ > 1 && !require_serial_build(desc.first)) {
+			parallel_queue_.push_back(at);
+		} else {
+			serial_queue.push_back(at);
 		}
-		main_->Invoke<void>(RTC_FROM_HERE, rtc::Bind(&tbuild::handle_desc, this, desc, false, at, ret));
 	}
+
+	// game_config::path is set once for all threads.
+	editor::tres_path_lock lock(editor_);
+
+	// this thread will help parallel build after serial targets, so create one less thread.
+	const int threads = std::min(build_threads_, (int)parallel_queue_.size()) - (serial_queue.empty()? 1: 0);
+	std::vector<threading::thread*> workers;
+	for (int n = 0; n < threads; n ++) {
+		workers.push_back(new threading::thread(build_thread_func, this));
+	}
+
+	for (std::vector<int>::const_iterator it = serial_queue.begin(); it != serial_queue.end() && !SDL_AtomicGet(&exit_task_); ++ it) {
+		build_target(*it, NULL);
+	}
+	build_parallel_targets();
+
+	for (std::vector<threading::thread*>::iterator it = workers.begin(); it != workers.end(); ++ it) {
+		delete *it;
+	}
+	// save once after all targets, not after every bin.
+	game_config::save_depend_hashes();
+
+	posix_print("build %i targets with %i threads, %u ms elapsed, %u ms in sequential.\n", 
+		(int)(serial_queue.size() + parallel_queue_.size()), (int)workers.size() + 1, SDL_GetTicks() - start_ticks, build_target_ticks_);
 }
 
 void tbuild::OnWorkStart()
@@ -91,6 +196,16 @@ void tbuild::OnWorkDone()
 { 
 	build_ctx_.reset(gui2::twidget::npos);
 
+	// build threads have been joined, show their errors in main thread.
+	for (std::vector<twml_exception>::const_iterator it = build_wml_errors_.begin(); it != build_wml_errors_.end(); ++ it) {
+		it->show();
+	}
+	for (std::vector<std::string>::const_iterator it = build_errors_.begin(); it != build_errors_.end(); ++ it) {
+		gui2::show_error_message(display::get_singleton()->video(), *it);
+	}
+	build_errors_.clear();
+	build_wml_errors_.clear();
+
 	app_work_done();
 
 	task_status_->set_dirty();
@@ -99,7 +214,8 @@ void tbuild::OnWorkDone()
 void tbuild::handle_desc(const std::pair<editor::BIN_TYPE, editor::wml2bin_desc>& desc, const bool started, const int at, const bool ret)
 {
 	if (started) {
-		build_ctx_.reset(at);
+		// nfiles accumulates all targets, don't reset it.
+		build_ctx_.desc_at = at;
 	}
 	app_handle_desc(started, at, ret);
 }
@@ -132,15 +248,22 @@ void tbuild::task_status_callback(gui2::ttrack& widget, const gui2::tpoint& offs
 		SDL_RenderCopy(renderer, widget.background_texture().get(), NULL, &widget_rect);
 	}
 
-	const std::pair<editor::BIN_TYPE, editor::wml2bin_desc>& desc = editor_.wml2bin_descs()[build_ctx_.desc_at];
+	size_t nfiles;
+	std::string name;
+	{
+		threading::lock lock(build_mutex_);
+		nfiles = build_ctx_.nfiles;
+		name = build_ctx_.name;
+	}
+	const size_t total_nfiles = std::max(nfiles, build_total_nfiles_);
 
-	dst.w = build_ctx_.nfiles * widget_rect.w / desc.second.wml_nfiles;
+	dst.w = total_nfiles? nfiles * widget_rect.w / total_nfiles: 0;
 	draw_rect2(renderer, dst, 0xff00ff00);
 
 	std::stringstream ss;
-	ss << build_ctx_.nfiles << "/" << desc.second.wml_nfiles;
-	if (!build_ctx_.name.empty()) {
-		ss << "    " << build_ctx_.name.substr(editor_.working_dir().size());
+	ss << nfiles << "/" << total_nfiles;
+	if (!name.empty()) {
+		ss << "    " << name.substr(editor_.working_dir().size());
 	}
 	surface text_surf = font::get_rendered_text2(ss.str(), INT32_MAX, 12 * gui2::twidget::hdpi_scale, font::BLACK_COLOR);
 	dst = ::create_rect(xsrc + 4 * gui2::twidget::hdpi_scale, ysrc + (widget_rect.h - text_surf->h) / 2, text_surf->w, text_surf->h);
@@ -4,6 +4,7 @@
 #include "gui/dialogs/dialog.hpp"
 #include "editor.hpp"
 #include "thread.hpp"
+#include "wml_exception.hpp"
 
 class display;
 
@@ -36,6 +37,9 @@ public:
 		tbuild& owner;
 	};
 
+	// called by thread that is preprocessing, ctx is context of its target.
+	void increment_progress(tbuild_ctx& ctx, const std::string& name);
+
 protected:
 	void pre_show(gui2::ttrack& track);
 	bool is_building() const { return build_ctx_.desc_at != gui2::twidget::npos; }
@@ -46,6 +50,11 @@ protected:
 	void OnWorkDone() override;
 
 private:
+	static int build_thread_func(void* param);
+	// pull target from parallel_queue_ and build it until queue is empty.
+	void build_parallel_targets();
+	bool build_target(int at, game_config::config_cache* cache);
+
 	void handle_desc(const std::pair<editor::BIN_TYPE, editor::wml2bin_desc>& desc, const bool started, const int at, const bool ret);
 	void task_status_callback(gui2::ttrack& widget, const gui2::tpoint& offset, const bool from_timer);
 
@@ -54,8 +63,22 @@ private:
 	virtual void app_handle_desc(const bool started, const int at, const bool ret) = 0;
 
 protected:
+	// max threads to build bins. 1 build one after another on worker thread.
+	int build_threads_;
+
+	// build_ctx_ accumulates progress of all building targets.
 	tbuild_ctx build_ctx_;
-	bool exit_task_;
+	threading::mutex build_mutex_;
+	size_t build_total_nfiles_;
+	std::vector<int> parallel_queue_;
+	size_t parallel_at_;
+	uint32_t build_target_ticks_;
+	// errors of targets, build threads can't show dialog.
+	std::vector<std::string> build_errors_;
+	std::vector<twml_exception> build_wml_errors_;
+
+	// written by main thread, read by build threads.
+	SDL_atomic_t exit_task_;
 
 	bool require_set_task_bar_;
 	gui2::ttrack* task_status_;
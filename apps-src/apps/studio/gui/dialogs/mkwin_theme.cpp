@@ -236,7 +236,7 @@ bool tmkwin_theme::require_build()
 	VALIDATE(descs.size() == 1 && descs[0].first == editor::GUI, null_str);
 	editor::wml2bin_desc& desc = descs[0].second;
 
-	return desc.wml_nfiles != desc.bin_nfiles || desc.wml_sum_size != desc.bin_sum_size || desc.wml_modified != desc.bin_modified;
+	return desc.wml_changed;
 }
 
 void tmkwin_theme::do_build()
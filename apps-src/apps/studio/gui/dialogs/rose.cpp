@@ -327,7 +327,7 @@ void trose::fill_items(twindow& window)
 		std::map<std::string, string_map> list_item_item;
 
 		ss.str("");
-		if (desc.wml_nfiles == desc.bin_nfiles && desc.wml_sum_size == desc.bin_sum_size && desc.wml_modified == desc.bin_modified) {
+		if (!desc.wml_changed) {
 			ss << tintegrate::generate_img("misc/ok-tip.png");
 		} else {
 			ss << tintegrate::generate_img("misc/alert-tip.png");
@@ -356,10 +356,10 @@ void trose::fill_items(twindow& window)
 		if (build_msg_data_.type == build_export || build_msg_data_.type == build_ios_kit) {
 			enable_build = true;
 
-		} else if (it->first == editor::MAIN_DATA && (desc.wml_nfiles != desc.bin_nfiles || desc.wml_sum_size != desc.bin_sum_size || desc.wml_modified != desc.bin_modified)) {	
+		} else if (it->first == editor::MAIN_DATA && desc.wml_changed) {	
 			enable_build = true;
 
-		} else if (it->first == editor::SCENARIO_DATA && (desc.wml_nfiles != desc.bin_nfiles || desc.wml_sum_size != desc.bin_sum_size || desc.wml_modified != desc.bin_modified)) {
+		} else if (it->first == editor::SCENARIO_DATA && desc.wml_changed) {
 			const std::string id = file_main_name(desc.bin_name);
 			if (editor_config::campaign_id.empty() || id == editor_config::campaign_id) {
 				enable_build = true;
@@ -895,6 +895,10 @@ void trose::app_handle_desc(const bool started, const int at, const bool ret)
 
 			tcontrol* bin_checksum = find_widget<tcontrol>(panel, "bin_checksum", false, true);
 			desc.refresh_checksum(editor_.working_dir());
+			if (ret) {
+				// bin is built from current wml.
+				desc.wml_changed = false;
+			}
 			ss.str("");
 			ss << "(" << desc.bin_nfiles << ", " << desc.bin_sum_size << ", " << desc.bin_modified << ")";
 			bin_checksum->set_label(ss.str());
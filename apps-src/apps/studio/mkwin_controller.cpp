@@ -17,6 +17,7 @@
 #include "mkwin_controller.hpp"
 #include "mkwin_display.hpp"
 
+#include "benchmark.hpp"
 #include "gettext.hpp"
 #include "integrate.hpp"
 #include "formula_string_utils.hpp"
@@ -242,7 +243,7 @@ std::string mkwin_controller::widget_template_cfg()
 }
 
 mkwin_controller::mkwin_controller(const config &top_config, CVideo& video, const std::map<std::string, std::string>& app_tdomains, bool theme)
-	: controller_base(SDL_GetTicks(), top_config, video)
+	: controller_base(benchmark::get_ticks(), top_config, video)
 	, gui_(NULL)
 	, map_(top_config, null_str)
 	, units_(*this, map_, !theme)
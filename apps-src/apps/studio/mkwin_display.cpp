@@ -516,5 +516,6 @@ void mkwin_display::redraw_units(const std::vector<map_location>& invalidated_un
 		it->second->update_last_draw_time();
 		anim2::rt.type = it->second->type();
 		it->second->redraw(screen_.getTexture(), empty_rect);
+		add_screen_damage(map_area());
 	}
 }
\ No newline at end of file
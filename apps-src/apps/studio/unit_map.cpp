@@ -59,6 +59,7 @@ void unit_map::create_coor_map(int w, int h)
 				coor_map_[pitch + loc.x].overlay = n;
 			}
 		}
+		rebuild_grid();
 	}
 }
 
@@ -149,6 +150,7 @@ void unit_map::save_map_to(unit::tchild& child, bool clear)
 		free(map_);
 		map_ = NULL;
 		map_vsize_ = 0;
+		rebuild_grid();
 	}
 }
 
@@ -293,6 +295,7 @@ void unit_map::zero_map()
 		memset(map_, 0, w_ * h_ * sizeof(base_unit*));
 		map_vsize_ = 0;
 	}
+	rebuild_grid();
 	if (coor_map_) {
 		memset(coor_map_, 0, w_ * h_ * sizeof(loc_cookie));
 	}